@@ -0,0 +1,214 @@
+#include "adaptive_pipeline.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+
+static const double smoothing = 0.2; // Weight of the newest frame in the smoothed processing time
+
+// Odd kernel size of the same physical extent on a frame halved 'levels' times, with the
+// same fallback for invalid sizes as the operation
+static int scaledKernelSize(int kernelSize, int fallback, int levels) {
+    const int radius = (kernelSize <= 0 || kernelSize % 2 == 0 ? fallback : kernelSize) / 2;
+    return ((radius + (1 << levels) / 2) >> levels) * 2 + 1;
+}
+
+static int scaledLength(int length, int levels) {
+    return std::max(1, (length + (1 << levels) / 2) >> levels);
+}
+
+// Parameters for running the chain on a frame halved 'levels' times
+static ProcessingParams scaledParams(const ProcessingParams& params, int levels) {
+    ProcessingParams scaled = params;
+    scaled.kernelSize = scaledKernelSize(params.kernelSize, 15, levels);
+    scaled.erosionKernelSize = scaledKernelSize(params.erosionKernelSize, 3, levels);
+    scaled.dilationKernelSize = scaledKernelSize(params.dilationKernelSize, 3, levels);
+    scaled.cropX = params.cropX >> levels;
+    scaled.cropY = params.cropY >> levels;
+    scaled.cropWidth = scaledLength(params.cropWidth, levels);
+    scaled.cropHeight = scaledLength(params.cropHeight, levels);
+    scaled.resizeWidth = scaledLength(params.resizeWidth, levels);
+    scaled.resizeHeight = scaledLength(params.resizeHeight, levels);
+    scaled.blobMinArea = params.blobMinArea >> (2 * levels);
+    scaled.version = 0; // Not the values of the snapshot any more
+    return scaled;
+}
+
+AdaptivePipeline::AdaptivePipeline(const AdaptiveOptions& adaptiveOptions, std::ostream& decisionLog)
+    : options(adaptiveOptions), log(decisionLog),
+      levelMetric(metricsGauge("adaptive_level")), decisionMetric(metricsCounter("adaptive_decisions_total")) {}
+
+bool AdaptivePipeline::configure(const std::string& choices) {
+    if (!whole.configure(choices)) return false; // Reports the unsupported choice
+    chain = choices;
+
+    // Cut out every Canny stage so canny-half can run it on a smaller copy
+    segments.clear();
+    cannySegment.clear();
+    std::string stages;
+    for (size_t i = 0; i <= chain.size(); ++i) {
+        if (i < chain.size() && chain[i] != 'B') {
+            stages += chain[i];
+            continue;
+        }
+        if (!stages.empty()) {
+            segments.push_back(Pipeline());
+            segments.back().configure(stages);
+            cannySegment.push_back(false);
+            stages.clear();
+        }
+        if (i < chain.size()) {
+            segments.push_back(Pipeline());
+            cannySegment.push_back(true);
+        }
+    }
+
+    // Masks and edges stay binary through erosion, dilation and geometric stages
+    binaryOutput = false;
+    for (size_t i = 0; i < chain.size(); ++i) {
+        if (chain[i] == '4' || chain[i] == 'B' || chain[i] == 'C') binaryOutput = true;
+        else if (chain[i] == '1' || chain[i] == '2' || chain[i] == '3' || chain[i] == '8' || chain[i] == 'E') binaryOutput = false;
+    }
+
+    ladder.clear();
+    ladder.push_back({"full", 0, 0, 1});
+    if (chain.find('B') != std::string::npos) ladder.push_back({"canny-half", 0, 1, 1});
+    ladder.push_back({"half", 1, 0, 1});
+    ladder.push_back({"quarter", 2, 0, 1});
+    ladder.push_back({"quarter-skip2", 2, 0, 2});
+    ladder.push_back({"quarter-skip3", 2, 0, 3});
+
+    current = 0;
+    frameCount = 0;
+    smoothedMs = -1;
+    levelMs.assign(ladder.size(), -1);
+    overBudget = calm = framesAtLevel = 0;
+    upgradeHold = options.upgradeAfter;
+    arrivedByUpgrade = false;
+    output = nullptr;
+    fullSize = fullInputSize = cv::Size();
+    counts = AdaptiveStats();
+    counts.framesPerLevel.assign(ladder.size(), 0);
+    levelMetric->set(0);
+    return true;
+}
+
+std::string AdaptivePipeline::describe() const {
+    char budget[32];
+    std::snprintf(budget, sizeof(budget), "%.1f", options.budgetMs);
+    std::string text = whole.describe() + " within " + budget + " ms:";
+    for (const AdaptiveLevel& rung : ladder) text += std::string(" ") + rung.name;
+    return text;
+}
+
+const cv::Mat& AdaptivePipeline::run(const cv::Mat& frame, const ProcessingParams& params) {
+    frameCount++;
+    counts.framesPerLevel[current]++;
+    const int skip = ladder[current].skip;
+    if (output && skip > 1 && frameCount % skip != 0) {
+        counts.skipped++;
+        return *output;
+    }
+    const std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+    process(frame, params);
+    decide(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - before).count());
+    return *output;
+}
+
+// Run the chain at the current level into 'output'
+void AdaptivePipeline::process(const cv::Mat& frame, const ProcessingParams& params) {
+    const AdaptiveLevel& rung = ladder[current];
+    if (rung.pyramidLevels == 0 && rung.cannyLevels == 0) {
+        output = &whole.run(frame, params);
+        fullSize = output->size();
+        fullInputSize = frame.size();
+        fullParams = params;
+        return;
+    }
+
+    if (rung.pyramidLevels == 0) {
+        // canny-half: every stage but Canny at full resolution
+        const cv::Mat* image = &frame;
+        for (size_t k = 0; k < segments.size(); ++k) {
+            if (!cannySegment[k]) {
+                image = &segments[k].run(*image, params);
+                continue;
+            }
+            applyStage('B', pyramidDown(*image, rung.cannyLevels), cannyOutput, params, scratch);
+            cv::resize(cannyOutput, upsampled, image->size(), 0, 0, cv::INTER_NEAREST);
+            image = &upsampled;
+        }
+        output = image;
+        return;
+    }
+
+    // Whole chain on a reduced frame
+    const cv::Mat& processed = whole.run(pyramidDown(frame, rung.pyramidLevels), scaledParams(params, rung.pyramidLevels));
+
+    // Same size as a full-quality result: the frame's, unless a crop or resize changed it
+    cv::Size target = frame.size();
+    if (chain.find_first_of("567") != std::string::npos) {
+        target = fullInputSize == frame.size() && sameParams(fullParams, params)
+            ? fullSize : cv::Size(processed.cols << rung.pyramidLevels, processed.rows << rung.pyramidLevels);
+    }
+    cv::resize(processed, upsampled, target, 0, 0, binaryOutput ? cv::INTER_NEAREST : cv::INTER_LINEAR);
+    output = &upsampled;
+}
+
+// 'image' halved 'levels' (>= 1) times; two buffers because pyrDown cannot work in place
+const cv::Mat& AdaptivePipeline::pyramidDown(const cv::Mat& image, int levels) {
+    cv::pyrDown(image, reduced[0]);
+    for (int level = 1; level < levels; ++level) cv::pyrDown(reduced[(level - 1) % 2], reduced[level % 2]);
+    return reduced[(levels - 1) % 2];
+}
+
+// Update the smoothed time with the last processed frame and move along the ladder if needed
+void AdaptivePipeline::decide(double milliseconds) {
+    smoothedMs = smoothedMs < 0 ? milliseconds : (1 - smoothing) * smoothedMs + smoothing * milliseconds;
+    levelMs[current] = smoothedMs;
+    const double load = smoothedMs / ladder[current].skip; // Per frame, skipped ones included
+    framesAtLevel++;
+    overBudget = load > options.highWater * options.budgetMs ? overBudget + 1 : 0;
+    calm = load < options.lowWater * options.budgetMs ? calm + 1 : 0;
+
+    if (overBudget >= options.degradeAfter && current + 1 < static_cast<int>(ladder.size())) {
+        // Leaving a level soon after trying it again: wait twice as long before the next try
+        const bool failedProbe = arrivedByUpgrade && framesAtLevel <= upgradeHold;
+        upgradeHold = failedProbe ? std::min(upgradeHold * 2, options.maxUpgradeAfter) : options.upgradeAfter;
+        changeLevel(current + 1, "over_budget", load);
+        arrivedByUpgrade = false;
+    } else if (calm >= upgradeHold && current > 0) {
+        changeLevel(current - 1, "headroom", load);
+        arrivedByUpgrade = true;
+    }
+}
+
+void AdaptivePipeline::changeLevel(int level, const char* reason, double load) {
+    char line[256];
+    std::snprintf(line, sizeof(line),
+                  "adaptive frame=%llu level=%s->%s reason=%s load_ms=%.2f budget_ms=%.2f level_ms=%.2f next_upgrade_after=%d",
+                  static_cast<unsigned long long>(frameCount), ladder[current].name, ladder[level].name, reason, load,
+                  options.budgetMs, levelMs[level], upgradeHold);
+    log << line << std::endl;
+    current = level;
+    smoothedMs = -1;
+    overBudget = calm = framesAtLevel = 0;
+    counts.decisions++;
+    levelMetric->set(level);
+    decisionMetric->add();
+}
+
+void printAdaptiveStats(const std::string& label, const AdaptivePipeline& pipeline) {
+    const AdaptiveStats& stats = pipeline.stats();
+    std::string line = label + " adaptive";
+    char text[64];
+    for (size_t k = 0; k < pipeline.levels().size(); ++k) {
+        std::snprintf(text, sizeof(text), " %s=%llu", pipeline.levels()[k].name,
+                      static_cast<unsigned long long>(stats.framesPerLevel[k]));
+        line += text;
+    }
+    std::snprintf(text, sizeof(text), " skipped=%llu decisions=%llu final=", static_cast<unsigned long long>(stats.skipped),
+                  static_cast<unsigned long long>(stats.decisions));
+    std::cout << line << text << pipeline.levels()[pipeline.level()].name << std::endl;
+}
@@ -0,0 +1,109 @@
+#ifndef ADAPTIVE_PIPELINE_HPP
+#define ADAPTIVE_PIPELINE_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "metrics.hpp"
+#include "pipeline.hpp"
+#include "processing_params.hpp"
+
+// One rung of the quality ladder
+struct AdaptiveLevel {
+    const char* name;
+    int pyramidLevels;      // The whole chain runs on the frame halved this many times
+    int cannyLevels;        // Canny alone runs on its input halved this many times
+    int skip;               // Only every skip-th frame is processed; the others reuse the last result
+};
+
+struct AdaptiveOptions {
+    double budgetMs = 33.3;     // Processing time allowed per frame
+    int degradeAfter = 3;       // Consecutive frames over budget before dropping a level
+    int upgradeAfter = 30;      // Consecutive calm frames before trying the level above
+    int maxUpgradeAfter = 960;  // Ceiling of upgradeAfter, doubled each time a level above fails again
+    double highWater = 0.9;     // Over budget: smoothed time per frame above highWater * budget
+    double lowWater = 0.5;      // Calm: below lowWater * budget
+};
+
+struct AdaptiveStats {
+    std::vector<uint64_t> framesPerLevel;  // Frames handled at each level of levels()
+    uint64_t skipped = 0;                  // Frames answered with the previous result
+    uint64_t decisions = 0;                // Level changes
+};
+
+// Runs an operation chain within a per-frame latency budget by trading quality for time.
+//
+// The time of every processed frame is measured and smoothed (EWMA). When it stays above the
+// budget, the chain moves one level down a ladder, and back up when there is headroom again:
+//   full          every stage at full resolution
+//   canny-half    Canny on a half-resolution copy of its input, edges upsampled (only if the chain has Canny)
+//   half          the whole chain on a pyrDown'ed frame, the result upsampled
+//   quarter       the same, two pyramid levels down
+//   quarter-skip2 quarter resolution, every second frame reuses the previous result
+//   quarter-skip3 quarter resolution, two frames out of three reuse the previous result
+// Kernel sizes, crop rectangles and resize targets are scaled with the frame. Masks and edges
+// are upsampled with nearest neighbour so they stay binary; images bilinearly. The output has
+// the size a full-quality run would produce.
+// Upgrades are probes: a level that has to be left again soon after doubles the calm time
+// needed before the next try. Every change is written to 'log' as one line, e.g.
+// "adaptive frame=412 level=full->half reason=over_budget load_ms=41.20 budget_ms=33.30 level_ms=-1.00 next_upgrade_after=30"
+class AdaptivePipeline {
+public:
+    explicit AdaptivePipeline(const AdaptiveOptions& options, std::ostream& log);
+
+    // Build the chain; returns false (and prints why) on an unsupported choice
+    bool configure(const std::string& choices);
+
+    const std::string& choices() const { return chain; }
+
+    // Run the chain on one frame at the current level. The result stays valid until the next call.
+    const cv::Mat& run(const cv::Mat& frame, const ProcessingParams& params);
+
+    // Chain and ladder, e.g. "3 -> [2 C] -> B within 33.3 ms: full canny-half half quarter ..."
+    std::string describe() const;
+
+    const std::vector<AdaptiveLevel>& levels() const { return ladder; }
+    int level() const { return current; }
+    const AdaptiveStats& stats() const { return counts; }
+
+private:
+    void process(const cv::Mat& frame, const ProcessingParams& params);
+    const cv::Mat& pyramidDown(const cv::Mat& image, int levels);
+    void decide(double milliseconds);
+    void changeLevel(int level, const char* reason, double load);
+
+    AdaptiveOptions options;
+    std::ostream& log;
+    std::string chain;
+    std::vector<AdaptiveLevel> ladder;
+    Pipeline whole;                   // The chain as one pipeline
+    std::vector<Pipeline> segments;   // The chain cut around its Canny stages, for canny-half
+    std::vector<bool> cannySegment;   // Segment k is a lone Canny stage
+    bool binaryOutput = false;        // The chain ends in a mask or edges
+    ProcessingScratch scratch;
+    cv::Mat reduced[2];               // Pyramid levels
+    cv::Mat cannyOutput, upsampled;
+    const cv::Mat* output = nullptr;  // Last result
+    cv::Size fullSize;                // Output size of the last full-resolution run
+    cv::Size fullInputSize;           // ... and the input size and parameters it came from
+    ProcessingParams fullParams;
+
+    int current = 0;
+    uint64_t frameCount = 0;
+    double smoothedMs = -1;           // EWMA of the processing time at the current level
+    std::vector<double> levelMs;      // Last smoothed time seen at each level, -1 if never run
+    int overBudget = 0, calm = 0, framesAtLevel = 0;
+    int upgradeHold = 0;              // Calm frames needed before the next upgrade
+    bool arrivedByUpgrade = false;    // The current level was reached by going up
+    AdaptiveStats counts;
+    MetricGauge* levelMetric;
+    MetricCounter* decisionMetric;
+};
+
+// Print one line with the frames spent at each level, e.g.
+// "op=D adaptive full=120 canny-half=0 half=180 quarter=0 quarter-skip2=0 quarter-skip3=0 skipped=0 decisions=3 final=half"
+void printAdaptiveStats(const std::string& label, const AdaptivePipeline& pipeline);
+
+#endif // ADAPTIVE_PIPELINE_HPP
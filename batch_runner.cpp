@@ -0,0 +1,284 @@
+#include "batch_runner.hpp"
+#include "frame_ring.hpp"
+#include "metrics.hpp"
+#include "pipeline.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+
+typedef std::chrono::steady_clock Clock;
+
+static const char* const batchJournalName = ".batch_journal";
+
+// An image on its way through the stages
+struct BatchItem {
+    size_t index = 0;   // Into the input list
+    cv::Mat image;      // Decoded input, then the processed output
+};
+
+static bool isDirectory(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+static std::string fileName(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static std::string directoryOf(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+}
+
+// True if both paths name the same existing file or directory, however they are spelled
+static bool sameFile(const std::string& a, const std::string& b) {
+    struct stat first, second;
+    return stat(a.c_str(), &first) == 0 && stat(b.c_str(), &second) == 0 &&
+           first.st_dev == second.st_dev && first.st_ino == second.st_ino;
+}
+
+static std::string lowerExtension(const std::string& path) {
+    std::string name = fileName(path);
+    size_t dot = name.find_last_of('.');
+    std::string extension = dot == std::string::npos ? "" : name.substr(dot);
+    for (size_t i = 0; i < extension.size(); ++i) {
+        extension[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(extension[i])));
+    }
+    return extension;
+}
+
+// Image files matched by a directory or glob pattern, sorted
+static std::vector<std::string> listImages(const std::string& input) {
+    static const std::set<std::string> imageExtensions = {
+        ".jpg", ".jpeg", ".png", ".bmp", ".tif", ".tiff", ".webp", ".ppm", ".pgm", ".pbm", ".jp2"};
+    std::vector<std::string> matches;
+    cv::glob(isDirectory(input) ? input + "/*" : input, matches, false);
+    std::vector<std::string> images;
+    for (size_t i = 0; i < matches.size(); ++i) {
+        if (imageExtensions.count(lowerExtension(matches[i]))) images.push_back(matches[i]);
+    }
+    std::sort(images.begin(), images.end());
+    return images;
+}
+
+// Output file for an input: same name, with the extension replaced if one was asked for
+static std::string outputPath(const BatchOptions& options, const std::string& input) {
+    std::string name = fileName(input);
+    if (!options.extension.empty()) {
+        size_t dot = name.find_last_of('.');
+        std::string extension = options.extension[0] == '.' ? options.extension : "." + options.extension;
+        name = (dot == std::string::npos ? name : name.substr(0, dot)) + extension;
+    }
+    return options.outputDir + "/" + name;
+}
+
+// Refuse to write over the inputs or to send two inputs to one file ("a.png" and "a.jpg" with
+// extension ".png"); encoder threads would race on it and both would be journaled as done
+static bool checkOutputs(const BatchOptions& options, const std::vector<std::string>& inputs) {
+    std::set<std::string> directories;
+    for (size_t i = 0; i < inputs.size(); ++i) directories.insert(directoryOf(inputs[i]));
+    for (const std::string& directory : directories) {
+        if (sameFile(directory, options.outputDir)) {
+            std::cerr << "Error: Output directory " << options.outputDir << " is the input directory" << std::endl;
+            return false;
+        }
+    }
+    std::map<std::string, std::string> sources; // Output path -> input writing it
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        const std::string output = outputPath(options, inputs[i]);
+        std::pair<std::map<std::string, std::string>::iterator, bool> added = sources.insert(std::make_pair(output, inputs[i]));
+        if (!added.second) {
+            std::cerr << "Error: " << added.first->second << " and " << inputs[i] << " would both be written to " << output
+                      << "; keep their extensions or rename one" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Names of the inputs a previous run finished
+static std::set<std::string> readJournal(const std::string& path) {
+    std::set<std::string> done;
+    std::ifstream journal(path.c_str());
+    std::string line;
+    while (std::getline(journal, line)) {
+        if (!line.empty()) done.insert(line);
+    }
+    return done;
+}
+
+static double seconds(Clock::duration duration) {
+    return std::chrono::duration<double>(duration).count();
+}
+
+bool runBatch(const BatchOptions& options, const ProcessingParams& params, BatchStats& stats) {
+    stats = BatchStats();
+    const std::vector<std::string> inputs = listImages(options.input);
+    if (inputs.empty()) {
+        std::cerr << "Error: No images match " << options.input << std::endl;
+        return false;
+    }
+    Pipeline check;
+    if (!check.configure(options.chain)) return false;
+    if (mkdir(options.outputDir.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::cerr << "Error: Could not create " << options.outputDir << std::endl;
+        return false;
+    }
+    if (!checkOutputs(options, inputs)) return false;
+
+    const std::string journalPath = options.outputDir + "/" + batchJournalName;
+    std::set<std::string> done;
+    if (options.resume) done = readJournal(journalPath);
+    std::vector<size_t> pending;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        if (done.count(fileName(inputs[i]))) stats.resumed++;
+        else pending.push_back(i);
+    }
+    stats.images = static_cast<int>(inputs.size());
+    std::ofstream journal(journalPath.c_str(), options.resume ? std::ios::app : std::ios::trunc);
+    std::mutex journalLock;
+
+    // Decoding and encoding get a quarter of the threads each, processing the rest
+    int threads = options.threads > 0 ? options.threads : static_cast<int>(std::thread::hardware_concurrency());
+    threads = std::max(threads, 3);
+    stats.decode.threads = std::max(1, threads / 4);
+    stats.encode.threads = std::max(1, threads / 4);
+    stats.process.threads = std::max(1, threads - stats.decode.threads - stats.encode.threads);
+    const size_t decodedDepth = options.queueDepth ? options.queueDepth : 2 * stats.process.threads;
+    const size_t processedDepth = options.queueDepth ? options.queueDepth : 2 * stats.encode.threads;
+
+    BoundedRing<BatchItem> decoded(decodedDepth, RingPolicy::Block);
+    BoundedRing<BatchItem> processed(processedDepth, RingPolicy::Block);
+    std::atomic<size_t> nextPending(0);
+    std::atomic<int> decodersLeft(stats.decode.threads), processorsLeft(stats.process.threads);
+    std::atomic<int> written(0), failed(0);
+    std::atomic<int64_t> decodeBusy(0), processBusy(0), encodeBusy(0); // Nanoseconds
+
+    LatencyHistogram* decodeLatency = metricsHistogram(metricName("batch_stage_latency_seconds", "stage", "decode"));
+    LatencyHistogram* processLatency = metricsHistogram(metricName("batch_stage_latency_seconds", "stage", "process"));
+    LatencyHistogram* encodeLatency = metricsHistogram(metricName("batch_stage_latency_seconds", "stage", "encode"));
+    MetricCounter* writtenTotal = metricsCounter(metricName("batch_images_total", "result", "written"));
+    MetricCounter* failedTotal = metricsCounter(metricName("batch_images_total", "result", "failed"));
+    MetricGauge* decodedDepthMetric = metricsGauge(metricName("queue_depth", "queue", "batch_decoded"));
+    MetricGauge* processedDepthMetric = metricsGauge(metricName("queue_depth", "queue", "batch_processed"));
+
+    const int cvThreads = cv::getNumThreads();
+    cv::setNumThreads(1);
+    const Clock::time_point start = Clock::now();
+    std::vector<std::thread> workers;
+
+    for (int t = 0; t < stats.decode.threads; ++t) {
+        workers.emplace_back([&]() {
+            Clock::duration busy(0);
+            for (size_t k; (k = nextPending.fetch_add(1)) < pending.size();) {
+                BatchItem item;
+                item.index = pending[k];
+                const Clock::time_point before = Clock::now();
+                item.image = cv::imread(inputs[item.index], cv::IMREAD_COLOR);
+                const Clock::duration took = Clock::now() - before;
+                busy += took;
+                decodeLatency->record(std::chrono::duration_cast<std::chrono::nanoseconds>(took).count());
+                if (item.image.empty()) {
+                    std::cerr << "Warning: Could not read " << inputs[item.index] << std::endl;
+                    failed++;
+                    failedTotal->add();
+                    continue;
+                }
+                decoded.push(std::move(item));
+                decodedDepthMetric->set(static_cast<int64_t>(decoded.depth()));
+            }
+            decodeBusy += std::chrono::duration_cast<std::chrono::nanoseconds>(busy).count();
+            if (--decodersLeft == 0) decoded.close();
+        });
+    }
+    for (int t = 0; t < stats.process.threads; ++t) {
+        workers.emplace_back([&]() {
+            Pipeline pipeline; // One per thread: it keeps its intermediates between images
+            pipeline.configure(options.chain);
+            Clock::duration busy(0);
+            BatchItem item;
+            while (decoded.pop(item)) {
+                const Clock::time_point before = Clock::now();
+                pipeline.run(item.image, params).copyTo(item.image);
+                const Clock::duration took = Clock::now() - before;
+                busy += took;
+                processLatency->record(std::chrono::duration_cast<std::chrono::nanoseconds>(took).count());
+                decodedDepthMetric->set(static_cast<int64_t>(decoded.depth()));
+                processed.push(std::move(item));
+                processedDepthMetric->set(static_cast<int64_t>(processed.depth()));
+            }
+            processBusy += std::chrono::duration_cast<std::chrono::nanoseconds>(busy).count();
+            if (--processorsLeft == 0) processed.close();
+        });
+    }
+    for (int t = 0; t < stats.encode.threads; ++t) {
+        workers.emplace_back([&]() {
+            Clock::duration busy(0);
+            BatchItem item;
+            while (processed.pop(item)) {
+                const std::string& input = inputs[item.index];
+                const Clock::time_point before = Clock::now();
+                bool ok = false;
+                try {
+                    ok = cv::imwrite(outputPath(options, input), item.image);
+                } catch (const cv::Exception&) {
+                    // Format that cannot hold this image type; reported below
+                }
+                const Clock::duration took = Clock::now() - before;
+                busy += took;
+                encodeLatency->record(std::chrono::duration_cast<std::chrono::nanoseconds>(took).count());
+                processedDepthMetric->set(static_cast<int64_t>(processed.depth()));
+                if (!ok) {
+                    std::cerr << "Warning: Could not write " << outputPath(options, input) << std::endl;
+                    failed++;
+                    failedTotal->add();
+                    continue;
+                }
+                written++;
+                writtenTotal->add();
+                std::lock_guard<std::mutex> guard(journalLock);
+                journal << fileName(input) << '\n' << std::flush; // Finished even if the run is killed next
+            }
+            encodeBusy += std::chrono::duration_cast<std::chrono::nanoseconds>(busy).count();
+        });
+    }
+    for (std::thread& worker : workers) worker.join();
+    cv::setNumThreads(cvThreads);
+
+    stats.seconds = seconds(Clock::now() - start);
+    stats.processed = written;
+    stats.failed = failed;
+    stats.imagesPerSecond = stats.seconds > 0 ? stats.processed / stats.seconds : 0;
+    BatchStageStats* stages[] = {&stats.decode, &stats.process, &stats.encode};
+    const int64_t busy[] = {decodeBusy, processBusy, encodeBusy};
+    for (int s = 0; s < 3; ++s) {
+        stages[s]->busySeconds = busy[s] / 1e9;
+        stages[s]->utilization = stats.seconds > 0 ? stages[s]->busySeconds / (stages[s]->threads * stats.seconds) : 0;
+    }
+    return true;
+}
+
+void printBatchStats(const BatchStats& stats) {
+    char line[512];
+    std::snprintf(line, sizeof(line),
+                  "batch images=%d resumed=%d processed=%d failed=%d seconds=%.2f images_per_s=%.1f"
+                  " decode_threads=%d decode_util=%.2f process_threads=%d process_util=%.2f"
+                  " encode_threads=%d encode_util=%.2f",
+                  stats.images, stats.resumed, stats.processed, stats.failed, stats.seconds, stats.imagesPerSecond,
+                  stats.decode.threads, stats.decode.utilization, stats.process.threads, stats.process.utilization,
+                  stats.encode.threads, stats.encode.utilization);
+    std::cout << line << std::endl;
+}
@@ -0,0 +1,50 @@
+#ifndef BATCH_RUNNER_HPP
+#define BATCH_RUNNER_HPP
+
+#include <string>
+#include "processing_params.hpp"
+
+struct BatchOptions {
+    std::string input;          // Directory (every image in it) or cv::glob pattern such as "shots/*.jpg"
+    std::string outputDir;      // Created if missing; outputs keep the input file names
+    std::string chain;          // Menu choices run on every image, e.g. "3" or "3C9A"
+    std::string extension;      // Output format such as ".png"; empty keeps each input's extension
+    int threads = 0;            // Threads over all stages, 0 = one per hardware thread
+    size_t queueDepth = 0;      // Images waiting between two stages, 0 = two per consuming thread
+    bool resume = true;         // Skip images a previous run already finished
+};
+
+// Time one stage's threads spent working, out of the run's wall time
+struct BatchStageStats {
+    int threads = 0;
+    double busySeconds = 0;
+    double utilization = 0;     // busySeconds / (threads * run seconds)
+};
+
+struct BatchStats {
+    int images = 0;             // Images matched by the input
+    int resumed = 0;            // Skipped because a previous run finished them
+    int processed = 0;          // Decoded, processed and written by this run
+    int failed = 0;             // Could not be decoded or written
+    double seconds = 0;
+    double imagesPerSecond = 0; // processed / seconds
+    BatchStageStats decode, process, encode;
+};
+
+// Run 'chain' over every input image with decode, process and encode overlapped as three
+// stages, each on its own group of threads and connected by bounded rings, so at most a few
+// images per thread are in memory however many files there are. OpenCV's own threading is
+// off for the run: images are the parallelism. Every written image is appended to a journal
+// (".batch_journal" in the output directory) and flushed; with 'resume', images listed there
+// are skipped, so an interrupted run continues where it stopped.
+// Returns false (after printing why) if the input matches nothing, the chain is invalid, the
+// output directory cannot be created or is the input directory, or two inputs would be
+// written to the same output file.
+bool runBatch(const BatchOptions& options, const ProcessingParams& params, BatchStats& stats);
+
+// Print one result line with throughput and per-stage utilization, e.g.
+// "batch images=500 resumed=0 processed=500 failed=0 seconds=4.21 images_per_s=118.8
+//  decode_threads=2 decode_util=0.97 process_threads=4 process_util=0.52 encode_threads=2 encode_util=0.88"
+void printBatchStats(const BatchStats& stats);
+
+#endif // BATCH_RUNNER_HPP
@@ -0,0 +1,340 @@
+#include <opencv2/opencv.hpp>
+#include "color_kernel.hpp"
+#include "color_lut.hpp"
+#include "frame_source.hpp"
+#include "image_processing.hpp"
+#include "packed_mask.hpp"
+#include "test_support.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Per-kernel timings of everything in image_processing.hpp and its optimized variants, swept over
+// frame sizes, channel counts and parameters, written as one JSON object per line.
+//
+//   ./bench_kernels [--frames N] [--quick] [--filter TEXT] [--json FILE] [--baseline FILE] [--tolerance PCT]
+//
+// Frames come from SyntheticSource with fixed seeds, so two runs time the same pixels.
+// With --baseline, every measurement is compared with the line of the same kernel, variant,
+// parameters, size and channels in an earlier output; a p50 more than --tolerance percent
+// slower is reported and the exit status is 1. Built by CMakeLists.txt as the bench_kernels target.
+
+// Buffers a case writes into, kept across iterations like a processing thread keeps them
+struct KernelBuffers {
+    cv::Mat output;
+    ProcessingScratch scratch;
+    PackedMask mask, packedOutput;
+};
+
+typedef std::function<void(const cv::Mat& frame, KernelBuffers& buffers)> KernelFunction;
+
+// One kernel, implementation and parameter set
+struct KernelCase {
+    std::string kernel;     // Entry point, e.g. "computeBlurred"
+    std::string variant;    // Implementation, e.g. "box" or "avx2"
+    std::string params;     // Parameters as key=value pairs
+    bool gray;              // Also timed on single-channel frames
+    KernelFunction run;     // The timed call
+    KernelFunction setup;   // Untimed preparation before each call (its input), may be empty
+    std::function<bool()> select; // Run before the case; false skips it (e.g. an instruction set this CPU lacks)
+};
+
+struct FrameSize {
+    int width, height;
+};
+
+static const FrameSize fullSizes[] = {{640, 480}, {1280, 720}, {1920, 1080}, {3840, 2160}};
+static const FrameSize quickSizes[] = {{640, 480}};
+static const int distinctFrames = 4;
+static const int warmupIterations = 3;
+
+static const int blueLower[3] = {100, 80, 50}, blueUpper[3] = {130, 255, 255};
+static const int bgrLower[3] = {20, 40, 60}, bgrUpper[3] = {200, 220, 240};
+
+static std::string param(const std::string& key, int value) {
+    return key + "=" + std::to_string(value);
+}
+
+// Every case; add a line here for each new kernel or variant
+static std::vector<KernelCase> kernelCases() {
+    std::vector<KernelCase> cases;
+    const KernelFunction none;
+    const std::function<bool()> always = []() { return true; };
+
+    cases.push_back({"computeGrayscale", "opencv", "", true,
+                     [](const cv::Mat& f, KernelBuffers& b) { computeGrayscale(f, b.output); }, none, always});
+    cases.push_back({"computeHSV", "opencv", "", false,
+                     [](const cv::Mat& f, KernelBuffers& b) { computeHSV(f, b.output); }, none, always});
+
+    for (const char* engine : {"gaussian", "box"}) {
+        for (int kernelSize : {5, 15, 51}) {
+            const std::string name = engine;
+            cases.push_back({"computeBlurred", engine, param("ksize", kernelSize), true,
+                             [=](const cv::Mat& f, KernelBuffers& b) { computeBlurred(f, b.output, kernelSize, name, b.scratch); },
+                             none, always});
+        }
+    }
+    for (int threshold : {64, 128, 192}) {
+        cases.push_back({"computeThresholded", "opencv", param("threshold", threshold), true,
+                         [=](const cv::Mat& f, KernelBuffers& b) { computeThresholded(f, b.output, threshold, b.scratch); },
+                         none, always});
+    }
+    cases.push_back({"computeCropped", "view", "rect=center_half", true,
+                     [](const cv::Mat& f, KernelBuffers& b) { computeCropped(f, b.output, f.cols / 4, f.rows / 4, f.cols / 2, f.rows / 2); },
+                     none, always});
+    for (int percent : {50, 200}) {
+        cases.push_back({"computeResized", "opencv", param("scale_pct", percent), true,
+                         [=](const cv::Mat& f, KernelBuffers& b) { computeResized(f, b.output, f.cols * percent / 100, f.rows * percent / 100); },
+                         none, always});
+    }
+    for (int angle : {15, 45, 90}) {
+        cases.push_back({"computeRotated", "warp_maps", param("angle", angle), true,
+                         [=](const cv::Mat& f, KernelBuffers& b) { computeRotated(f, b.output, angle, b.scratch); }, none, always});
+    }
+    const std::vector<float> sharpenTaps = {0, -1, 0, -1, 5, -1, 0, -1, 0};
+    const cv::Mat sharpen = cv::Mat(sharpenTaps, true).reshape(1, 3);
+    const struct { const char* name; cv::Mat kernel; } convolutions[] = {
+        {"sharpen3", sharpen}, {"random7", randomKernel(7)}, {"random31", randomKernel(31)}};
+    for (const auto& convolution : convolutions) {
+        const cv::Mat kernel = convolution.kernel;
+        cases.push_back({"computeConvolution", "engine", std::string("kernel=") + convolution.name, true,
+                         [=](const cv::Mat& f, KernelBuffers& b) { computeConvolution(f, b.output, kernel, b.scratch); }, none, always});
+        cases.push_back({"computeConvolution", "filter2d", std::string("kernel=") + convolution.name, true,
+                         [=](const cv::Mat& f, KernelBuffers& b) { cv::filter2D(f, b.output, -1, kernel); }, none, always});
+    }
+    for (int kernelSize : {3, 9, 25}) {
+        cases.push_back({"computeErosion", "opencv", param("ksize", kernelSize), true,
+                         [=](const cv::Mat& f, KernelBuffers& b) { computeErosion(f, b.output, kernelSize, b.scratch); }, none, always});
+        cases.push_back({"computeDilation", "opencv", param("ksize", kernelSize), true,
+                         [=](const cv::Mat& f, KernelBuffers& b) { computeDilation(f, b.output, kernelSize, b.scratch); }, none, always});
+    }
+    for (int low : {50, 100}) {
+        cases.push_back({"computeCanny", "opencv", param("low", low) + " " + param("high", low * 3), true,
+                         [=](const cv::Mat& f, KernelBuffers& b) { computeCanny(f, b.output, low, low * 3, b.scratch); }, none, always});
+    }
+
+    // Color detection: the OpenCV path, the single-pass kernel per instruction set, and the lookup table
+    const struct { const char* choice; const int* lower; const int* upper; } colors[] = {
+        {"HSV", blueLower, blueUpper}, {"BGR", bgrLower, bgrUpper}};
+    for (const auto& color : colors) {
+        const std::string choice = color.choice;
+        int lower[3], upper[3];
+        std::copy(color.lower, color.lower + 3, lower);
+        std::copy(color.upper, color.upper + 3, upper);
+        const std::string range = "space=" + choice;
+        cases.push_back({"computeColorMask", "opencv", range, false,
+                         [=](const cv::Mat& f, KernelBuffers& b) { computeColorMask(f, b.output, choice, lower, upper, b.scratch); },
+                         none, always});
+        for (const char* instructionSet : {"scalar", "sse4.1", "avx2", "avx512"}) {
+            const std::string name = instructionSet;
+            cases.push_back({"computeColorMaskFast", instructionSet, range, false,
+                             [=](const cv::Mat& f, KernelBuffers& b) { computeColorMaskFast(f, b.output, choice, lower, upper); },
+                             none, [=]() { return setColorKernelInstructionSet(name); }});
+        }
+        cases.push_back({"computeColorMaskLut", "lut", range, false,
+                         [=](const cv::Mat& f, KernelBuffers& b) { computeColorMaskLut(f, b.output, choice, lower, upper); },
+                         none, [=]() { waitForColorLut(choice, lower, upper); return true; }});
+    }
+
+    for (int connectivity : {8, 4}) {
+        for (bool contours : {false, true}) {
+            BlobOptions options;
+            options.connectivity = connectivity;
+            options.contours = contours;
+            cases.push_back({"computeBlobs", "runs", param("connectivity", connectivity) + " " + param("contours", contours), true,
+                             [=](const cv::Mat& f, KernelBuffers& b) { computeBlobs(f, b.output, 128, options, b.scratch); },
+                             none, always});
+        }
+    }
+
+    // Packed masks; morphology is timed on the threshold mask of the frame
+    cases.push_back({"computeThresholdMask", "packed", param("threshold", 128), true,
+                     [](const cv::Mat& f, KernelBuffers& b) { computeThresholdMask(f, b.mask, 128); }, none, always});
+    cases.push_back({"computeCannyMask", "packed", param("low", 50) + " " + param("high", 150), true,
+                     [](const cv::Mat& f, KernelBuffers& b) { computeCannyMask(f, b.mask, 50, 150, b.scratch); }, none, always});
+    const KernelFunction thresholdMask = [](const cv::Mat& f, KernelBuffers& b) { computeThresholdMask(f, b.mask, 128); };
+    for (int kernelSize : {3, 9, 25}) {
+        cases.push_back({"computeMaskErosion", "packed", param("ksize", kernelSize), true,
+                         [=](const cv::Mat&, KernelBuffers& b) { computeMaskErosion(b.mask, b.packedOutput, kernelSize, b.scratch); },
+                         thresholdMask, always});
+        cases.push_back({"computeMaskDilation", "packed", param("ksize", kernelSize), true,
+                         [=](const cv::Mat&, KernelBuffers& b) { computeMaskDilation(b.mask, b.packedOutput, kernelSize, b.scratch); },
+                         thresholdMask, always});
+    }
+    return cases;
+}
+
+struct KernelTiming {
+    double p50Ms, p99Ms, meanMs, minMs;
+};
+
+// Time 'iterations' calls of a case, cycling through 'frames'
+static KernelTiming timeCase(const KernelCase& test, const std::vector<cv::Mat>& frames, int iterations) {
+    typedef std::chrono::steady_clock Clock;
+    KernelBuffers buffers;
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    for (int i = 0; i < warmupIterations + iterations; ++i) {
+        const cv::Mat& frame = frames[i % frames.size()];
+        if (test.setup) test.setup(frame, buffers);
+        const Clock::time_point start = Clock::now();
+        test.run(frame, buffers);
+        const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        if (i >= warmupIterations) samples.push_back(ms);
+    }
+    std::sort(samples.begin(), samples.end());
+    KernelTiming timing;
+    timing.p50Ms = samples[samples.size() / 2];
+    timing.p99Ms = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+    timing.minMs = samples.front();
+    double sum = 0;
+    for (double ms : samples) sum += ms;
+    timing.meanMs = sum / samples.size();
+    return timing;
+}
+
+// Identity of a measurement, the same in every run
+static std::string measurementKey(const std::string& kernel, const std::string& variant, const std::string& params,
+                                  const std::string& size, int channels) {
+    return kernel + "|" + variant + "|" + params + "|" + size + "|" + std::to_string(channels);
+}
+
+// Value of "key": in one JSON line written by this program; strings without their quotes
+static std::string jsonField(const std::string& line, const std::string& key) {
+    const std::string pattern = "\"" + key + "\":";
+    size_t start = line.find(pattern);
+    if (start == std::string::npos) return "";
+    start += pattern.size();
+    if (start < line.size() && line[start] == '"') {
+        const size_t end = line.find('"', start + 1);
+        return end == std::string::npos ? "" : line.substr(start + 1, end - start - 1);
+    }
+    const size_t end = line.find_first_of(",}", start);
+    return line.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+// p50 of every measurement in an earlier output, by measurementKey()
+static bool loadBaseline(const std::string& path, std::map<std::string, double>& baseline) {
+    std::ifstream in(path.c_str());
+    if (!in) {
+        std::cerr << "Could not read baseline " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        if (jsonField(line, "bench") != "kernel") continue;
+        baseline[measurementKey(jsonField(line, "kernel"), jsonField(line, "variant"), jsonField(line, "params"),
+                                jsonField(line, "size"), std::atoi(jsonField(line, "channels").c_str()))] =
+            std::atof(jsonField(line, "p50_ms").c_str());
+    }
+    return true;
+}
+
+static void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [--frames N] [--quick] [--filter TEXT] [--json FILE] [--baseline FILE] [--tolerance PCT]" << std::endl;
+    std::cout << "  --frames N       timed calls per measurement (default 50)" << std::endl;
+    std::cout << "  --quick          640x480 only" << std::endl;
+    std::cout << "  --filter TEXT    only kernels or variants whose name contains TEXT" << std::endl;
+    std::cout << "  --json FILE      write the JSON lines to FILE instead of stdout" << std::endl;
+    std::cout << "  --baseline FILE  compare with an earlier --json output; slower p50s fail the run" << std::endl;
+    std::cout << "  --tolerance PCT  p50 slowdown allowed against the baseline (default 15)" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int iterations = 50;
+    bool quick = false;
+    double tolerancePct = 15;
+    std::string filter, jsonPath, baselinePath;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--frames" && hasValue) iterations = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--quick") quick = true;
+        else if (arg == "--filter" && hasValue) filter = argv[++i];
+        else if (arg == "--json" && hasValue) jsonPath = argv[++i];
+        else if (arg == "--baseline" && hasValue) baselinePath = argv[++i];
+        else if (arg == "--tolerance" && hasValue) tolerancePct = std::atof(argv[++i]);
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    std::map<std::string, double> baseline;
+    if (!baselinePath.empty() && !loadBaseline(baselinePath, baseline)) return 2;
+    std::ofstream file;
+    if (!jsonPath.empty()) {
+        file.open(jsonPath.c_str());
+        if (!file) {
+            std::cerr << "Could not write " << jsonPath << std::endl;
+            return 2;
+        }
+    }
+    std::ostream& out = jsonPath.empty() ? std::cout : file;
+    setDisplayEnabled(false);
+
+    const std::string detectedInstructionSet = colorKernelInstructionSet();
+    char line[512];
+    std::snprintf(line, sizeof(line), "{\"bench\":\"environment\",\"opencv\":\"%s\",\"threads\":%d,\"instruction_set\":\"%s\",\"frames\":%d}",
+                  CV_VERSION, cv::getNumThreads(), detectedInstructionSet.c_str(), iterations);
+    out << line << std::endl;
+
+    const std::vector<KernelCase> cases = kernelCases();
+    int regressions = 0, measured = 0;
+    const FrameSize* sizes = quick ? quickSizes : fullSizes;
+    const size_t sizeCount = quick ? sizeof(quickSizes) / sizeof(quickSizes[0]) : sizeof(fullSizes) / sizeof(fullSizes[0]);
+    for (size_t s = 0; s < sizeCount; ++s) {
+        const std::string size = std::to_string(sizes[s].width) + "x" + std::to_string(sizes[s].height);
+        std::vector<cv::Mat> bgrFrames(distinctFrames), grayFrames(distinctFrames);
+        for (int i = 0; i < distinctFrames; ++i) {
+            SyntheticSource::render(bgrFrames[i], sizes[s].width, sizes[s].height, i * 7, 1);
+            cv::cvtColor(bgrFrames[i], grayFrames[i], cv::COLOR_BGR2GRAY);
+        }
+
+        for (const KernelCase& test : cases) {
+            if (!filter.empty() && test.kernel.find(filter) == std::string::npos && test.variant.find(filter) == std::string::npos) continue;
+            if (!test.select()) continue;
+            for (int channels : {3, 1}) {
+                if (channels == 1 && !test.gray) continue;
+                const KernelTiming timing = timeCase(test, channels == 3 ? bgrFrames : grayFrames, iterations);
+                measured++;
+
+                std::string comparison;
+                const std::map<std::string, double>::const_iterator previous =
+                    baseline.find(measurementKey(test.kernel, test.variant, test.params, size, channels));
+                if (previous != baseline.end() && previous->second > 0) {
+                    const double change = 100 * (timing.p50Ms / previous->second - 1);
+                    const bool regressed = change > tolerancePct;
+                    char text[96];
+                    std::snprintf(text, sizeof(text), ",\"baseline_p50_ms\":%.4f,\"change_pct\":%.1f,\"regression\":%s",
+                                  previous->second, change, regressed ? "true" : "false");
+                    comparison = text;
+                    if (regressed) {
+                        regressions++;
+                        std::cerr << "Regression: " << test.kernel << " " << test.variant << " " << test.params << " " << size
+                                  << " channels=" << channels << " p50 " << previous->second << " -> " << timing.p50Ms << " ms" << std::endl;
+                    }
+                }
+                std::snprintf(line, sizeof(line),
+                              "{\"bench\":\"kernel\",\"kernel\":\"%s\",\"variant\":\"%s\",\"params\":\"%s\",\"size\":\"%s\",\"channels\":%d,"
+                              "\"iterations\":%d,\"p50_ms\":%.4f,\"p99_ms\":%.4f,\"mean_ms\":%.4f,\"min_ms\":%.4f%s}",
+                              test.kernel.c_str(), test.variant.c_str(), test.params.c_str(), size.c_str(), channels, iterations,
+                              timing.p50Ms, timing.p99Ms, timing.meanMs, timing.minMs, comparison.c_str());
+                out << line << std::endl;
+            }
+            setColorKernelInstructionSet(detectedInstructionSet);
+        }
+    }
+
+    std::snprintf(line, sizeof(line), "{\"bench\":\"summary\",\"measurements\":%d,\"regressions\":%d,\"tolerance_pct\":%.1f}",
+                  measured, regressions, tolerancePct);
+    out << line << std::endl;
+    return regressions == 0 ? 0 : 1;
+}
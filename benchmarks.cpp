@@ -0,0 +1,1014 @@
+#include "benchmarks.hpp"
+#include "adaptive_pipeline.hpp"
+#include "blobs.hpp"
+#include "color_kernel.hpp"
+#include "color_lut.hpp"
+#include "blur.hpp"
+#include "convolution.hpp"
+#include "frame_source.hpp"
+#include "headless.hpp"
+#include "image_processing.hpp"
+#include "incremental_pipeline.hpp"
+#include "mat_allocator.hpp"
+#include "metrics.hpp"
+#include "packed_mask.hpp"
+#include "pipeline.hpp"
+#include "raw_video.hpp"
+#include "recorder.hpp"
+#include "shm_ring.hpp"
+#include "test_support.hpp"
+#include "thread_pool.hpp"
+#include "tiled_pipeline.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+struct Resolution {
+    const char* name;
+    int width;
+    int height;
+};
+
+static const Resolution benchResolutions[] = {
+    {"720p", 1280, 720},
+    {"1080p", 1920, 1080},
+    {"4K", 3840, 2160},
+};
+
+static const int benchWarmupFrames = 5;
+static const int benchCheckFrames = 8; // Synthetic frames compared against the reference per resolution
+
+// True if both images have the same size, type and pixels
+static bool sameImage(const cv::Mat& a, const cv::Mat& b) {
+    if (a.size() != b.size() || a.type() != b.type()) return false;
+    return a.empty() || cv::norm(a, b, cv::NORM_INF) == 0;
+}
+
+static void printSpeedup(const std::string& label, const HeadlessStats& reference, const HeadlessStats& stats, bool exact) {
+    char line[256];
+    std::snprintf(line, sizeof(line), "%s speedup=%.2fx exact=%s", label.c_str(),
+                  stats.p50Ms > 0 ? reference.p50Ms / stats.p50Ms : 0.0, exact ? "yes" : "NO");
+    std::cout << line << std::endl;
+}
+
+
+// ---------------------------------------------------------------------------
+// color: single-pass color range kernel vs cvtColor + inRange + copyTo
+// ---------------------------------------------------------------------------
+
+struct ColorCase {
+    const char* choice;
+    int lower[3];
+    int upper[3];
+};
+
+static const ColorCase colorCases[] = {
+    {"HSV", {100, 80, 50}, {130, 255, 255}}, // Blue objects, the common tracking setup
+    {"HSV", {0, 0, 0}, {180, 255, 255}},
+    {"BGR", {20, 40, 60}, {200, 220, 240}},
+    {"HSV", {40, 300, 0}, {20, 255, -5}},    // Empty and out-of-range intervals match nothing
+};
+
+static bool benchColor(int frames) {
+    const char* instructionSets[] = {"scalar", "sse4.1", "avx2", "avx512"};
+    const std::string detected = colorKernelInstructionSet();
+    const ColorCase& timed = colorCases[0];
+    bool allExact = true;
+
+    for (const Resolution& resolution : benchResolutions) {
+        SyntheticSource source(resolution.width, resolution.height, 30);
+        ProcessingScratch scratch;
+        cv::Mat frame, expected, actual;
+
+        HeadlessStats reference = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat& input) {
+            computeColorMask(input, expected, timed.choice, timed.lower, timed.upper, scratch);
+        });
+        const std::string prefix = std::string("bench=color size=") + resolution.name;
+        printHeadlessStats(prefix + " impl=opencv", reference);
+
+        for (const char* instructionSet : instructionSets) {
+            if (!setColorKernelInstructionSet(instructionSet)) continue;
+
+            bool exact = true;
+            for (int i = 0; i < benchCheckFrames && exact; ++i) {
+                SyntheticSource::render(frame, resolution.width, resolution.height, i * 7, 1);
+                for (const ColorCase& check : colorCases) {
+                    computeColorMask(frame, expected, check.choice, check.lower, check.upper, scratch);
+                    computeColorMaskFast(frame, actual, check.choice, check.lower, check.upper);
+                    if (!sameImage(expected, actual)) {
+                        exact = false;
+                        break;
+                    }
+                }
+            }
+
+            source.rewind();
+            HeadlessStats stats = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat& input) {
+                computeColorMaskFast(input, actual, timed.choice, timed.lower, timed.upper);
+            });
+            const std::string label = prefix + " impl=" + instructionSet;
+            printHeadlessStats(label, stats);
+            printSpeedup(label, reference, stats, exact);
+            allExact = allExact && exact;
+        }
+    }
+    setColorKernelInstructionSet(detected);
+    return allExact;
+}
+
+
+// ---------------------------------------------------------------------------
+// lut: membership table lookups vs the single-pass kernel, plus rebuild costs
+// ---------------------------------------------------------------------------
+
+static bool benchLut(int frames) {
+    const ColorCase& timed = colorCases[0];
+    bool allExact = true;
+
+    // Rebuilds: the first full build, then moves of one V bound (a shell) and one H bound (everything)
+    ColorCase moved = timed;
+    waitForColorLut(moved.choice, moved.lower, moved.upper);
+    printColorLutStats("bench=lut rebuild=first");
+    moved.upper[2] = 200;
+    waitForColorLut(moved.choice, moved.lower, moved.upper);
+    printColorLutStats("bench=lut rebuild=value");
+    moved.lower[0] = 90;
+    waitForColorLut(moved.choice, moved.lower, moved.upper);
+    printColorLutStats("bench=lut rebuild=hue");
+
+    for (const Resolution& resolution : benchResolutions) {
+        SyntheticSource source(resolution.width, resolution.height, 30);
+        ProcessingScratch scratch;
+        cv::Mat frame, expected, actual;
+        const std::string prefix = std::string("bench=lut size=") + resolution.name;
+
+        bool exact = true;
+        for (int i = 0; i < benchCheckFrames && exact; ++i) {
+            SyntheticSource::render(frame, resolution.width, resolution.height, i * 7, 1);
+            for (const ColorCase& check : colorCases) {
+                waitForColorLut(check.choice, check.lower, check.upper);
+                computeColorMask(frame, expected, check.choice, check.lower, check.upper, scratch);
+                if (!computeColorMaskLut(frame, actual, check.choice, check.lower, check.upper) || !sameImage(expected, actual)) {
+                    exact = false;
+                    break;
+                }
+            }
+        }
+
+        waitForColorLut(timed.choice, timed.lower, timed.upper);
+        HeadlessStats reference = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat& input) {
+            computeColorMaskFast(input, expected, timed.choice, timed.lower, timed.upper);
+        });
+        printHeadlessStats(prefix + " impl=kernel", reference);
+
+        source.rewind();
+        HeadlessStats stats = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat& input) {
+            computeColorMaskLut(input, actual, timed.choice, timed.lower, timed.upper);
+        });
+        printHeadlessStats(prefix + " impl=lut", stats);
+        printSpeedup(prefix + " impl=lut", reference, stats, exact);
+        allExact = allExact && exact;
+    }
+    return allExact;
+}
+
+
+// ---------------------------------------------------------------------------
+// blur: stacked box filters vs cv::GaussianBlur, kernel sizes 3 to 101 at 1080p
+// ---------------------------------------------------------------------------
+
+static bool benchBlur(int frames) {
+    const Resolution& resolution = benchResolutions[1];
+    SyntheticSource source(resolution.width, resolution.height, 30);
+    ProcessingScratch scratch;
+    cv::Mat frame, expected, actual, difference;
+    bool withinBound = true;
+
+    for (int kernelSize = 3; kernelSize <= 101; kernelSize += 2) {
+        source.rewind();
+        HeadlessStats reference = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat& input) {
+            computeBlurred(input, expected, kernelSize, "gaussian", scratch);
+        });
+        source.rewind();
+        HeadlessStats stats = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat& input) {
+            computeBlurred(input, actual, kernelSize, "box", scratch);
+        });
+
+        // Error against the exact Gaussian on a few frames
+        double maxError = 0, meanError = 0;
+        for (int i = 0; i < benchCheckFrames; ++i) {
+            SyntheticSource::render(frame, resolution.width, resolution.height, i * 7, 1);
+            computeBlurred(frame, expected, kernelSize, "gaussian", scratch);
+            computeBlurred(frame, actual, kernelSize, "box", scratch);
+            cv::absdiff(expected, actual, difference);
+            double frameMax = 0;
+            cv::minMaxLoc(difference.reshape(1), 0, &frameMax);
+            cv::Scalar frameMean = cv::mean(difference);
+            maxError = std::max(maxError, frameMax);
+            meanError += (frameMean[0] + frameMean[1] + frameMean[2]) / 3 / benchCheckFrames;
+        }
+        // GaussianBlur itself rounds through fixed point, so allow one level on top of the bound
+        double bound = boxBlurErrorBound(kernelSize);
+        withinBound = withinBound && maxError <= bound + 1;
+
+        char line[384];
+        std::snprintf(line, sizeof(line),
+                      "bench=blur size=%s ksize=%d gaussian_p50_ms=%.3f box_p50_ms=%.3f speedup=%.2fx max_err=%.0f mean_err=%.3f bound=%.1f",
+                      resolution.name, kernelSize, reference.p50Ms, stats.p50Ms,
+                      stats.p50Ms > 0 ? reference.p50Ms / stats.p50Ms : 0.0, maxError, meanError, bound);
+        std::cout << line << std::endl;
+    }
+    return withinBound;
+}
+
+
+// ---------------------------------------------------------------------------
+// conv: strategy picked by the convolution engine vs cv::filter2D
+// ---------------------------------------------------------------------------
+
+// A named test kernel; 'taps' empty means a deterministic pseudo-random kernel of that size
+struct ConvolutionCase {
+    const char* name;
+    int size;
+    std::vector<float> taps;
+};
+
+static cv::Mat convolutionCaseKernel(const ConvolutionCase& test) {
+    if (!test.taps.empty()) return cv::Mat(test.taps, true).reshape(1, test.size);
+    return randomKernel(test.size);
+}
+
+static bool benchConvolution(int frames) {
+    const ConvolutionCase cases[] = {
+        {"sharpen3", 3, {0, -1, 0, -1, 5, -1, 0, -1, 0}},
+        {"gauss3", 3, {1 / 16.f, 2 / 16.f, 1 / 16.f, 2 / 16.f, 4 / 16.f, 2 / 16.f, 1 / 16.f, 2 / 16.f, 1 / 16.f}},
+        {"box3", 3, {1 / 9.f, 1 / 9.f, 1 / 9.f, 1 / 9.f, 1 / 9.f, 1 / 9.f, 1 / 9.f, 1 / 9.f, 1 / 9.f}},
+        {"emboss5", 5, {-2, -1, 0, 0, 0, -1, -1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 1, 2}},
+        {"random5", 5, {}},
+        {"random7", 7, {}},
+        {"random31", 31, {}},
+    };
+    bool allWithin = true;
+
+    for (const Resolution& resolution : benchResolutions) {
+        SyntheticSource source(resolution.width, resolution.height, 30);
+        cv::Mat frame, expected, actual, difference;
+        for (const ConvolutionCase& test : cases) {
+            cv::Mat kernel = convolutionCaseKernel(test);
+            ConvolutionEngine engine;
+            engine.setKernel(kernel);
+
+            double maxError = 0;
+            for (int i = 0; i < benchCheckFrames; ++i) {
+                SyntheticSource::render(frame, resolution.width, resolution.height, i * 7, 1);
+                cv::filter2D(frame, expected, -1, kernel);
+                engine.apply(frame, actual);
+                cv::absdiff(expected, actual, difference);
+                double frameMax = 0;
+                cv::minMaxLoc(difference.reshape(1), 0, &frameMax);
+                maxError = std::max(maxError, frameMax);
+            }
+            bool within = maxError <= engine.tolerance();
+            allWithin = allWithin && within;
+
+            source.rewind();
+            HeadlessStats reference = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat& input) {
+                cv::filter2D(input, expected, -1, kernel);
+            });
+            source.rewind();
+            HeadlessStats stats = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat& input) {
+                engine.apply(input, actual);
+            });
+
+            char line[384];
+            std::snprintf(line, sizeof(line),
+                          "bench=conv size=%s kernel=%s strategy=%s filter2d_p50_ms=%.3f engine_p50_ms=%.3f speedup=%.2fx max_err=%.0f tolerance=%d%s",
+                          resolution.name, test.name, ConvolutionEngine::strategyName(engine.strategy()),
+                          reference.p50Ms, stats.p50Ms, stats.p50Ms > 0 ? reference.p50Ms / stats.p50Ms : 0.0,
+                          maxError, engine.tolerance(), within ? "" : " OUT_OF_TOLERANCE");
+            std::cout << line << std::endl;
+        }
+    }
+    return allWithin;
+}
+
+
+// ---------------------------------------------------------------------------
+// mask: packed 1-bit masks vs 0/255 cv::Mat masks
+// ---------------------------------------------------------------------------
+
+static void printMaskLine(const Resolution& resolution, const std::string& op, const HeadlessStats& reference,
+                          const HeadlessStats& stats, bool exact) {
+    char line[256];
+    std::snprintf(line, sizeof(line), "bench=mask size=%s op=%s opencv_p50_ms=%.3f packed_p50_ms=%.3f",
+                  resolution.name, op.c_str(), reference.p50Ms, stats.p50Ms);
+    printSpeedup(line, reference, stats, exact);
+}
+
+static bool benchMask(int frames) {
+    const int thresholdValue = 128;
+    const ColorCase& color = colorCases[0];
+    const int kernelSizes[] = {3, 9, 25, 51};
+    bool allExact = true;
+
+    for (const Resolution& resolution : benchResolutions) {
+        SyntheticSource source(resolution.width, resolution.height, 30);
+        ProcessingScratch scratch;
+        PackedMask mask, result;
+        cv::Mat frame, expected, actual, hsv;
+
+        // Producers: threshold and color range straight to bits
+        HeadlessStats reference = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat& input) {
+            computeThresholded(input, expected, thresholdValue, scratch);
+        });
+        source.rewind();
+        HeadlessStats stats = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat& input) {
+            computeThresholdMask(input, mask, thresholdValue);
+        });
+        source.rewind();
+        HeadlessStats unpack = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat&) {
+            unpackMask(mask, actual);
+        });
+        bool exact = true;
+        for (int i = 0; i < benchCheckFrames; ++i) {
+            SyntheticSource::render(frame, resolution.width, resolution.height, i * 7, 1);
+            computeThresholded(frame, expected, thresholdValue, scratch);
+            computeThresholdMask(frame, mask, thresholdValue);
+            unpackMask(mask, actual);
+            exact = exact && sameImage(expected, actual);
+        }
+        printMaskLine(resolution, "threshold", reference, stats, exact);
+        allExact = allExact && exact;
+
+        source.rewind();
+        reference = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat& input) {
+            cv::cvtColor(input, hsv, cv::COLOR_BGR2HSV);
+            cv::inRange(hsv, cv::Scalar(color.lower[0], color.lower[1], color.lower[2]),
+                        cv::Scalar(color.upper[0], color.upper[1], color.upper[2]), expected);
+        });
+        source.rewind();
+        stats = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat& input) {
+            colorRangeToMask(input, color.choice, color.lower, color.upper, mask);
+        });
+        exact = true;
+        for (int i = 0; i < benchCheckFrames; ++i) {
+            SyntheticSource::render(frame, resolution.width, resolution.height, i * 7, 1);
+            cv::cvtColor(frame, hsv, cv::COLOR_BGR2HSV);
+            cv::inRange(hsv, cv::Scalar(color.lower[0], color.lower[1], color.lower[2]),
+                        cv::Scalar(color.upper[0], color.upper[1], color.upper[2]), expected);
+            colorRangeToMask(frame, color.choice, color.lower, color.upper, mask);
+            unpackMask(mask, actual);
+            exact = exact && sameImage(expected, actual);
+        }
+        printMaskLine(resolution, "inrange", reference, stats, exact);
+        allExact = allExact && exact;
+
+        // Morphology on the threshold mask of one frame
+        SyntheticSource::render(frame, resolution.width, resolution.height, 0, 1);
+        cv::Mat source8u;
+        computeThresholded(frame, source8u, thresholdValue, scratch);
+        PackedMask sourceMask;
+        computeThresholdMask(frame, sourceMask, thresholdValue);
+        for (int kernelSize : kernelSizes) {
+            for (int dilate = 0; dilate < 2; ++dilate) {
+                source.rewind();
+                reference = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat&) {
+                    if (dilate) computeDilation(source8u, expected, kernelSize, scratch);
+                    else computeErosion(source8u, expected, kernelSize, scratch);
+                });
+                source.rewind();
+                stats = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat&) {
+                    if (dilate) computeMaskDilation(sourceMask, result, kernelSize, scratch);
+                    else computeMaskErosion(sourceMask, result, kernelSize, scratch);
+                });
+                unpackMask(result, actual);
+                exact = sameImage(expected, actual);
+                printMaskLine(resolution, std::string(dilate ? "dilate" : "erode") + " ksize=" + std::to_string(kernelSize),
+                              reference, stats, exact);
+                allExact = allExact && exact;
+            }
+        }
+
+        char line[256];
+        std::snprintf(line, sizeof(line), "bench=mask size=%s unpack_p50_ms=%.3f mask_bytes_8u=%zu mask_bytes_packed=%zu",
+                      resolution.name, unpack.p50Ms, source8u.total(), sourceMask.bits.size() * sizeof(uint64_t));
+        std::cout << line << std::endl;
+    }
+    return allExact;
+}
+
+
+// ---------------------------------------------------------------------------
+// scaling: tile-parallel chains on 1..N threads vs the whole-frame pipeline
+// ---------------------------------------------------------------------------
+
+static bool benchScaling(int frames) {
+    const char* chains[] = {"3", "3C9A", "49A", "3C9AB"};
+    const int hardwareThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < hardwareThreads; threads *= 2) threadCounts.push_back(threads);
+    threadCounts.push_back(hardwareThreads);
+    ProcessingParams params;
+    bool allExact = true;
+
+    for (const Resolution& resolution : benchResolutions) {
+        if (resolution.height < 1080) continue; // Strips only pay off once a frame outgrows the caches
+        SyntheticSource source(resolution.width, resolution.height, 30);
+        cv::Mat frame;
+        for (const char* chain : chains) {
+            Pipeline pipeline;
+            pipeline.configure(chain);
+            HeadlessStats reference = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat& input) {
+                pipeline.run(input, params);
+            });
+            HeadlessStats single;
+            for (int threads : threadCounts) {
+                ThreadPool pool(threads);
+                TiledPipeline tiled(pool);
+                tiled.configure(chain);
+                source.rewind();
+                const uint64_t steals = pool.steals();
+                HeadlessStats stats = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat& input) {
+                    tiled.run(input, params);
+                });
+                if (threads == 1) single = stats;
+                bool exact = true;
+                for (int i = 0; i < benchCheckFrames; ++i) {
+                    SyntheticSource::render(frame, resolution.width, resolution.height, i * 7, 1);
+                    exact = exact && sameImage(pipeline.run(frame, params), tiled.run(frame, params));
+                }
+                char line[256];
+                std::snprintf(line, sizeof(line),
+                              "bench=scaling size=%s chain=%s threads=%d frame_p50_ms=%.3f tiled_p50_ms=%.3f"
+                              " vs_1_thread=%.2fx steals=%llu",
+                              resolution.name, chain, threads, reference.p50Ms, stats.p50Ms,
+                              stats.p50Ms > 0 ? single.p50Ms / stats.p50Ms : 0.0,
+                              static_cast<unsigned long long>(pool.steals() - steals));
+                printSpeedup(line, reference, stats, exact);
+                allExact = allExact && exact;
+            }
+            source.rewind();
+        }
+    }
+    return allExact;
+}
+
+
+// ---------------------------------------------------------------------------
+// shm: publishing to the shared-memory ring, with a reader mapping the frames
+// ---------------------------------------------------------------------------
+
+static bool benchShm(int frames) {
+    const int slots = 4;
+    const int distinctFrames = 8;
+    bool allExact = true;
+
+    for (const Resolution& resolution : benchResolutions) {
+        std::vector<cv::Mat> images(distinctFrames);
+        for (int i = 0; i < distinctFrames; ++i) {
+            SyntheticSource::render(images[i], resolution.width, resolution.height, i * 7, 1);
+        }
+        const size_t frameBytes = images[0].total() * images[0].elemSize();
+        ShmFrameWriter writer;
+        if (!writer.create("webcam_bench_shm", slots, frameBytes)) return false;
+
+        // A reader in another thread maps the ring as another process would and checks every frame it gets
+        std::atomic<bool> stop(false);
+        long read = 0, torn = 0, wrong = 0;
+        std::thread readerThread([&]() {
+            ShmFrameReader reader;
+            reader.open(writer.name());
+            ShmFrame frame;
+            for (;;) {
+                const bool stopping = stop.load(std::memory_order_acquire);
+                if (!reader.next(frame)) {
+                    if (stopping) break;
+                    continue;
+                }
+                const bool same = sameImage(frame.image, images[frame.frame % distinctFrames]);
+                if (!reader.valid(frame)) torn++;
+                else if (!same) wrong++;
+                else read++;
+            }
+        });
+
+        SyntheticSource source(resolution.width, resolution.height, 30);
+        int index = 0;
+        HeadlessStats stats = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat&) {
+            writer.publish(images[index++ % distinctFrames], "bench", shmTimestampNow());
+        });
+        stop.store(true, std::memory_order_release);
+        readerThread.join();
+
+        const bool exact = wrong == 0;
+        char line[256];
+        std::snprintf(line, sizeof(line),
+                      "bench=shm size=%s slots=%d publish_p50_ms=%.3f publish_p99_ms=%.3f gb_per_s=%.2f"
+                      " read=%ld torn=%ld wrong=%ld exact=%s",
+                      resolution.name, slots, stats.p50Ms, stats.p99Ms,
+                      stats.p50Ms > 0 ? frameBytes / (stats.p50Ms * 1e6) : 0.0, read, torn, wrong, exact ? "yes" : "NO");
+        std::cout << line << std::endl;
+        allExact = allExact && exact;
+    }
+    return allExact;
+}
+
+
+// ---------------------------------------------------------------------------
+// raw: memory-mapped raw and Y4M replay, written by RawVideoWriter
+// ---------------------------------------------------------------------------
+
+static bool benchRaw(int frames) {
+    const int distinctFrames = 30;
+    bool allExact = true;
+
+    for (const Resolution& resolution : benchResolutions) {
+        std::vector<cv::Mat> images(distinctFrames);
+        for (int i = 0; i < distinctFrames; ++i) {
+            SyntheticSource::render(images[i], resolution.width, resolution.height, i, 1);
+        }
+        const std::string base = std::string("/tmp/webcam_bench_") + resolution.name;
+        const char* formats[] = {".bgr", ".y4m"};
+        for (const char* format : formats) {
+            const std::string path = base + format;
+            RawVideoWriter writer;
+            writer.open(path, 30);
+            SyntheticSource timing(resolution.width, resolution.height, 30);
+            int index = 0;
+            HeadlessStats writeStats = runHeadless(timing, distinctFrames, 0, [&](const cv::Mat&) {
+                writer.write(images[index++]);
+            });
+            const uint64_t bytes = writer.bytes();
+            writer.close();
+
+            RawVideoSource source(path);
+            if (!source.isOpened() || source.frameCount() != distinctFrames) {
+                std::cerr << "Could not replay " << path << std::endl;
+                allExact = false;
+                continue;
+            }
+            cv::Mat frame;
+            HeadlessStats readStats = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat& input) {
+                frame = input; // Reading is the measurement
+            });
+            // Raw frames must come back bit-exact; Y4M goes through YCrCb and may be a level off
+            double maxDifference = 0;
+            for (int i = 0; i < distinctFrames; ++i) {
+                source.frameAt(i, frame);
+                maxDifference = std::max(maxDifference, cv::norm(frame, images[i], cv::NORM_INF));
+            }
+            const bool exact = source.isZeroCopy() ? maxDifference == 0 : maxDifference <= 2;
+            char line[256];
+            std::snprintf(line, sizeof(line),
+                          "bench=raw size=%s format=%s zero_copy=%s write_p50_ms=%.3f read_p50_ms=%.3f file_mb=%.1f"
+                          " max_diff=%.0f exact=%s",
+                          resolution.name, format + 1, source.isZeroCopy() ? "yes" : "no", writeStats.p50Ms,
+                          readStats.p50Ms, bytes / 1e6, maxDifference, exact ? "yes" : "NO");
+            std::cout << line << std::endl;
+            allExact = allExact && exact;
+            std::remove(path.c_str());
+            std::remove((path + ".desc").c_str());
+        }
+    }
+    return allExact;
+}
+
+
+// ---------------------------------------------------------------------------
+// record: per-frame cost on the processing thread, writing inline vs queueing for AsyncRecorder
+// ---------------------------------------------------------------------------
+
+static bool benchRecord(int frames) {
+    bool allExact = true;
+    for (const Resolution& resolution : benchResolutions) {
+        const char* formats[] = {".bgr", ".avi"};
+        for (const char* format : formats) {
+            const std::string inlinePath = std::string("/tmp/webcam_bench_inline_") + resolution.name + format;
+            const std::string asyncPath = std::string("/tmp/webcam_bench_async_") + resolution.name + format;
+            const bool encoded = std::string(format) == ".avi";
+
+            // Inline: the frame is encoded and written before the next one is processed
+            RawVideoWriter raw;
+            cv::VideoWriter video;
+            if (!encoded) raw.open(inlinePath, 30);
+            SyntheticSource inlineSource(resolution.width, resolution.height, 30);
+            HeadlessStats inlineStats = runHeadless(inlineSource, frames, benchWarmupFrames, [&](const cv::Mat& frame) {
+                if (!encoded) {
+                    raw.write(frame);
+                } else {
+                    if (!video.isOpened()) video.open(inlinePath, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), 30, frame.size(), true);
+                    video.write(frame);
+                }
+            });
+            raw.close();
+            video.release();
+
+            // Async: the frame is copied into the queue; Block so that both files get every frame
+            RecorderOptions options;
+            options.path = asyncPath;
+            options.policy = RecordPolicy::Block;
+            AsyncRecorder recorder(options);
+            if (!recorder.start()) return false;
+            SyntheticSource asyncSource(resolution.width, resolution.height, 30);
+            HeadlessStats asyncStats = runHeadless(asyncSource, frames, benchWarmupFrames, [&](const cv::Mat& frame) {
+                recorder.submit(frame);
+            });
+            recorder.close();
+            const RecorderStats stats = recorder.stats();
+
+            // Every frame must reach the file, and raw files must come out the same size
+            bool exact = stats.written == stats.submitted && stats.failed == 0;
+            if (!encoded) exact = exact && raw.bytes() == stats.bytes;
+            char line[256];
+            std::snprintf(line, sizeof(line),
+                          "bench=record size=%s format=%s inline_p50_ms=%.3f inline_p99_ms=%.3f async_p50_ms=%.3f async_p99_ms=%.3f"
+                          " write_mean_ms=%.3f max_depth=%zu blocked_ms=%.1f",
+                          resolution.name, format + 1, inlineStats.p50Ms, inlineStats.p99Ms, asyncStats.p50Ms, asyncStats.p99Ms,
+                          stats.meanWriteMs, stats.maxDepth, stats.blockedMs);
+            printSpeedup(line, inlineStats, asyncStats, exact);
+            allExact = allExact && exact;
+            for (const std::string& path : {inlinePath, asyncPath}) {
+                std::remove(path.c_str());
+                std::remove((path + ".desc").c_str());
+            }
+        }
+    }
+    return allExact;
+}
+
+// ---------------------------------------------------------------------------
+// incremental: a static scene with one moving object, dirty tiles vs whole frames
+// ---------------------------------------------------------------------------
+
+// Static background with a square from another frame moved 'step' pixels per frame along a diagonal
+class MovingObjectScene {
+public:
+    MovingObjectScene(int width, int height) : width(width), height(height) {
+        SyntheticSource::render(background, width, height, 0, 1);
+        SyntheticSource::render(object, width, height, 37, 1);
+        background.copyTo(scene);
+    }
+
+    const cv::Mat& frame(int index) {
+        cv::Mat previous = scene(square);
+        background(square).copyTo(previous); // Erase the object where it was
+        const int travel = std::max(1, std::min(width, height) - size);
+        const int offset = (index * step) % travel;
+        square = cv::Rect(offset, offset * (height - size) / travel, size, size);
+        cv::Mat target = scene(square);
+        object(square).copyTo(target);
+        return scene;
+    }
+
+private:
+    static const int size = 96, step = 4;
+    int width, height;
+    cv::Mat background, object, scene;
+    cv::Rect square;
+};
+
+static bool benchIncremental(int frames) {
+    const char* chains[] = {"3", "3C9A", "49A", "3C9AB"};
+    ProcessingParams params;
+    bool allExact = true;
+
+    for (const Resolution& resolution : benchResolutions) {
+        SyntheticSource timing(resolution.width, resolution.height, 30);
+        for (const char* chain : chains) {
+            Pipeline pipeline;
+            pipeline.configure(chain);
+            IncrementalPipeline incremental;
+            incremental.configure(chain);
+
+            MovingObjectScene scene(resolution.width, resolution.height);
+            int index = 0;
+            HeadlessStats reference = runHeadless(timing, frames, benchWarmupFrames, [&](const cv::Mat&) {
+                pipeline.run(scene.frame(index++), params);
+            });
+            index = 0;
+            HeadlessStats stats = runHeadless(timing, frames, benchWarmupFrames, [&](const cv::Mat&) {
+                incremental.run(scene.frame(index++), params);
+            });
+            const IncrementalStats counts = incremental.stats();
+
+            bool exact = true;
+            for (int i = 0; i < benchCheckFrames; ++i) {
+                const cv::Mat& frame = scene.frame(index++);
+                exact = exact && sameImage(pipeline.run(frame, params), incremental.run(frame, params));
+            }
+            char line[256];
+            std::snprintf(line, sizeof(line), "bench=incremental size=%s chain=%s engine=%s skipped_pct=%.1f",
+                          resolution.name, chain, incremental.describe().c_str(),
+                          counts.tiles ? 100.0 * counts.skippedTiles / counts.tiles : 0.0);
+            printSpeedup(line, reference, stats, exact);
+            allExact = allExact && exact;
+            timing.rewind();
+        }
+    }
+    return allExact;
+}
+
+
+// ---------------------------------------------------------------------------
+// blobs: run-length union-find labeling vs findContours on masks with thousands of objects
+// ---------------------------------------------------------------------------
+
+static bool sameBlobs(const cv::Mat& mask, const std::vector<Blob>& blobs, int connectivity) {
+    std::vector<Blob> expected;
+    referenceBlobs(mask, connectivity, expected);
+    return blobDifferences(expected, blobs) == 0;
+}
+
+static bool benchBlobs(int frames) {
+    const int objectsPerMegapixel = 2000;
+    bool allExact = true;
+
+    for (const Resolution& resolution : benchResolutions) {
+        // Discs and squares of a few pixels, some overlapping into larger shapes
+        cv::Mat mask = cv::Mat::zeros(resolution.height, resolution.width, CV_8UC1);
+        cv::RNG rng(7);
+        const int objects = objectsPerMegapixel * resolution.width / 1000 * resolution.height / 1000;
+        for (int i = 0; i < objects; ++i) {
+            const cv::Point center(rng.uniform(0, resolution.width), rng.uniform(0, resolution.height));
+            const int size = rng.uniform(1, 9);
+            if (i % 2) cv::circle(mask, center, size, cv::Scalar(255), -1);
+            else cv::rectangle(mask, cv::Rect(center.x, center.y, size, 2 * size), cv::Scalar(255), -1);
+        }
+        PackedMask packed;
+        packMask(mask, packed);
+
+        SyntheticSource timing(resolution.width, resolution.height, 30);
+        std::vector<std::vector<cv::Point> > contours;
+        std::vector<Blob> reference;
+        cv::Mat work;
+        HeadlessStats findContoursStats = runHeadless(timing, frames, benchWarmupFrames, [&](const cv::Mat&) {
+            mask.copyTo(work); // findContours may modify its input in older releases
+            cv::findContours(work, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+            reference.resize(contours.size());
+            for (size_t k = 0; k < contours.size(); ++k) {
+                const cv::Moments moments = cv::moments(contours[k]);
+                reference[k].box = cv::boundingRect(contours[k]);
+                reference[k].area = static_cast<int>(moments.m00);
+                if (moments.m00 > 0) reference[k].centroid = cv::Point2f(moments.m10 / moments.m00, moments.m01 / moments.m00);
+            }
+        });
+
+        BlobWork blobWork;
+        std::vector<Blob> blobs;
+        for (int connectivity : {8, 4}) {
+            for (bool withContours : {false, true}) {
+                BlobOptions options;
+                options.connectivity = connectivity;
+                options.contours = withContours;
+                timing.rewind();
+                HeadlessStats stats = runHeadless(timing, frames, benchWarmupFrames, [&](const cv::Mat&) {
+                    extractBlobs(packed, blobs, options, blobWork);
+                });
+                const bool exact = sameBlobs(mask, blobs, connectivity);
+                char line[256];
+                std::snprintf(line, sizeof(line), "bench=blobs size=%s connectivity=%d contours=%s blobs=%zu contours_found=%zu ref_ms=%.2f ms=%.2f",
+                              resolution.name, connectivity, withContours ? "yes" : "no", blobs.size(), contours.size(),
+                              findContoursStats.p50Ms, stats.p50Ms);
+                printSpeedup(line, findContoursStats, stats, exact);
+                allExact = allExact && exact;
+            }
+        }
+    }
+    return allExact;
+}
+
+
+// ---------------------------------------------------------------------------
+// adaptive: latency under a budget half the full-quality frame time
+// ---------------------------------------------------------------------------
+
+static bool benchAdaptive(int frames) {
+    const char* chains[] = {"3", "3C9A", "3C9AB"};
+    ProcessingParams params;
+    bool allShaped = true;
+    std::ostringstream decisions; // The per-decision lines would drown the results
+
+    for (const Resolution& resolution : benchResolutions) {
+        SyntheticSource source(resolution.width, resolution.height, 30);
+        for (const char* chain : chains) {
+            Pipeline pipeline;
+            pipeline.configure(chain);
+            HeadlessStats reference = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat& frame) {
+                pipeline.run(frame, params);
+            });
+
+            AdaptiveOptions options;
+            options.budgetMs = reference.p50Ms / 2;
+            AdaptivePipeline adaptive(options, decisions);
+            adaptive.configure(chain);
+            source.rewind();
+            HeadlessStats stats = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat& frame) {
+                adaptive.run(frame, params);
+            });
+
+            // Whatever the level, the output must look like a full-quality one to whoever consumes it
+            bool shaped = true;
+            cv::Mat frame;
+            for (int i = 0; i < benchCheckFrames; ++i) {
+                SyntheticSource::render(frame, resolution.width, resolution.height, i * 7, 1);
+                const cv::Mat& expected = pipeline.run(frame, params);
+                const cv::Mat& actual = adaptive.run(frame, params);
+                shaped = shaped && expected.size() == actual.size() && expected.type() == actual.type();
+            }
+            char line[256];
+            std::snprintf(line, sizeof(line),
+                          "bench=adaptive size=%s chain=%s budget_ms=%.2f full_p99_ms=%.2f adaptive_p50_ms=%.2f adaptive_p99_ms=%.2f final=%s decisions=%llu shape=%s",
+                          resolution.name, chain, options.budgetMs, reference.p99Ms, stats.p50Ms, stats.p99Ms,
+                          adaptive.levels()[adaptive.level()].name, static_cast<unsigned long long>(adaptive.stats().decisions),
+                          shaped ? "yes" : "NO");
+            std::cout << line << std::endl;
+            allShaped = allShaped && shaped;
+            source.rewind();
+        }
+    }
+    return allShaped;
+}
+
+
+// ---------------------------------------------------------------------------
+// pool: per-frame cv::Mat temporaries with the counting (heap) and the pooled allocator
+// ---------------------------------------------------------------------------
+
+// Color isolation the way it was written before the compute API: every buffer is a new cv::Mat
+static void isolateWithTemporaries(const cv::Mat& frame, cv::Mat& output) {
+    cv::Mat hsv, mask, result;
+    cv::cvtColor(frame, hsv, cv::COLOR_BGR2HSV);
+    cv::inRange(hsv, cv::Scalar(0, 50, 50), cv::Scalar(30, 255, 255), mask);
+    cv::bitwise_and(frame, frame, result, mask);
+    output = result;
+}
+
+static bool benchPool(int frames) {
+    cv::MatAllocator* const installed = cv::Mat::getDefaultAllocator();
+    const int hardwareThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    bool allExact = true;
+
+    for (const Resolution& resolution : benchResolutions) {
+        for (int threads : {1, hardwareThreads}) {
+            // Every thread processes its own copy of the frame, like streams sharing a process
+            ThreadPool pool(threads);
+            std::vector<cv::Mat> outputs;
+            cv::Mat checked[2];
+            HeadlessStats stats[2];
+            for (int pooled = 0; pooled < 2; ++pooled) {
+                if (pooled) installPooledAllocator();
+                else installCountingAllocator();
+                outputs.assign(threads, cv::Mat());
+                SyntheticSource source(resolution.width, resolution.height, 30);
+                stats[pooled] = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat& frame) {
+                    pool.run(threads, [&](int index, int) { isolateWithTemporaries(frame, outputs[index]); });
+                });
+                cv::Mat frame;
+                SyntheticSource::render(frame, resolution.width, resolution.height, 0, 1);
+                isolateWithTemporaries(frame, checked[pooled]);
+            }
+            const bool exact = sameImage(checked[0], checked[1]);
+            char line[256];
+            std::snprintf(line, sizeof(line), "bench=pool size=%s threads=%d heap_fresh_per_frame=%.2f pooled_fresh_per_frame=%.2f allocs_per_frame=%.2f",
+                          resolution.name, threads, stats[0].freshAllocationsPerFrame, stats[1].freshAllocationsPerFrame,
+                          stats[1].allocationsPerFrame);
+            printSpeedup(line, stats[0], stats[1], exact);
+            allExact = allExact && exact;
+        }
+    }
+    cv::Mat::setDefaultAllocator(installed);
+    const AllocationStats totals = getAllocationStats();
+    std::cout << "bench=pool hits=" << totals.poolHits << " misses=" << totals.poolMisses
+              << " peak_footprint_bytes=" << totals.peakFootprintBytes << std::endl;
+    return allExact;
+}
+
+
+// ---------------------------------------------------------------------------
+// metrics: cost of a timed scope against the frame time of a typical chain
+// ---------------------------------------------------------------------------
+
+static bool benchMetrics(int frames) {
+#ifndef DISABLE_METRICS
+    typedef std::chrono::steady_clock Clock;
+    const int scopes = 1000000;
+    const int hardwareThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    // Percentiles must stay within the bucket precision (1/32 of the value, reported mid-bucket)
+    LatencyHistogram accuracy;
+    for (int i = 1; i <= 100000; ++i) accuracy.record(static_cast<int64_t>(i) * 997);
+    const LatencyHistogram::Snapshot snapshot = accuracy.snapshot();
+    double worstError = 0;
+    for (double pct : {1.0, 50.0, 90.0, 99.0, 99.9}) {
+        const double expected = std::ceil(pct / 100 * 100000 - 1e-6) * 997;
+        worstError = std::max(worstError, std::fabs(snapshot.percentileNs(pct) - expected) / expected);
+    }
+    const bool exact = snapshot.count == 100000 && worstError <= 1.0 / 64 + 1e-9;
+
+    // Timed scopes, alone and with every hardware thread recording into the same histogram
+    double scopeNs[2] = {0, 0};
+    const int threadCounts[2] = {1, hardwareThreads};
+    for (int t = 0; t < 2; ++t) {
+        LatencyHistogram histogram;
+        std::vector<std::thread> threads;
+        std::atomic<int64_t> elapsedNs(0);
+        for (int k = 0; k < threadCounts[t]; ++k) {
+            threads.emplace_back([&]() {
+                const Clock::time_point start = Clock::now();
+                for (int i = 0; i < scopes; ++i) ScopedTimer timer(&histogram);
+                elapsedNs += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+            });
+        }
+        for (std::thread& thread : threads) thread.join();
+        scopeNs[t] = static_cast<double>(elapsedNs) / (static_cast<double>(scopes) * threadCounts[t]);
+    }
+
+    ProcessingParams params;
+    bool withinBudget = true;
+    for (const Resolution& resolution : benchResolutions) {
+        SyntheticSource source(resolution.width, resolution.height, 30);
+        const char* chain = "3C9AB";
+        Pipeline pipeline;
+        pipeline.configure(chain);
+        cv::Mat output;
+        HeadlessStats stats = runHeadless(source, frames, benchWarmupFrames, [&](const cv::Mat& input) {
+            ScopedTimer timer(operationHistogram('D'));
+            pipeline.run(input, params).copyTo(output);
+        });
+        // One scope per group and one for the whole frame, at the contended cost
+        const std::string described = pipeline.describe();
+        const int scopesPerFrame = 2 + static_cast<int>(std::count(described.begin(), described.end(), '-')); // Groups + 1
+        const double overhead = stats.p50Ms > 0 ? scopesPerFrame * scopeNs[1] / (stats.p50Ms * 1e6) : 0;
+        withinBudget = withinBudget && overhead < 0.01;
+        char line[256];
+        std::snprintf(line, sizeof(line),
+                      "bench=metrics size=%s chain=%s scope_ns=%.1f scope_ns_%d_threads=%.1f scopes_per_frame=%d"
+                      " frame_p50_ms=%.3f overhead_pct=%.4f percentile_error_pct=%.2f exact=%s",
+                      resolution.name, chain, scopeNs[0], hardwareThreads, scopeNs[1], scopesPerFrame, stats.p50Ms,
+                      overhead * 100, worstError * 100, exact ? "yes" : "NO");
+        std::cout << line << std::endl;
+    }
+    if (!withinBudget) std::cout << "bench=metrics warning: timing costs 1% of a frame or more" << std::endl;
+    return exact;
+#else
+    (void)frames;
+    std::cout << "bench=metrics skipped: built with DISABLE_METRICS" << std::endl;
+    return true;
+#endif
+}
+
+
+struct Benchmark {
+    const char* name;
+    bool (*run)(int frames);
+};
+
+static const Benchmark benchmarks[] = {
+    {"color", benchColor},
+    {"lut", benchLut},
+    {"blur", benchBlur},
+    {"conv", benchConvolution},
+    {"mask", benchMask},
+    {"scaling", benchScaling},
+    {"shm", benchShm},
+    {"raw", benchRaw},
+    {"record", benchRecord},
+    {"metrics", benchMetrics},
+    {"incremental", benchIncremental},
+    {"adaptive", benchAdaptive},
+    {"blobs", benchBlobs},
+    {"pool", benchPool},
+};
+
+bool runBenchmark(const std::string& name, int frames) {
+    bool found = false, passed = true;
+    for (const Benchmark& benchmark : benchmarks) {
+        if (name != "all" && name != benchmark.name) continue;
+        found = true;
+        if (!benchmark.run(frames)) {
+            std::cerr << "Benchmark " << benchmark.name << ": results differ from the reference" << std::endl;
+            passed = false;
+        }
+    }
+    if (!found) {
+        std::cerr << "Unknown benchmark: " << name << " (expected one of: " << benchmarkNames() << " all)" << std::endl;
+    }
+    return found && passed;
+}
+
+std::string benchmarkNames() {
+    std::string names;
+    for (const Benchmark& benchmark : benchmarks) {
+        if (!names.empty()) names += " ";
+        names += benchmark.name;
+    }
+    return names;
+}
@@ -0,0 +1,15 @@
+#ifndef BENCHMARKS_HPP
+#define BENCHMARKS_HPP
+
+#include <string>
+
+// Kernel micro-benchmarks: each one times an optimized kernel against a reference
+// path on synthetic frames (at 720p, 1080p and 4K, or a parameter sweep at 1080p), checks
+// the results match or stay within their documented error bound and prints one line per
+// measurement. Returns false for an unknown name or a mismatch.
+bool runBenchmark(const std::string& name, int frames);
+
+// Names accepted by runBenchmark(), separated by spaces
+std::string benchmarkNames();
+
+#endif // BENCHMARKS_HPP
@@ -0,0 +1,171 @@
+#include "blobs.hpp"
+#include <algorithm>
+
+
+static const int minStripRows = 64; // Thinner strips cost more in joining than they save in parallel
+
+// Append the runs of one packed row
+static void encodeRow(const uint64_t* row, int words, int cols, std::vector<MaskRun>& runs) {
+    bool open = false;
+    int start = 0;
+    for (int i = 0; i < words; i++) {
+        uint64_t bits = open ? ~row[i] : row[i]; // Set where the next change (0 -> 1 or 1 -> 0) can be
+        while (bits) {
+            const int b = __builtin_ctzll(bits);
+            if (open) runs.push_back(MaskRun{start, 64 * i + b});
+            else start = 64 * i + b;
+            open = !open;
+            bits = ~bits & (~uint64_t(0) << b);
+        }
+    }
+    if (open) runs.push_back(MaskRun{start, cols});
+}
+
+static int findRoot(int* parent, int i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]]; // Path halving
+        i = parent[i];
+    }
+    return i;
+}
+
+// Join two sets; the smaller run index becomes the root, so every root is its blob's first run
+static void unite(int* parent, int a, int b) {
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    if (a < b) parent[b] = a;
+    else if (b < a) parent[a] = b;
+}
+
+// Join the runs [below, belowEnd) of a row with the runs [above, aboveEnd) of the row above
+// that touch them. 'reach' is 1 for 8-connectivity (diagonal neighbours count), 0 for 4.
+static void joinRows(const MaskRun* runs, int* parent, int above, int aboveEnd, int below, int belowEnd, int reach) {
+    for (int c = below; c < belowEnd; c++) {
+        while (above < aboveEnd && runs[above].x1 + reach <= runs[c].x0) above++;
+        for (int p = above; p < aboveEnd && runs[p].x0 < runs[c].x1 + reach; p++) unite(parent, p, c);
+    }
+}
+
+// Encode and label rows [y0, y1) on their own
+static void labelStrip(const PackedMask& mask, int y0, int y1, int reach, std::vector<MaskRun>& runs,
+                       std::vector<int>& rowStart, std::vector<int>& parent) {
+    runs.clear();
+    rowStart.resize(y1 - y0 + 1);
+    for (int y = y0; y < y1; y++) {
+        rowStart[y - y0] = static_cast<int>(runs.size());
+        encodeRow(mask.row(y), mask.words, mask.cols, runs);
+    }
+    rowStart[y1 - y0] = static_cast<int>(runs.size());
+    parent.resize(runs.size());
+    for (size_t i = 0; i < parent.size(); i++) parent[i] = static_cast<int>(i);
+    for (int r = 1; r < y1 - y0; r++) {
+        joinRows(runs.data(), parent.data(), rowStart[r - 1], rowStart[r], rowStart[r], rowStart[r + 1], reach);
+    }
+}
+
+// Label every strip in parallel, then join them into the whole-mask runs and forest
+static void labelStrips(const PackedMask& mask, int strips, int reach, BlobWork& work) {
+    work.stripRuns.resize(strips);
+    work.stripRowStart.resize(strips);
+    work.stripParent.resize(strips);
+    cv::parallel_for_(cv::Range(0, strips), [&](const cv::Range& range) {
+        for (int s = range.start; s < range.end; s++) {
+            labelStrip(mask, mask.rows * s / strips, mask.rows * (s + 1) / strips, reach,
+                       work.stripRuns[s], work.stripRowStart[s], work.stripParent[s]);
+        }
+    });
+
+    work.runs.clear();
+    work.parent.clear();
+    work.rowStart.clear();
+    for (int s = 0; s < strips; s++) {
+        const int offset = static_cast<int>(work.runs.size());
+        work.runs.insert(work.runs.end(), work.stripRuns[s].begin(), work.stripRuns[s].end());
+        for (int parent : work.stripParent[s]) work.parent.push_back(parent + offset);
+        const std::vector<int>& rowStart = work.stripRowStart[s];
+        for (size_t r = 0; r + 1 < rowStart.size(); r++) work.rowStart.push_back(rowStart[r] + offset);
+    }
+    work.rowStart.push_back(static_cast<int>(work.runs.size()));
+    for (int s = 1; s < strips; s++) {
+        const int cut = mask.rows * s / strips;
+        joinRows(work.runs.data(), work.parent.data(), work.rowStart[cut - 1], work.rowStart[cut],
+                 work.rowStart[cut], work.rowStart[cut + 1], reach);
+    }
+}
+
+void extractBlobs(const PackedMask& mask, std::vector<Blob>& blobs, const BlobOptions& options, BlobWork& work) {
+    const int reach = options.connectivity == 4 ? 0 : 1;
+    const int strips = std::max(1, std::min(cv::getNumThreads(), mask.rows / minStripRows));
+    if (strips == 1) labelStrip(mask, 0, mask.rows, reach, work.runs, work.rowStart, work.parent);
+    else labelStrips(mask, strips, reach, work);
+
+    // Number the roots in run order and add every run to its blob
+    std::vector<BlobWork::Tally>& tallies = work.tallies;
+    tallies.clear();
+    work.label.resize(work.runs.size());
+    int* parent = work.parent.data();
+    for (int y = 0; y < mask.rows; y++) {
+        for (int i = work.rowStart[y]; i < work.rowStart[y + 1]; i++) {
+            const MaskRun& run = work.runs[i];
+            const int root = findRoot(parent, i);
+            if (root == i) {
+                work.label[i] = static_cast<int>(tallies.size());
+                tallies.push_back(BlobWork::Tally{0, run.x0, y, run.x1 - 1, y, 0, 0});
+                if (options.contours) {
+                    if (work.outlines.size() < tallies.size()) work.outlines.resize(tallies.size());
+                    work.outlines[tallies.size() - 1].clear();
+                }
+            } else {
+                work.label[i] = work.label[root]; // Roots come first, so it is already numbered
+            }
+            BlobWork::Tally& tally = tallies[work.label[i]];
+            const int length = run.x1 - run.x0;
+            tally.area += length;
+            tally.left = std::min(tally.left, run.x0);
+            tally.right = std::max(tally.right, run.x1 - 1);
+            tally.bottom = y;
+            tally.sumX += (run.x0 + run.x1 - 1) * 0.5 * length;
+            tally.sumY += static_cast<double>(y) * length;
+            if (options.contours) {
+                std::vector<cv::Vec3i>& outline = work.outlines[work.label[i]];
+                if (outline.empty() || outline.back()[0] != y) outline.push_back(cv::Vec3i(y, run.x0, run.x1 - 1));
+                else outline.back()[2] = run.x1 - 1; // Runs of a row come left to right
+            }
+        }
+    }
+
+    blobs.resize(tallies.size());
+    size_t kept = 0;
+    std::vector<cv::Point>& points = work.outline;
+    for (size_t k = 0; k < tallies.size(); k++) {
+        const BlobWork::Tally& tally = tallies[k];
+        if (tally.area < options.minArea) continue;
+        Blob& blob = blobs[kept++];
+        blob.area = tally.area;
+        blob.box = cv::Rect(tally.left, tally.top, tally.right - tally.left + 1, tally.bottom - tally.top + 1);
+        blob.centroid = cv::Point2f(static_cast<float>(tally.sumX / tally.area), static_cast<float>(tally.sumY / tally.area));
+        blob.contour.clear();
+        if (options.contours) {
+            const std::vector<cv::Vec3i>& outline = work.outlines[k];
+            points.clear();
+            for (size_t r = 0; r < outline.size(); r++) points.push_back(cv::Point(outline[r][1], outline[r][0]));
+            for (size_t r = outline.size(); r-- > 0;) points.push_back(cv::Point(outline[r][2], outline[r][0]));
+            cv::approxPolyDP(points, blob.contour, 1.0, true);
+        }
+    }
+    blobs.resize(kept);
+}
+
+bool extractBlobs(const cv::Mat& mask, std::vector<Blob>& blobs, const BlobOptions& options, BlobWork& work) {
+    if (!packMask(mask, work.mask)) return false;
+    extractBlobs(work.mask, blobs, options, work);
+    return true;
+}
+
+void drawBlobs(cv::Mat& image, const std::vector<Blob>& blobs) {
+    for (const Blob& blob : blobs) {
+        cv::rectangle(image, blob.box, cv::Scalar(0, 255, 0), 1);
+        if (!blob.contour.empty()) cv::polylines(image, blob.contour, true, cv::Scalar(0, 255, 255), 1);
+        cv::circle(image, cv::Point(cvRound(blob.centroid.x), cvRound(blob.centroid.y)), 2, cv::Scalar(0, 0, 255), -1);
+    }
+}
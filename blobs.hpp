@@ -0,0 +1,65 @@
+#ifndef BLOBS_HPP
+#define BLOBS_HPP
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "packed_mask.hpp"
+
+struct BlobOptions {
+    int connectivity = 8;   // 8: pixels touching at a corner belong together; 4: only at an edge
+    int minArea = 1;        // Smaller blobs are left out
+    bool contours = false;  // Also trace a simplified outline of every blob
+};
+
+// One connected group of set pixels
+struct Blob {
+    int area = 0;                       // Pixels
+    cv::Rect box;                       // Bounding box
+    cv::Point2f centroid;               // Mean pixel position
+    std::vector<cv::Point> contour;     // Outline, if BlobOptions::contours
+};
+
+// Horizontal run of set pixels [x0, x1) of one row
+struct MaskRun {
+    int x0;
+    int x1;
+};
+
+// Buffers of one extraction, reused between frames
+struct BlobWork {
+    struct Tally {
+        int area, left, top, right, bottom;
+        double sumX, sumY;
+    };
+    PackedMask mask;                          // The input of extractBlobs(cv::Mat, ...)
+    std::vector<MaskRun> runs;                // Every run, row by row
+    std::vector<int> rowStart;                // Index of the first run of each row, rows + 1 entries
+    std::vector<int> parent;                  // Union-find forest over runs
+    std::vector<int> label;                   // Tally of each run
+    std::vector<std::vector<MaskRun> > stripRuns;     // Runs of each strip before they are joined
+    std::vector<std::vector<int> > stripRowStart;
+    std::vector<std::vector<int> > stripParent;
+    std::vector<Tally> tallies;               // Per blob: area, extent and coordinate sums
+    std::vector<std::vector<cv::Vec3i> > outlines;    // Per blob: row, leftmost and rightmost pixel
+    std::vector<cv::Point> outline;           // One outline before simplification
+};
+
+// Connected components of a mask, without a label image.
+// Each row is run-length encoded straight from the packed bits, and runs that touch a run
+// of the row above are joined with union-find, so the work depends on the number of runs,
+// not of pixels. The mask is cut into horizontal strips that are encoded and labeled in
+// parallel (cv::parallel_for_); the runs on either side of each cut are joined afterwards.
+// Blobs come out in raster order of their first pixel, with the same areas, boxes and
+// centroids as cv::connectedComponentsWithStats. The contour, when requested, goes through
+// the leftmost pixel of every row down and the rightmost one back up, simplified to within
+// one pixel: the outer boundary for blobs with one run per row, a row-wise hull otherwise.
+void extractBlobs(const PackedMask& mask, std::vector<Blob>& blobs, const BlobOptions& options, BlobWork& work);
+
+// Same for a CV_8UC1 image, where every non-zero pixel is set. Returns false for other types.
+bool extractBlobs(const cv::Mat& mask, std::vector<Blob>& blobs, const BlobOptions& options, BlobWork& work);
+
+// Draw the boxes (green), centroids (red) and contours (yellow) of 'blobs' onto 'image'
+void drawBlobs(cv::Mat& image, const std::vector<Blob>& blobs);
+
+#endif // BLOBS_HPP
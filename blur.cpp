@@ -0,0 +1,77 @@
+#include "blur.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+// Sigma cv::GaussianBlur derives from the kernel size when none is given
+static double gaussianSigma(int kernelSize) {
+    return 0.3 * ((kernelSize - 1) * 0.5 - 1) + 0.8;
+}
+
+void boxBlurWidths(int kernelSize, int (&widths)[boxBlurPasses]) {
+    const double sigma = gaussianSigma(kernelSize);
+    const int n = boxBlurPasses;
+    double ideal = std::sqrt(12 * sigma * sigma / n + 1);
+    int lower = static_cast<int>(std::floor(ideal));
+    if (lower % 2 == 0) lower--;
+    lower = std::max(lower, 1);
+    const int upper = lower + 2;
+    // Passes that use the smaller width so the total variance is closest to sigma^2
+    int smaller = static_cast<int>(std::lround((12 * sigma * sigma - n * lower * lower - 4 * n * lower - 3 * n) / (-4.0 * lower - 4)));
+    smaller = std::min(std::max(smaller, 0), n);
+    for (int i = 0; i < n; i++) widths[i] = i < smaller ? lower : upper;
+}
+
+double boxBlurErrorBound(int kernelSize) {
+    if (kernelSize < boxBlurMinKernelSize) return 0; // Exact Gaussian is used
+
+    // 1D kernel of the stacked boxes
+    int widths[boxBlurPasses];
+    boxBlurWidths(kernelSize, widths);
+    std::vector<double> box(1, 1.0);
+    for (int pass = 0; pass < boxBlurPasses; pass++) {
+        std::vector<double> next(box.size() + widths[pass] - 1, 0.0);
+        for (size_t i = 0; i < box.size(); i++) {
+            for (int j = 0; j < widths[pass]; j++) next[i + j] += box[i] / widths[pass];
+        }
+        box.swap(next);
+    }
+
+    // Same length and center as the Gaussian kernel
+    cv::Mat gaussianKernel = cv::getGaussianKernel(kernelSize, 0, CV_64F);
+    const int length = std::max(static_cast<int>(box.size()), kernelSize);
+    std::vector<double> a(length, 0.0), g(length, 0.0);
+    for (size_t i = 0; i < box.size(); i++) a[(length - box.size()) / 2 + i] = box[i];
+    for (int i = 0; i < kernelSize; i++) g[(length - kernelSize) / 2 + i] = gaussianKernel.at<double>(i);
+
+    double distance = 0;
+    for (int y = 0; y < length; y++) {
+        for (int x = 0; x < length; x++) distance += std::fabs(a[y] * a[x] - g[y] * g[x]);
+    }
+    return 255 * distance;
+}
+
+void computeBoxBlur(const cv::Mat& frame, cv::Mat& output, int kernelSize, cv::Mat (&work)[2]) {
+    if (kernelSize < boxBlurMinKernelSize) {
+        cv::GaussianBlur(frame, output, cv::Size(kernelSize, kernelSize), 0);
+        return;
+    }
+
+    int widths[boxBlurPasses];
+    boxBlurWidths(kernelSize, widths);
+
+    // 8-bit pixels become 8.8 fixed point; box sums of up to 255 * 256 * width^2 fit in int
+    const bool fixedPoint = frame.depth() == CV_8U;
+    const double scale = fixedPoint ? 256.0 : 1.0;
+    frame.convertTo(work[0], fixedPoint ? CV_16U : CV_32F, scale);
+
+    int current = 0;
+    for (int pass = 0; pass < boxBlurPasses; pass++) {
+        if (widths[pass] == 1) continue;
+        // cv::blur keeps running row and column sums, so its cost is independent of the width
+        cv::blur(work[current], work[1 - current], cv::Size(widths[pass], widths[pass]), cv::Point(-1, -1), cv::BORDER_REFLECT_101);
+        current = 1 - current;
+    }
+    work[current].convertTo(output, frame.type(), 1.0 / scale);
+}
@@ -0,0 +1,29 @@
+#ifndef BLUR_HPP
+#define BLUR_HPP
+
+#include <opencv2/opencv.hpp>
+
+// Number of box filters stacked to approximate one Gaussian
+const int boxBlurPasses = 3;
+
+// Kernel sizes below this use the exact Gaussian: three boxes approximate sigma < 2 poorly
+// (error bound above 50 levels at size 9), and small Gaussians are cheap anyway
+const int boxBlurMinKernelSize = 11;
+
+// Box widths (odd) whose stacked variance best matches the sigma cv::GaussianBlur derives
+// from 'kernelSize' when sigma is 0 (Kovesi, "Fast Almost-Gaussian Filtering")
+void boxBlurWidths(int kernelSize, int (&widths)[boxBlurPasses]);
+
+// Worst-case difference, in 8-bit levels, between the stacked-box and the exact Gaussian
+// result for any 8-bit image: 255 times the L1 distance between the two 2D kernels.
+// Between 14 and 28 levels for sizes 11-101; natural images stay far below it because
+// the bound needs an image that follows the sign pattern of the kernel difference.
+double boxBlurErrorBound(int kernelSize);
+
+// Approximate cv::GaussianBlur(frame, output, Size(kernelSize, kernelSize), 0) with
+// running-sum box filters. Cost per pixel does not depend on the kernel size.
+// 8-bit input is filtered with 8 extra fractional bits so rounding does not accumulate
+// across passes. 'work' holds the two intermediate buffers and is reused between calls.
+void computeBoxBlur(const cv::Mat& frame, cv::Mat& output, int kernelSize, cv::Mat (&work)[2]);
+
+#endif // BLUR_HPP
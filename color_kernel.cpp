@@ -0,0 +1,432 @@
+#include "color_kernel.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COLOR_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+
+// ---------------------------------------------------------------------------
+// Fixed-point HSV, identical to OpenCV's RGB2HSV_b
+// ---------------------------------------------------------------------------
+
+static const int hsvShift = 12;
+
+struct HsvTables {
+    int sdiv[256];         // round((255 << 12) / v)
+    int hdiv[256];         // round((180 << 12) / (6 * diff))
+    uchar expand[256][24]; // 8 mask bits -> 24 byte BGR mask
+
+    HsvTables() {
+        sdiv[0] = hdiv[0] = 0;
+        for (int i = 1; i < 256; i++) {
+            sdiv[i] = static_cast<int>(std::lround((255 << hsvShift) / (1. * i)));
+            hdiv[i] = static_cast<int>(std::lround((180 << hsvShift) / (6. * i)));
+        }
+        for (int bits = 0; bits < 256; bits++) {
+            for (int p = 0; p < 8; p++) {
+                uchar value = (bits >> p) & 1 ? 0xFF : 0;
+                expand[bits][3 * p] = expand[bits][3 * p + 1] = expand[bits][3 * p + 2] = value;
+            }
+        }
+    }
+};
+
+static const HsvTables& tables() {
+    static const HsvTables instance;
+    return instance;
+}
+
+void hsvFromBgr(int b, int g, int r, int& h, int& s, int& v) {
+    const HsvTables& t = tables();
+    v = std::max(b, std::max(g, r));
+    int vmin = std::min(b, std::min(g, r));
+    int diff = v - vmin;
+    int vr = v == r ? -1 : 0;
+    int vg = v == g ? -1 : 0;
+
+    s = (diff * t.sdiv[v] + (1 << (hsvShift - 1))) >> hsvShift;
+    h = (vr & (g - b)) + (~vr & ((vg & (b - r + 2 * diff)) + ((~vg) & (r - g + 4 * diff))));
+    h = (h * t.hdiv[diff] + (1 << (hsvShift - 1))) >> hsvShift;
+    h += h < 0 ? 180 : 0;
+}
+
+// cv::cvtColor's 8-bit BGR -> gray weights (15 fractional bits, rounded)
+static const int grayBlue = 3735, grayGreen = 19235, grayRed = 9798;
+static const int grayShift = 15;
+
+// Weighted sum a pixel must reach for its gray value to exceed 'threshold':
+// gray > t  <=>  (sum + half) >> shift >= t + 1, so no gray value is ever formed
+static int grayThresholdLimit(int threshold) {
+    const int t = std::min(std::max(threshold, -1), 255);
+    return (t + 1) * (1 << grayShift) - (1 << (grayShift - 1));
+}
+
+bool makeColorRange(const std::string& choice, const int (&lowerBound)[3], const int (&upperBound)[3], ColorRange& range) {
+    std::string format = choice;
+    std::transform(format.begin(), format.end(), format.begin(), ::toupper);
+    if (format == "HSV") range.hsv = true;
+    else if (format == "BGR" || format == "RBG") range.hsv = false;
+    else return false;
+
+    for (int k = 0; k < 3; k++) {
+        int lower = lowerBound[k], upper = upperBound[k];
+        if (lower > upper || lower > 255 || upper < 0) { // What cv::inRange does for 8-bit images
+            lower = 1;
+            upper = 0;
+        }
+        range.lower[k] = static_cast<uchar>(std::min(std::max(lower, 0), 255));
+        range.upper[k] = static_cast<uchar>(std::min(std::max(upper, 0), 255));
+    }
+    return true;
+}
+
+bool inColorRange(int b, int g, int r, const ColorRange& range) {
+    int c0 = b, c1 = g, c2 = r;
+    if (range.hsv) hsvFromBgr(b, g, r, c0, c1, c2);
+    return c0 >= range.lower[0] && c0 <= range.upper[0] &&
+           c1 >= range.lower[1] && c1 <= range.upper[1] &&
+           c2 >= range.lower[2] && c2 <= range.upper[2];
+}
+
+
+// ---------------------------------------------------------------------------
+// Row kernels. Each processes a prefix of the row in blocks of 8 (or 16) pixels
+// and returns how many pixels it handled; the scalar tail finishes the rest.
+// ---------------------------------------------------------------------------
+
+typedef int (*ColorRowKernel)(const uchar* bgr, int width, const ColorRange& range, uchar* maskedBgr, uchar* maskBits);
+typedef int (*GrayThresholdKernel)(const uchar* bgr, int width, int limit, uchar* maskBits);
+
+// Write the masked output of one pixel
+static inline void storePixel(const uchar* src, uchar* dst, bool inside) {
+    if (inside) {
+        dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2];
+    } else {
+        dst[0] = dst[1] = dst[2] = 0;
+    }
+}
+
+static void colorRangeTail(const uchar* bgr, int start, int width, const ColorRange& range, uchar* maskedBgr, uchar* maskBits) {
+    for (int x = start; x < width; x++) {
+        const uchar* p = bgr + 3 * x;
+        bool inside = inColorRange(p[0], p[1], p[2], range);
+        if (maskedBgr) storePixel(p, maskedBgr + 3 * x, inside);
+        if (maskBits) {
+            uchar bit = static_cast<uchar>(1u << (x & 7));
+            if (inside) maskBits[x >> 3] |= bit;
+            else maskBits[x >> 3] &= static_cast<uchar>(~bit);
+        }
+    }
+}
+
+static int colorRangeRowScalar(const uchar*, int, const ColorRange&, uchar*, uchar*) {
+    return 0; // Everything is left to the tail
+}
+
+static void grayThresholdTail(const uchar* bgr, int start, int width, int limit, uchar* maskBits) {
+    for (int x = start; x < width; x++) {
+        const uchar* p = bgr + 3 * x;
+        uchar bit = static_cast<uchar>(1u << (x & 7));
+        if (p[0] * grayBlue + p[1] * grayGreen + p[2] * grayRed >= limit) maskBits[x >> 3] |= bit;
+        else maskBits[x >> 3] &= static_cast<uchar>(~bit);
+    }
+}
+
+static int grayThresholdRowScalar(const uchar*, int, int, uchar*) {
+    return 0;
+}
+
+#ifdef COLOR_KERNEL_X86
+
+// Split 8 interleaved BGR pixels (24 bytes) into 8 bytes of each channel
+__attribute__((target("sse4.1")))
+static inline void deinterleave8(__m128i lo, __m128i hi, __m128i& b, __m128i& g, __m128i& r) {
+    const __m128i bLo = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i bHi = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i gLo = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i gHi = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i rLo = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i rHi = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+    b = _mm_or_si128(_mm_shuffle_epi8(lo, bLo), _mm_shuffle_epi8(hi, bHi));
+    g = _mm_or_si128(_mm_shuffle_epi8(lo, gLo), _mm_shuffle_epi8(hi, gHi));
+    r = _mm_or_si128(_mm_shuffle_epi8(lo, rLo), _mm_shuffle_epi8(hi, rHi));
+}
+
+// Store 8 pixels of output from their mask bits
+__attribute__((target("sse4.1")))
+static inline void storeBlock8(__m128i lo, __m128i hi, int bits, uchar* maskedBgr, uchar* maskBits) {
+    if (maskedBgr) {
+        const uchar* expand = tables().expand[bits];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(maskedBgr),
+                         _mm_and_si128(lo, _mm_loadu_si128(reinterpret_cast<const __m128i*>(expand))));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(maskedBgr + 16),
+                         _mm_and_si128(hi, _mm_loadl_epi64(reinterpret_cast<const __m128i*>(expand + 16))));
+    }
+    if (maskBits) *maskBits = static_cast<uchar>(bits);
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i lookup4(const int* table, __m128i index) {
+    return _mm_setr_epi32(table[_mm_extract_epi32(index, 0)], table[_mm_extract_epi32(index, 1)],
+                          table[_mm_extract_epi32(index, 2)], table[_mm_extract_epi32(index, 3)]);
+}
+
+// Range test of 4 pixels held as 32-bit lanes; returns 4 mask bits
+__attribute__((target("sse4.1")))
+static inline int testLanes4(__m128i b, __m128i g, __m128i r, const ColorRange& range) {
+    __m128i c0 = b, c1 = g, c2 = r;
+    if (range.hsv) {
+        const HsvTables& t = tables();
+        __m128i v = _mm_max_epi32(b, _mm_max_epi32(g, r));
+        __m128i diff = _mm_sub_epi32(v, _mm_min_epi32(b, _mm_min_epi32(g, r)));
+        __m128i vr = _mm_cmpeq_epi32(v, r), vg = _mm_cmpeq_epi32(v, g);
+        __m128i diff2 = _mm_add_epi32(diff, diff);
+        __m128i hG = _mm_add_epi32(_mm_sub_epi32(b, r), diff2);                   // v == g
+        __m128i hB = _mm_add_epi32(_mm_sub_epi32(r, g), _mm_add_epi32(diff2, diff2)); // v == b
+        __m128i h = _mm_blendv_epi8(_mm_blendv_epi8(hB, hG, vg), _mm_sub_epi32(g, b), vr);
+        const __m128i half = _mm_set1_epi32(1 << (hsvShift - 1));
+        __m128i s = _mm_srai_epi32(_mm_add_epi32(_mm_mullo_epi32(diff, lookup4(t.sdiv, v)), half), hsvShift);
+        h = _mm_srai_epi32(_mm_add_epi32(_mm_mullo_epi32(h, lookup4(t.hdiv, diff)), half), hsvShift);
+        h = _mm_add_epi32(h, _mm_and_si128(_mm_cmplt_epi32(h, _mm_setzero_si128()), _mm_set1_epi32(180)));
+        c0 = h; c1 = s; c2 = v;
+    }
+    __m128i outside = _mm_or_si128(
+        _mm_or_si128(_mm_or_si128(_mm_cmplt_epi32(c0, _mm_set1_epi32(range.lower[0])), _mm_cmpgt_epi32(c0, _mm_set1_epi32(range.upper[0]))),
+                     _mm_or_si128(_mm_cmplt_epi32(c1, _mm_set1_epi32(range.lower[1])), _mm_cmpgt_epi32(c1, _mm_set1_epi32(range.upper[1])))),
+        _mm_or_si128(_mm_cmplt_epi32(c2, _mm_set1_epi32(range.lower[2])), _mm_cmpgt_epi32(c2, _mm_set1_epi32(range.upper[2]))));
+    return ~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xF;
+}
+
+__attribute__((target("sse4.1")))
+static int colorRangeRowSse41(const uchar* bgr, int width, const ColorRange& range, uchar* maskedBgr, uchar* maskBits) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bgr + 3 * x));
+        __m128i hi = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(bgr + 3 * x + 16));
+        __m128i b8, g8, r8;
+        deinterleave8(lo, hi, b8, g8, r8);
+        int bits = testLanes4(_mm_cvtepu8_epi32(b8), _mm_cvtepu8_epi32(g8), _mm_cvtepu8_epi32(r8), range);
+        bits |= testLanes4(_mm_cvtepu8_epi32(_mm_srli_si128(b8, 4)), _mm_cvtepu8_epi32(_mm_srli_si128(g8, 4)),
+                           _mm_cvtepu8_epi32(_mm_srli_si128(r8, 4)), range) << 4;
+        storeBlock8(lo, hi, bits, maskedBgr ? maskedBgr + 3 * x : 0, maskBits ? maskBits + (x >> 3) : 0);
+    }
+    return x;
+}
+
+__attribute__((target("avx2")))
+static int colorRangeRowAvx2(const uchar* bgr, int width, const ColorRange& range, uchar* maskedBgr, uchar* maskBits) {
+    const HsvTables& t = tables();
+    const __m256i half = _mm256_set1_epi32(1 << (hsvShift - 1));
+    const __m256i lower0 = _mm256_set1_epi32(range.lower[0]), upper0 = _mm256_set1_epi32(range.upper[0]);
+    const __m256i lower1 = _mm256_set1_epi32(range.lower[1]), upper1 = _mm256_set1_epi32(range.upper[1]);
+    const __m256i lower2 = _mm256_set1_epi32(range.lower[2]), upper2 = _mm256_set1_epi32(range.upper[2]);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bgr + 3 * x));
+        __m128i hi = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(bgr + 3 * x + 16));
+        __m128i b8, g8, r8;
+        deinterleave8(lo, hi, b8, g8, r8);
+        __m256i b = _mm256_cvtepu8_epi32(b8), g = _mm256_cvtepu8_epi32(g8), r = _mm256_cvtepu8_epi32(r8);
+        __m256i c0 = b, c1 = g, c2 = r;
+        if (range.hsv) {
+            __m256i v = _mm256_max_epi32(b, _mm256_max_epi32(g, r));
+            __m256i diff = _mm256_sub_epi32(v, _mm256_min_epi32(b, _mm256_min_epi32(g, r)));
+            __m256i vr = _mm256_cmpeq_epi32(v, r), vg = _mm256_cmpeq_epi32(v, g);
+            __m256i diff2 = _mm256_add_epi32(diff, diff);
+            __m256i hG = _mm256_add_epi32(_mm256_sub_epi32(b, r), diff2);
+            __m256i hB = _mm256_add_epi32(_mm256_sub_epi32(r, g), _mm256_add_epi32(diff2, diff2));
+            __m256i h = _mm256_blendv_epi8(_mm256_blendv_epi8(hB, hG, vg), _mm256_sub_epi32(g, b), vr);
+            __m256i s = _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(diff, _mm256_i32gather_epi32(t.sdiv, v, 4)), half), hsvShift);
+            h = _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(h, _mm256_i32gather_epi32(t.hdiv, diff, 4)), half), hsvShift);
+            h = _mm256_add_epi32(h, _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), h), _mm256_set1_epi32(180)));
+            c0 = h; c1 = s; c2 = v;
+        }
+        __m256i outside = _mm256_or_si256(
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpgt_epi32(lower0, c0), _mm256_cmpgt_epi32(c0, upper0)),
+                            _mm256_or_si256(_mm256_cmpgt_epi32(lower1, c1), _mm256_cmpgt_epi32(c1, upper1))),
+            _mm256_or_si256(_mm256_cmpgt_epi32(lower2, c2), _mm256_cmpgt_epi32(c2, upper2)));
+        int bits = ~_mm256_movemask_ps(_mm256_castsi256_ps(outside)) & 0xFF;
+        storeBlock8(lo, hi, bits, maskedBgr ? maskedBgr + 3 * x : 0, maskBits ? maskBits + (x >> 3) : 0);
+    }
+    return x;
+}
+
+__attribute__((target("avx512f")))
+static int colorRangeRowAvx512(const uchar* bgr, int width, const ColorRange& range, uchar* maskedBgr, uchar* maskBits) {
+    const HsvTables& t = tables();
+    const __m512i half = _mm512_set1_epi32(1 << (hsvShift - 1));
+    const __m512i lower0 = _mm512_set1_epi32(range.lower[0]), upper0 = _mm512_set1_epi32(range.upper[0]);
+    const __m512i lower1 = _mm512_set1_epi32(range.lower[1]), upper1 = _mm512_set1_epi32(range.upper[1]);
+    const __m512i lower2 = _mm512_set1_epi32(range.lower[2]), upper2 = _mm512_set1_epi32(range.upper[2]);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const uchar* p = bgr + 3 * x;
+        __m128i lo0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i hi0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + 16));
+        __m128i lo1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 24));
+        __m128i hi1 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + 40));
+        __m128i b0, g0, r0, b1, g1, r1;
+        deinterleave8(lo0, hi0, b0, g0, r0);
+        deinterleave8(lo1, hi1, b1, g1, r1);
+        __m512i b = _mm512_cvtepu8_epi32(_mm_unpacklo_epi64(b0, b1));
+        __m512i g = _mm512_cvtepu8_epi32(_mm_unpacklo_epi64(g0, g1));
+        __m512i r = _mm512_cvtepu8_epi32(_mm_unpacklo_epi64(r0, r1));
+        __m512i c0 = b, c1 = g, c2 = r;
+        if (range.hsv) {
+            __m512i v = _mm512_max_epi32(b, _mm512_max_epi32(g, r));
+            __m512i diff = _mm512_sub_epi32(v, _mm512_min_epi32(b, _mm512_min_epi32(g, r)));
+            __mmask16 vr = _mm512_cmpeq_epi32_mask(v, r), vg = _mm512_cmpeq_epi32_mask(v, g);
+            __m512i diff2 = _mm512_add_epi32(diff, diff);
+            __m512i hG = _mm512_add_epi32(_mm512_sub_epi32(b, r), diff2);
+            __m512i hB = _mm512_add_epi32(_mm512_sub_epi32(r, g), _mm512_add_epi32(diff2, diff2));
+            __m512i h = _mm512_mask_blend_epi32(vr, _mm512_mask_blend_epi32(vg, hB, hG), _mm512_sub_epi32(g, b));
+            __m512i s = _mm512_srai_epi32(_mm512_add_epi32(_mm512_mullo_epi32(diff, _mm512_i32gather_epi32(v, t.sdiv, 4)), half), hsvShift);
+            h = _mm512_srai_epi32(_mm512_add_epi32(_mm512_mullo_epi32(h, _mm512_i32gather_epi32(diff, t.hdiv, 4)), half), hsvShift);
+            h = _mm512_mask_add_epi32(h, _mm512_cmplt_epi32_mask(h, _mm512_setzero_si512()), h, _mm512_set1_epi32(180));
+            c0 = h; c1 = s; c2 = v;
+        }
+        __mmask16 inside = _mm512_cmpge_epi32_mask(c0, lower0) & _mm512_cmple_epi32_mask(c0, upper0) &
+                           _mm512_cmpge_epi32_mask(c1, lower1) & _mm512_cmple_epi32_mask(c1, upper1) &
+                           _mm512_cmpge_epi32_mask(c2, lower2) & _mm512_cmple_epi32_mask(c2, upper2);
+        storeBlock8(lo0, hi0, inside & 0xFF, maskedBgr ? maskedBgr + 3 * x : 0, maskBits ? maskBits + (x >> 3) : 0);
+        storeBlock8(lo1, hi1, inside >> 8, maskedBgr ? maskedBgr + 3 * x + 24 : 0, maskBits ? maskBits + (x >> 3) + 1 : 0);
+    }
+    return x;
+}
+
+// Gray threshold test of 4 pixels held as 32-bit lanes; 'below' is the limit minus one
+__attribute__((target("sse4.1")))
+static inline int grayAbove4(__m128i b, __m128i g, __m128i r, __m128i below) {
+    __m128i sum = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi32(b, _mm_set1_epi32(grayBlue)), _mm_mullo_epi32(g, _mm_set1_epi32(grayGreen))),
+                                _mm_mullo_epi32(r, _mm_set1_epi32(grayRed)));
+    return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(sum, below)));
+}
+
+__attribute__((target("sse4.1")))
+static int grayThresholdRowSse41(const uchar* bgr, int width, int limit, uchar* maskBits) {
+    const __m128i below = _mm_set1_epi32(limit - 1);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bgr + 3 * x));
+        __m128i hi = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(bgr + 3 * x + 16));
+        __m128i b8, g8, r8;
+        deinterleave8(lo, hi, b8, g8, r8);
+        int bits = grayAbove4(_mm_cvtepu8_epi32(b8), _mm_cvtepu8_epi32(g8), _mm_cvtepu8_epi32(r8), below);
+        bits |= grayAbove4(_mm_cvtepu8_epi32(_mm_srli_si128(b8, 4)), _mm_cvtepu8_epi32(_mm_srli_si128(g8, 4)),
+                           _mm_cvtepu8_epi32(_mm_srli_si128(r8, 4)), below) << 4;
+        maskBits[x >> 3] = static_cast<uchar>(bits);
+    }
+    return x;
+}
+
+__attribute__((target("avx2")))
+static int grayThresholdRowAvx2(const uchar* bgr, int width, int limit, uchar* maskBits) {
+    const __m256i below = _mm256_set1_epi32(limit - 1);
+    const __m256i wb = _mm256_set1_epi32(grayBlue), wg = _mm256_set1_epi32(grayGreen), wr = _mm256_set1_epi32(grayRed);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bgr + 3 * x));
+        __m128i hi = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(bgr + 3 * x + 16));
+        __m128i b8, g8, r8;
+        deinterleave8(lo, hi, b8, g8, r8);
+        __m256i sum = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvtepu8_epi32(b8), wb),
+                                                        _mm256_mullo_epi32(_mm256_cvtepu8_epi32(g8), wg)),
+                                       _mm256_mullo_epi32(_mm256_cvtepu8_epi32(r8), wr));
+        maskBits[x >> 3] = static_cast<uchar>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(sum, below))));
+    }
+    return x;
+}
+
+__attribute__((target("avx512f")))
+static int grayThresholdRowAvx512(const uchar* bgr, int width, int limit, uchar* maskBits) {
+    const __m512i below = _mm512_set1_epi32(limit - 1);
+    const __m512i wb = _mm512_set1_epi32(grayBlue), wg = _mm512_set1_epi32(grayGreen), wr = _mm512_set1_epi32(grayRed);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const uchar* p = bgr + 3 * x;
+        __m128i b0, g0, r0, b1, g1, r1;
+        deinterleave8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + 16)), b0, g0, r0);
+        deinterleave8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 24)), _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + 40)), b1, g1, r1);
+        __m512i sum = _mm512_add_epi32(_mm512_add_epi32(_mm512_mullo_epi32(_mm512_cvtepu8_epi32(_mm_unpacklo_epi64(b0, b1)), wb),
+                                                        _mm512_mullo_epi32(_mm512_cvtepu8_epi32(_mm_unpacklo_epi64(g0, g1)), wg)),
+                                       _mm512_mullo_epi32(_mm512_cvtepu8_epi32(_mm_unpacklo_epi64(r0, r1)), wr));
+        __mmask16 above = _mm512_cmpgt_epi32_mask(sum, below);
+        maskBits[x >> 3] = static_cast<uchar>(above & 0xFF);
+        maskBits[(x >> 3) + 1] = static_cast<uchar>(above >> 8);
+    }
+    return x;
+}
+
+#endif // COLOR_KERNEL_X86
+
+
+struct KernelChoice {
+    const char* name;
+    ColorRowKernel kernel;
+    GrayThresholdKernel threshold;
+};
+
+// Best implementation the CPU supports
+static KernelChoice detectKernel() {
+#ifdef COLOR_KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return KernelChoice{"avx512", colorRangeRowAvx512, grayThresholdRowAvx512};
+    if (__builtin_cpu_supports("avx2")) return KernelChoice{"avx2", colorRangeRowAvx2, grayThresholdRowAvx2};
+    if (__builtin_cpu_supports("sse4.1")) return KernelChoice{"sse4.1", colorRangeRowSse41, grayThresholdRowSse41};
+#endif
+    return KernelChoice{"scalar", colorRangeRowScalar, grayThresholdRowScalar};
+}
+
+static KernelChoice& activeKernel() {
+    static KernelChoice choice = detectKernel();
+    return choice;
+}
+
+const char* colorKernelInstructionSet() {
+    return activeKernel().name;
+}
+
+bool setColorKernelInstructionSet(const std::string& name) {
+    KernelChoice choice = {"scalar", colorRangeRowScalar, grayThresholdRowScalar};
+#ifdef COLOR_KERNEL_X86
+    __builtin_cpu_init();
+    if (name == "avx512" && __builtin_cpu_supports("avx512f")) choice = KernelChoice{"avx512", colorRangeRowAvx512, grayThresholdRowAvx512};
+    else if (name == "avx2" && __builtin_cpu_supports("avx2")) choice = KernelChoice{"avx2", colorRangeRowAvx2, grayThresholdRowAvx2};
+    else if (name == "sse4.1" && __builtin_cpu_supports("sse4.1")) choice = KernelChoice{"sse4.1", colorRangeRowSse41, grayThresholdRowSse41};
+    else if (name != "scalar") return false;
+#else
+    if (name != "scalar") return false;
+#endif
+    activeKernel() = choice;
+    return true;
+}
+
+void colorRangeRow(const uchar* bgr, int width, const ColorRange& range, uchar* maskedBgr, uchar* maskBits) {
+    int done = activeKernel().kernel(bgr, width, range, maskedBgr, maskBits);
+    colorRangeTail(bgr, done, width, range, maskedBgr, maskBits);
+}
+
+void grayThresholdRow(const uchar* bgr, int width, int threshold, uchar* maskBits) {
+    const int limit = grayThresholdLimit(threshold);
+    int done = activeKernel().threshold(bgr, width, limit, maskBits);
+    grayThresholdTail(bgr, done, width, limit, maskBits);
+}
+
+bool computeColorMaskFast(const cv::Mat& frame, cv::Mat& output, const std::string& choice,
+                          const int (&lowerBound)[3], const int (&upperBound)[3]) {
+    ColorRange range;
+    if (frame.type() != CV_8UC3 || !makeColorRange(choice, lowerBound, upperBound, range)) return false;
+
+    output.create(frame.size(), frame.type());
+    cv::parallel_for_(cv::Range(0, frame.rows), [&](const cv::Range& rows) {
+        for (int y = rows.start; y < rows.end; y++) {
+            colorRangeRow(frame.ptr<uchar>(y), frame.cols, range, output.ptr<uchar>(y), 0);
+        }
+    });
+    return true;
+}
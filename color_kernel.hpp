@@ -0,0 +1,49 @@
+#ifndef COLOR_KERNEL_HPP
+#define COLOR_KERNEL_HPP
+
+#include <cstdint>
+#include <string>
+#include <opencv2/opencv.hpp>
+
+// Bounds of a per-pixel color range test, normalized the way cv::inRange normalizes
+// scalar bounds for 8-bit images: an empty or out-of-range channel interval matches nothing,
+// everything else is saturated to [0, 255].
+struct ColorRange {
+    bool hsv = false;               // Test OpenCV 8-bit HSV (H in 0..180) instead of raw BGR
+    uchar lower[3] = {1, 1, 1};
+    uchar upper[3] = {0, 0, 0};
+};
+
+// Build the range for a color format choice ("HSV", "BGR" or "RBG"); returns false for other formats
+bool makeColorRange(const std::string& choice, const int (&lowerBound)[3], const int (&upperBound)[3], ColorRange& range);
+
+// Bit-exact scalar equivalent of cv::cvtColor(..., cv::COLOR_BGR2HSV) for one 8-bit pixel
+void hsvFromBgr(int b, int g, int r, int& h, int& s, int& v);
+
+// True if the BGR pixel passes the range test
+bool inColorRange(int b, int g, int r, const ColorRange& range);
+
+// Test one row of 'width' BGR pixels in a single pass. Either output may be null:
+//   maskedBgr - the input pixel where it matches, black elsewhere (may alias 'bgr')
+//   maskBits  - one bit per pixel, least significant bit first, ceil(width / 8) bytes;
+//               unused bits of the last byte are left as they were
+void colorRangeRow(const uchar* bgr, int width, const ColorRange& range, uchar* maskedBgr, uchar* maskBits);
+
+// Fused BGR -> gray -> binary threshold for one row: bit set where the gray value
+// cv::cvtColor would produce is above 'threshold'. Same maskBits layout as colorRangeRow.
+void grayThresholdRow(const uchar* bgr, int width, int threshold, uchar* maskBits);
+
+// Single-pass replacement for computeColorMask on 8-bit BGR frames: reads each pixel once
+// and writes the masked output directly, with no HSV image, mask image or extra passes.
+// Bit-exact with cvtColor + inRange + copyTo. Returns false for an unknown color format
+// or a frame that is not 8-bit BGR, so callers can fall back to computeColorMask.
+bool computeColorMaskFast(const cv::Mat& frame, cv::Mat& output, const std::string& choice,
+                          const int (&lowerBound)[3], const int (&upperBound)[3]);
+
+// Instruction set picked at startup: "avx512", "avx2", "sse4.1" or "scalar"
+const char* colorKernelInstructionSet();
+
+// Force a specific implementation (for benchmarks); returns false if the CPU lacks it
+bool setColorKernelInstructionSet(const std::string& name);
+
+#endif // COLOR_KERNEL_HPP
@@ -0,0 +1,253 @@
+#include "color_lut.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+static const int lutRows = 256 * 256;                 // One row per (b, g) pair
+static const int lutRowBytes = 256 / 8;               // One bit per r value
+static const size_t lutBytes = size_t(lutRows) * lutRowBytes; // 2 MB
+
+static std::atomic<size_t> liveTableBytes(0);
+static std::atomic<size_t> peakTableBytes(0);
+
+static void countTableBytes(long long delta) {
+    size_t live = liveTableBytes.fetch_add(static_cast<size_t>(delta)) + static_cast<size_t>(delta);
+    size_t peak = peakTableBytes.load();
+    while (live > peak && !peakTableBytes.compare_exchange_weak(peak, live)) {
+    }
+}
+
+struct LutTable {
+    ColorRange range;
+    std::vector<uchar> bits;
+
+    LutTable() : bits(lutBytes, 0) { countTableBytes(static_cast<long long>(lutBytes)); }
+    LutTable(const LutTable& other) : range(other.range), bits(other.bits) { countTableBytes(static_cast<long long>(lutBytes)); }
+    ~LutTable() { countTableBytes(-static_cast<long long>(lutBytes)); }
+};
+
+static bool sameRange(const ColorRange& a, const ColorRange& b) {
+    return a.hsv == b.hsv && std::equal(a.lower, a.lower + 3, b.lower) && std::equal(a.upper, a.upper + 3, b.upper);
+}
+
+// Values whose membership differs between [oldLower, oldUpper] and [newLower, newUpper],
+// as up to two half-open intervals appended to 'changed'
+static void changedValues(int oldLower, int oldUpper, int newLower, int newUpper, std::vector<std::pair<int, int> >& changed) {
+    if (oldLower > oldUpper || newLower > newUpper) { // An empty interval: everything inside the other one changed
+        changed.push_back(std::make_pair(0, 256));
+        return;
+    }
+    if (oldLower != newLower) changed.push_back(std::make_pair(std::min(oldLower, newLower), std::max(oldLower, newLower)));
+    if (oldUpper != newUpper) changed.push_back(std::make_pair(std::min(oldUpper, newUpper) + 1, std::max(oldUpper, newUpper) + 1));
+}
+
+// Mark the (b, g) rows of 'dirty' that may change when 'previous' becomes 'target'
+static void markDirtyRows(const ColorRange& previous, const ColorRange& target, std::vector<uchar>& dirty) {
+    bool full = previous.hsv != target.hsv;
+    for (int k = 0; k < 3 && !full; k++) {
+        std::vector<std::pair<int, int> > changed;
+        changedValues(previous.lower[k], previous.upper[k], target.lower[k], target.upper[k], changed);
+        for (size_t i = 0; i < changed.size() && !full; i++) {
+            int begin = changed[i].first, end = changed[i].second;
+            if (target.hsv) {
+                // A V change only touches colors whose max(b, g, r) lies in the interval, all in rows
+                // with b, g < end. Hue and saturation are spread over the whole cube.
+                if (k != 2) full = true;
+                for (int b = 0; b < end && !full; b++) std::fill(dirty.begin() + (b << 8), dirty.begin() + (b << 8) + end, 1);
+            } else if (k == 0) {   // Blue slab: whole rows for b in the interval
+                std::fill(dirty.begin() + (begin << 8), dirty.begin() + (end << 8), 1);
+            } else if (k == 1) {   // Green slab: one row per b
+                for (int b = 0; b < 256; b++) std::fill(dirty.begin() + (b << 8) + begin, dirty.begin() + (b << 8) + end, 1);
+            } else {               // Red lies inside every row
+                full = true;
+            }
+        }
+    }
+    if (full) std::fill(dirty.begin(), dirty.end(), 1);
+}
+
+// Recompute the marked rows of 'table' for its range with the row kernel; returns the row count
+static int rebuildRows(LutTable& table, const std::vector<uchar>& dirty) {
+    std::atomic<int> rows(0);
+    cv::parallel_for_(cv::Range(0, 256), [&](const cv::Range& blues) {
+        uchar pixels[256 * 3];
+        int count = 0;
+        for (int b = blues.start; b < blues.end; b++) {
+            for (int r = 0; r < 256; r++) {
+                pixels[3 * r] = static_cast<uchar>(b);
+                pixels[3 * r + 2] = static_cast<uchar>(r);
+            }
+            for (int g = 0; g < 256; g++) {
+                int row = (b << 8) | g;
+                if (!dirty[row]) continue;
+                for (int r = 0; r < 256; r++) pixels[3 * r + 1] = static_cast<uchar>(g);
+                colorRangeRow(pixels, 256, table.range, 0, &table.bits[size_t(row) * lutRowBytes]);
+                count++;
+            }
+        }
+        rows += count;
+    });
+    return rows.load();
+}
+
+
+// Owns the published table and the thread that rebuilds it
+class LutBuilder {
+public:
+    LutBuilder() : hasRequest(false), stopping(false) {}
+
+    ~LutBuilder() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+
+    // Ask for a table for 'range'; cheap when nothing changed
+    void request(const ColorRange& range) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (hasRequest && sameRange(requested, range)) return;
+            requested = range;
+            hasRequest = true;
+            if (!worker.joinable()) worker = std::thread(&LutBuilder::run, this);
+        }
+        wake.notify_all();
+    }
+
+    std::shared_ptr<const LutTable> table() const { return std::atomic_load(&current); }
+
+    void waitFor(const ColorRange& range) {
+        request(range);
+        std::unique_lock<std::mutex> lock(mutex);
+        built.wait(lock, [&]() {
+            std::shared_ptr<const LutTable> published = table();
+            return stopping || (published && sameRange(published->range, range));
+        });
+    }
+
+    ColorLutStats stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        ColorLutStats result = counters;
+        result.tableBytes = liveTableBytes.load();
+        result.peakTableBytes = peakTableBytes.load();
+        return result;
+    }
+
+private:
+    bool pending() const {
+        std::shared_ptr<const LutTable> published = table();
+        return hasRequest && (!published || !sameRange(published->range, requested));
+    }
+
+    void run() {
+        typedef std::chrono::steady_clock Clock;
+        std::vector<uchar> dirty(lutRows);
+        for (;;) {
+            ColorRange target;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return stopping || pending(); });
+                if (stopping) return;
+                target = requested; // Only the latest bounds matter; intermediate trackbar positions are skipped
+            }
+
+            Clock::time_point start = Clock::now();
+            std::shared_ptr<const LutTable> previous = table();
+            std::shared_ptr<LutTable> next;
+            std::fill(dirty.begin(), dirty.end(), 0);
+            if (previous) {
+                next = std::make_shared<LutTable>(*previous); // Patch a copy; frames keep reading 'previous'
+                markDirtyRows(previous->range, target, dirty);
+            } else {
+                next = std::make_shared<LutTable>();
+                std::fill(dirty.begin(), dirty.end(), 1);
+            }
+            next->range = target;
+            int rows = rebuildRows(*next, dirty);
+            std::atomic_store(&current, std::shared_ptr<const LutTable>(next));
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                counters.rebuilds++;
+                if (rows == lutRows) counters.fullRebuilds++;
+                counters.lastRebuildMs = ms;
+                counters.lastRebuildRows = rows;
+            }
+            built.notify_all();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake;      // New request or shutdown
+    std::condition_variable built;     // A table was published
+    bool hasRequest;
+    bool stopping;
+    ColorRange requested;
+    ColorLutStats counters;
+    std::shared_ptr<const LutTable> current; // Accessed with atomic_load/atomic_store only
+    std::thread worker;
+};
+
+static LutBuilder& builder() {
+    static LutBuilder instance;
+    return instance;
+}
+
+
+bool computeColorMaskLut(const cv::Mat& frame, cv::Mat& output, const std::string& choice,
+                         const int (&lowerBound)[3], const int (&upperBound)[3]) {
+    ColorRange range;
+    if (frame.type() != CV_8UC3 || !makeColorRange(choice, lowerBound, upperBound, range)) return false;
+
+    builder().request(range);
+    std::shared_ptr<const LutTable> table = builder().table(); // Held for the whole frame
+    if (!table) return false;
+
+    const uchar* bits = table->bits.data();
+    output.create(frame.size(), frame.type());
+    cv::parallel_for_(cv::Range(0, frame.rows), [&](const cv::Range& rows) {
+        for (int y = rows.start; y < rows.end; y++) {
+            const uchar* src = frame.ptr<uchar>(y);
+            uchar* dst = output.ptr<uchar>(y);
+            for (int x = 0; x < frame.cols; x++, src += 3, dst += 3) {
+                uint32_t index = uint32_t(src[0]) << 16 | uint32_t(src[1]) << 8 | src[2];
+                uchar keep = static_cast<uchar>(0u - ((bits[index >> 3] >> (index & 7)) & 1u));
+                dst[0] = src[0] & keep;
+                dst[1] = src[1] & keep;
+                dst[2] = src[2] & keep;
+            }
+        }
+    });
+    return true;
+}
+
+void waitForColorLut(const std::string& choice, const int (&lowerBound)[3], const int (&upperBound)[3]) {
+    ColorRange range;
+    if (makeColorRange(choice, lowerBound, upperBound, range)) builder().waitFor(range);
+}
+
+ColorLutStats getColorLutStats() {
+    return builder().stats();
+}
+
+void printColorLutStats(const std::string& label) {
+    ColorLutStats stats = getColorLutStats();
+    char line[256];
+    std::snprintf(line, sizeof(line), "%s lut_mb=%.1f lut_peak_mb=%.1f rebuilds=%llu full_rebuilds=%llu last_rebuild_ms=%.2f last_rebuild_rows=%d",
+                  label.c_str(), stats.tableBytes / 1048576.0, stats.peakTableBytes / 1048576.0,
+                  static_cast<unsigned long long>(stats.rebuilds), static_cast<unsigned long long>(stats.fullRebuilds),
+                  stats.lastRebuildMs, stats.lastRebuildRows);
+    std::cout << line << std::endl;
+}
@@ -0,0 +1,39 @@
+#ifndef COLOR_LUT_HPP
+#define COLOR_LUT_HPP
+
+#include <cstdint>
+#include <string>
+#include <opencv2/opencv.hpp>
+#include "color_kernel.hpp"
+
+// Counters of the shared color membership table
+struct ColorLutStats {
+    size_t tableBytes = 0;          // Memory held by tables right now (published + being rebuilt)
+    size_t peakTableBytes = 0;
+    uint64_t rebuilds = 0;          // Completed rebuilds
+    uint64_t fullRebuilds = 0;      // ... of which rebuilt every row
+    double lastRebuildMs = 0;
+    int lastRebuildRows = 0;        // Rows of 256 colors recomputed by the last rebuild (65536 = all)
+};
+
+// Color detection through a 2 MB membership bitset over every 24-bit BGR color:
+// bit (b << 16 | g << 8 | r) is set when that color passes the range test, so each pixel
+// costs one lookup and no HSV conversion.
+//
+// Building is asynchronous. When the bounds change, a background thread copies the current
+// table, recomputes only the rows whose membership can change (the slab of the moved channel
+// for BGR, the V shell for HSV; H and S changes rebuild everything) and publishes the result.
+// Meanwhile frames keep using the previous table. Returns false until the first table exists
+// or for input that is not 8-bit BGR, so callers can fall back to computeColorMaskFast.
+bool computeColorMaskLut(const cv::Mat& frame, cv::Mat& output, const std::string& choice,
+                         const int (&lowerBound)[3], const int (&upperBound)[3]);
+
+// Block until the table for this range is published (benchmarks and tests)
+void waitForColorLut(const std::string& choice, const int (&lowerBound)[3], const int (&upperBound)[3]);
+
+ColorLutStats getColorLutStats();
+
+// Print one line with table memory and rebuild timings
+void printColorLutStats(const std::string& label);
+
+#endif // COLOR_LUT_HPP
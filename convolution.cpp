@@ -0,0 +1,453 @@
+#include "convolution.hpp"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CONVOLUTION_X86 1
+#include <immintrin.h>
+#endif
+
+
+static const int maxFixedPointSize = 11;  // From 13x13 up filter2D itself switches to a DFT
+static const int maxFixedPointShift = 12;
+static const int maxUnrolledShift = 24;
+static const double maxUnrolledError = 0.5; // Levels: 255 * sum |tap - rounded tap|, keeps Unrolled within 1 of filter2D
+static const int minFftSize = 25;         // Rows or columns from which the FFT wins over direct taps
+static const double rankOneRatio = 1e-6;  // Second singular value relative to the first
+
+// Find the smallest n such that every tap is an integer multiple of 1 / 2^n that fits 16 bits,
+// and the accumulation of 8-bit pixels stays exact in both int and filter2D's float arithmetic
+static bool fitsFixedPoint(const cv::Mat& kernel, std::vector<short>& taps, int& shift) {
+    for (int n = 0; n <= maxFixedPointShift; n++) {
+        const double scale = std::ldexp(1.0, n);
+        double magnitude = 0, largest = 0;
+        bool integral = true;
+        for (int y = 0; y < kernel.rows && integral; y++) {
+            const float* row = kernel.ptr<float>(y);
+            for (int x = 0; x < kernel.cols; x++) {
+                double scaled = row[x] * scale;
+                if (scaled != std::floor(scaled)) {
+                    integral = false;
+                    break;
+                }
+                magnitude += std::fabs(scaled);
+                largest = std::max(largest, std::fabs(scaled));
+            }
+        }
+        if (!integral) continue;
+        if (largest > SHRT_MAX || 255 * magnitude >= (1 << 24)) return false; // Float sums would round
+        taps.resize(kernel.total());
+        for (int y = 0; y < kernel.rows; y++) {
+            for (int x = 0; x < kernel.cols; x++) {
+                taps[y * kernel.cols + x] = static_cast<short>(kernel.at<float>(y, x) * scale);
+            }
+        }
+        shift = n;
+        return true;
+    }
+    return false;
+}
+
+// Round the taps to 16-bit multiples of 1 / 2^n with the largest n that fits; false if the
+// rounding could move a result by a level or more
+static bool roundToFixedPoint(const cv::Mat& kernel, std::vector<short>& taps, int& shift) {
+    double largest = 0;
+    for (int y = 0; y < kernel.rows; y++) {
+        for (int x = 0; x < kernel.cols; x++) largest = std::max(largest, std::fabs(static_cast<double>(kernel.at<float>(y, x))));
+    }
+    int n = 0;
+    while (n < maxUnrolledShift && std::ldexp(largest, n + 1) <= SHRT_MAX) n++;
+
+    double error = 0;
+    taps.resize(kernel.total());
+    for (int y = 0; y < kernel.rows; y++) {
+        for (int x = 0; x < kernel.cols; x++) {
+            const double exact = std::ldexp(static_cast<double>(kernel.at<float>(y, x)), n);
+            const double rounded = std::floor(exact + 0.5);
+            taps[y * kernel.cols + x] = static_cast<short>(rounded);
+            error += std::fabs(rounded - exact);
+        }
+    }
+    shift = n;
+    return 255 * std::ldexp(error, -n) <= maxUnrolledError;
+}
+
+// Split a rank-1 kernel into column * row^T
+static bool isRankOne(const cv::Mat& kernel, cv::Mat& rowKernel, cv::Mat& columnKernel) {
+    cv::Mat kernel64;
+    kernel.convertTo(kernel64, CV_64F);
+    cv::SVD svd(kernel64);
+    const double first = svd.w.at<double>(0);
+    if (first == 0) return false;
+    if (svd.w.rows > 1 && svd.w.at<double>(1) > first * rankOneRatio) return false;
+
+    const double scale = std::sqrt(first);
+    cv::Mat row = svd.vt.row(0).t() * scale;
+    cv::Mat column = svd.u.col(0) * scale;
+    row.convertTo(rowKernel, CV_32F);
+    column.convertTo(columnKernel, CV_32F);
+    return true;
+}
+
+
+// ---------------------------------------------------------------------------
+// Fixed-point rows: sum of 16-bit taps times 8-bit pixels in 32-bit integers, then a
+// division by 2^shift rounding half to even, as filter2D's float-to-uchar conversion does
+// ---------------------------------------------------------------------------
+
+static const int maxTaps = maxFixedPointSize * maxFixedPointSize + 1; // Padded to an even count
+static const int maxPairs = maxTaps / 2;
+static const int maxUnrolledPairs = 13;   // Enough for every 3x3 and 5x5 kernel
+
+// The nonzero taps of a kernel, taken in pairs so that one multiply-add covers two source vectors
+struct FixedKernel {
+    int count;                // Even; a zero tap pads an odd count
+    int row[maxTaps];         // Kernel row of each tap
+    int column[maxTaps];      // Pixel offset of each tap from the anchor column
+    short weight[maxTaps];
+    int shift;
+    int channels;
+    bool narrow;              // Weights fit 8 bits and sums 16 bits
+};
+
+// Nonzero taps of a row-major kernel of integer weights / 2^shift
+static void prepareFixedKernel(const std::vector<short>& taps, int rows, int cols, int shift, int channels, FixedKernel& fixed) {
+    int magnitude = 0, largest = 0;
+    fixed.count = 0;
+    for (int i = 0; i < rows * cols; i++) {
+        if (taps[i] == 0) continue;
+        fixed.row[fixed.count] = i / cols;
+        fixed.column[fixed.count] = i % cols - cols / 2;
+        fixed.weight[fixed.count++] = taps[i];
+        magnitude += std::abs(taps[i]);
+        largest = std::max(largest, std::abs(static_cast<int>(taps[i])));
+    }
+    if (fixed.count % 2) {
+        fixed.row[fixed.count] = fixed.row[fixed.count - 1];
+        fixed.column[fixed.count] = fixed.column[fixed.count - 1];
+        fixed.weight[fixed.count++] = 0;
+    }
+    fixed.shift = shift;
+    fixed.channels = channels;
+    // Any sum plus the rounding bias stays within int16, which also rules out maddubs saturation
+    fixed.narrow = largest <= SCHAR_MAX && 255 * magnitude + (1 << shift >> 1) <= SHRT_MAX;
+}
+
+// Converts the interior of one output row, bytes [begin, end), where every tap stays inside the
+// source rows; returns the first byte it left for the scalar tail
+typedef int (*FixedRowFn)(const uchar* const* source, uchar* target, int begin, int end, const FixedKernel& fixed);
+
+// (sum + bias + odd bit of the quotient) >> shift is round-half-to-even of sum / 2^shift
+static inline int roundingBias(int shift) {
+    return shift > 0 ? (1 << (shift - 1)) - 1 : 0;
+}
+
+// Any output bytes [begin, end) of a row 'width' pixels wide, borders reflected
+static void fixedRowScalar(const uchar* const* source, uchar* target, int begin, int end, int width, const FixedKernel& fixed) {
+    const int bias = roundingBias(fixed.shift), odd = fixed.shift > 0;
+    for (int i = begin; i < end; i++) {
+        const int x = i / fixed.channels, channel = i % fixed.channels;
+        int sum = 0;
+        for (int t = 0; t < fixed.count; t++) {
+            const int column = cv::borderInterpolate(x + fixed.column[t], width, cv::BORDER_REFLECT_101);
+            sum += fixed.weight[t] * source[fixed.row[t]][column * fixed.channels + channel];
+        }
+        target[i] = cv::saturate_cast<uchar>((sum + bias + ((sum >> fixed.shift) & odd)) >> fixed.shift);
+    }
+}
+
+static int fixedRowNone(const uchar* const*, uchar*, int begin, int, const FixedKernel&) {
+    return begin;
+}
+
+#ifdef CONVOLUTION_X86
+
+// Narrow kernels interleave the bytes of two sources and maddubs them with two 8-bit weights into 16-bit sums;
+// the others widen to 16 bits and madd them with two 16-bit weights into 32-bit sums.
+// Pairs is the number of tap pairs when it is known at compile time, which unrolls the tap loop; 0 reads it from 'fixed'.
+template <int Pairs, bool Narrow>
+__attribute__((target("sse4.1")))
+static int fixedRowSse41(const uchar* const* source, uchar* target, int begin, int end, const FixedKernel& fixed) {
+    const int pairs = Pairs ? Pairs : fixed.count / 2;
+    const uchar* first[maxPairs];
+    const uchar* second[maxPairs];
+    __m128i weights[maxPairs];
+    for (int p = 0; p < pairs; p++) {
+        first[p] = source[fixed.row[2 * p]] + fixed.column[2 * p] * fixed.channels;
+        second[p] = source[fixed.row[2 * p + 1]] + fixed.column[2 * p + 1] * fixed.channels;
+        const unsigned low = static_cast<unsigned short>(fixed.weight[2 * p]), high = static_cast<unsigned short>(fixed.weight[2 * p + 1]);
+        weights[p] = Narrow ? _mm_set1_epi16(static_cast<short>(((high & 0xFF) << 8) | (low & 0xFF)))
+                            : _mm_set1_epi32(static_cast<int>((high << 16) | low));
+    }
+    const __m128i shift = _mm_cvtsi32_si128(fixed.shift);
+    int x = begin;
+
+    if (Narrow) {
+        const __m128i bias = _mm_set1_epi16(static_cast<short>(roundingBias(fixed.shift))), odd = _mm_set1_epi16(fixed.shift > 0);
+        for (; x + 16 <= end; x += 16) {
+            __m128i low = _mm_setzero_si128(), high = low;
+            for (int p = 0; p < pairs; p++) {
+                const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first[p] + x));
+                const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(second[p] + x));
+                low = _mm_add_epi16(low, _mm_maddubs_epi16(_mm_unpacklo_epi8(a, b), weights[p]));
+                high = _mm_add_epi16(high, _mm_maddubs_epi16(_mm_unpackhi_epi8(a, b), weights[p]));
+            }
+            low = _mm_sra_epi16(_mm_add_epi16(_mm_add_epi16(low, bias), _mm_and_si128(_mm_sra_epi16(low, shift), odd)), shift);
+            high = _mm_sra_epi16(_mm_add_epi16(_mm_add_epi16(high, bias), _mm_and_si128(_mm_sra_epi16(high, shift), odd)), shift);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(target + x), _mm_packus_epi16(low, high));
+        }
+        return x;
+    }
+
+    const __m128i bias = _mm_set1_epi32(roundingBias(fixed.shift)), odd = _mm_set1_epi32(fixed.shift > 0);
+    for (; x + 8 <= end; x += 8) {
+        __m128i low = _mm_setzero_si128(), high = low;
+        for (int p = 0; p < pairs; p++) {
+            const __m128i a = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(first[p] + x)));
+            const __m128i b = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(second[p] + x)));
+            low = _mm_add_epi32(low, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), weights[p]));
+            high = _mm_add_epi32(high, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), weights[p]));
+        }
+        low = _mm_sra_epi32(_mm_add_epi32(_mm_add_epi32(low, bias), _mm_and_si128(_mm_sra_epi32(low, shift), odd)), shift);
+        high = _mm_sra_epi32(_mm_add_epi32(_mm_add_epi32(high, bias), _mm_and_si128(_mm_sra_epi32(high, shift), odd)), shift);
+        const __m128i packed = _mm_packs_epi32(low, high);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(target + x), _mm_packus_epi16(packed, packed));
+    }
+    return x;
+}
+
+template <int Pairs, bool Narrow>
+__attribute__((target("avx2")))
+static int fixedRowAvx2(const uchar* const* source, uchar* target, int begin, int end, const FixedKernel& fixed) {
+    const int pairs = Pairs ? Pairs : fixed.count / 2;
+    const uchar* first[maxPairs];
+    const uchar* second[maxPairs];
+    __m256i weights[maxPairs];
+    for (int p = 0; p < pairs; p++) {
+        first[p] = source[fixed.row[2 * p]] + fixed.column[2 * p] * fixed.channels;
+        second[p] = source[fixed.row[2 * p + 1]] + fixed.column[2 * p + 1] * fixed.channels;
+        const unsigned low = static_cast<unsigned short>(fixed.weight[2 * p]), high = static_cast<unsigned short>(fixed.weight[2 * p + 1]);
+        weights[p] = Narrow ? _mm256_set1_epi16(static_cast<short>(((high & 0xFF) << 8) | (low & 0xFF)))
+                            : _mm256_set1_epi32(static_cast<int>((high << 16) | low));
+    }
+    const __m128i shift = _mm_cvtsi32_si128(fixed.shift);
+    int x = begin;
+
+    // Unpacks work per 128-bit lane; packing the two halves back together restores pixel order
+    if (Narrow) {
+        const __m256i bias = _mm256_set1_epi16(static_cast<short>(roundingBias(fixed.shift))), odd = _mm256_set1_epi16(fixed.shift > 0);
+        for (; x + 32 <= end; x += 32) {
+            __m256i low = _mm256_setzero_si256(), high = low;
+            for (int p = 0; p < pairs; p++) {
+                const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first[p] + x));
+                const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(second[p] + x));
+                low = _mm256_add_epi16(low, _mm256_maddubs_epi16(_mm256_unpacklo_epi8(a, b), weights[p]));
+                high = _mm256_add_epi16(high, _mm256_maddubs_epi16(_mm256_unpackhi_epi8(a, b), weights[p]));
+            }
+            low = _mm256_sra_epi16(_mm256_add_epi16(_mm256_add_epi16(low, bias), _mm256_and_si256(_mm256_sra_epi16(low, shift), odd)), shift);
+            high = _mm256_sra_epi16(_mm256_add_epi16(_mm256_add_epi16(high, bias), _mm256_and_si256(_mm256_sra_epi16(high, shift), odd)), shift);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + x), _mm256_packus_epi16(low, high));
+        }
+        return x;
+    }
+
+    const __m256i bias = _mm256_set1_epi32(roundingBias(fixed.shift)), odd = _mm256_set1_epi32(fixed.shift > 0);
+    for (; x + 16 <= end; x += 16) {
+        __m256i low = _mm256_setzero_si256(), high = low;
+        for (int p = 0; p < pairs; p++) {
+            const __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first[p] + x)));
+            const __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(second[p] + x)));
+            low = _mm256_add_epi32(low, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), weights[p]));
+            high = _mm256_add_epi32(high, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), weights[p]));
+        }
+        low = _mm256_sra_epi32(_mm256_add_epi32(_mm256_add_epi32(low, bias), _mm256_and_si256(_mm256_sra_epi32(low, shift), odd)), shift);
+        high = _mm256_sra_epi32(_mm256_add_epi32(_mm256_add_epi32(high, bias), _mm256_and_si256(_mm256_sra_epi32(high, shift), odd)), shift);
+        const __m256i packed = _mm256_packs_epi32(low, high);
+        const __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(packed, packed), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target + x), _mm256_castsi256_si128(bytes));
+    }
+    return x;
+}
+
+// Index p holds the body unrolled for p tap pairs; index 0 the loop over any number
+#define FIXED_ROW_TABLE(row, narrow) { \
+    row<0, narrow>, row<1, narrow>, row<2, narrow>, row<3, narrow>, row<4, narrow>, row<5, narrow>, row<6, narrow>, \
+    row<7, narrow>, row<8, narrow>, row<9, narrow>, row<10, narrow>, row<11, narrow>, row<12, narrow>, row<13, narrow> }
+
+static const FixedRowFn sse41Rows[2][maxUnrolledPairs + 1] = {FIXED_ROW_TABLE(fixedRowSse41, false), FIXED_ROW_TABLE(fixedRowSse41, true)};
+static const FixedRowFn avx2Rows[2][maxUnrolledPairs + 1] = {FIXED_ROW_TABLE(fixedRowAvx2, false), FIXED_ROW_TABLE(fixedRowAvx2, true)};
+
+#undef FIXED_ROW_TABLE
+
+#endif // CONVOLUTION_X86
+
+// The widest row function the CPU supports, unrolled when the kernel has few enough nonzero taps
+static FixedRowFn pickFixedRow(const FixedKernel& fixed) {
+#ifdef CONVOLUTION_X86
+    __builtin_cpu_init();
+    const int pairs = fixed.count / 2 <= maxUnrolledPairs ? fixed.count / 2 : 0;
+    if (__builtin_cpu_supports("avx2")) return avx2Rows[fixed.narrow][pairs];
+    if (__builtin_cpu_supports("sse4.1")) return sse41Rows[fixed.narrow][pairs];
+#else
+    (void)fixed;
+#endif
+    return fixedRowNone;
+}
+
+
+bool ConvolutionEngine::setKernel(const cv::Mat& candidate) {
+    if (candidate.empty() || candidate.channels() != 1 || candidate.rows % 2 == 0 || candidate.cols % 2 == 0) {
+        return false;
+    }
+    candidate.convertTo(kernel, CV_32F);
+    taps.clear();
+    shift = 0;
+    rowKernel.release();
+    columnKernel.release();
+    spectrumSize = cv::Size();
+
+    const bool small = (kernel.rows == 3 || kernel.rows == 5) && kernel.rows == kernel.cols;
+    if (kernel.rows <= maxFixedPointSize && kernel.cols <= maxFixedPointSize && fitsFixedPoint(kernel, taps, shift)) {
+        chosen = FixedPoint;
+    } else if (isRankOne(kernel, rowKernel, columnKernel)) {
+        chosen = Separable;
+    } else if (small && roundToFixedPoint(kernel, taps, shift)) {
+        chosen = Unrolled;
+    } else if (std::max(kernel.rows, kernel.cols) >= minFftSize) {
+        chosen = Fft;
+    } else {
+        chosen = Direct;
+    }
+    return true;
+}
+
+bool ConvolutionEngine::hasKernel(const cv::Mat& candidate) const {
+    if (kernel.empty() || candidate.size() != kernel.size() || candidate.channels() != 1) return false;
+    cv::Mat values = candidate;
+    if (candidate.type() != CV_32F) candidate.convertTo(values, CV_32F);
+    for (int y = 0; y < kernel.rows; y++) {
+        if (!std::equal(kernel.ptr<float>(y), kernel.ptr<float>(y) + kernel.cols, values.ptr<float>(y))) return false;
+    }
+    return true;
+}
+
+bool ConvolutionEngine::apply(const cv::Mat& frame, cv::Mat& output) {
+    if (kernel.empty()) return false;
+    if (frame.depth() != CV_8U) {
+        cv::filter2D(frame, output, -1, kernel);
+        return true;
+    }
+    switch (chosen) {
+        case FixedPoint:
+        case Unrolled: applyFixedPoint(frame, output); break;
+        case Separable:
+            cv::sepFilter2D(frame, output, -1, rowKernel, columnKernel, cv::Point(-1, -1), 0, cv::BORDER_REFLECT_101);
+            break;
+        case Fft: applyFft(frame, output); break;
+        default: cv::filter2D(frame, output, -1, kernel); break;
+    }
+    return true;
+}
+
+// Interior bytes go through the SIMD row function straight from the frame's rows; the reflected
+// border columns and the tail of each row go through the scalar one. No bordered copy is made.
+void ConvolutionEngine::applyFixedPoint(const cv::Mat& frame, cv::Mat& output) {
+    const cv::Mat* input = &frame;
+    if (!output.empty() && output.datastart == frame.datastart) { // In place: read from a copy
+        frame.copyTo(padded);
+        input = &padded;
+    }
+    output.create(frame.size(), frame.type());
+
+    FixedKernel fixed;
+    prepareFixedKernel(taps, kernel.rows, kernel.cols, shift, frame.channels(), fixed);
+    const FixedRowFn interior = pickFixedRow(fixed);
+    const int width = frame.cols, bytes = width * fixed.channels, border = kernel.cols / 2 * fixed.channels;
+    const int begin = std::min(border, bytes), end = std::max(begin, bytes - border);
+    const int kernelRows = kernel.rows;
+    const cv::Mat& source = *input;
+    cv::parallel_for_(cv::Range(0, frame.rows), [&](const cv::Range& range) {
+        const uchar* rows[maxFixedPointSize];
+        for (int y = range.start; y < range.end; y++) {
+            for (int ky = 0; ky < kernelRows; ky++) {
+                rows[ky] = source.ptr<uchar>(cv::borderInterpolate(y + ky - kernelRows / 2, source.rows, cv::BORDER_REFLECT_101));
+            }
+            uchar* target = output.ptr<uchar>(y);
+            const int done = interior(rows, target, begin, end, fixed);
+            fixedRowScalar(rows, target, 0, begin, width, fixed);
+            fixedRowScalar(rows, target, done, bytes, width, fixed);
+        }
+    });
+}
+
+// Correlation through the frequency domain: IDFT(DFT(image) * conj(DFT(kernel))).
+// The bordered frame is large enough that the circular wrap never reaches the output area.
+void ConvolutionEngine::applyFft(const cv::Mat& frame, cv::Mat& output) {
+    const int top = kernel.rows / 2, left = kernel.cols / 2;
+    cv::copyMakeBorder(frame, padded, top, top, left, left, cv::BORDER_REFLECT_101);
+    const cv::Size dftSize(cv::getOptimalDFTSize(padded.cols), cv::getOptimalDFTSize(padded.rows));
+
+    if (spectrumSize != frame.size()) {
+        cv::Mat placed = cv::Mat::zeros(dftSize, CV_32F);
+        cv::Mat corner = placed(cv::Rect(0, 0, kernel.cols, kernel.rows));
+        kernel.copyTo(corner);
+        cv::dft(placed, kernelSpectrum, 0, kernel.rows);
+        spectrumSize = frame.size();
+    }
+
+    cv::split(padded, planes);
+    outputs.resize(planes.size());
+    work.create(dftSize, CV_32F);
+    cv::Mat image = work(cv::Rect(0, 0, padded.cols, padded.rows));
+    for (size_t c = 0; c < planes.size(); c++) {
+        planes[c].convertTo(image, CV_32F);
+        work.colRange(padded.cols, dftSize.width).setTo(cv::Scalar::all(0));
+        work.rowRange(padded.rows, dftSize.height).setTo(cv::Scalar::all(0));
+
+        cv::dft(work, work, 0, padded.rows);
+        cv::mulSpectrums(work, kernelSpectrum, work, 0, true);
+        cv::dft(work, work, cv::DFT_INVERSE | cv::DFT_SCALE | cv::DFT_REAL_OUTPUT, frame.rows);
+        work(cv::Rect(0, 0, frame.cols, frame.rows)).convertTo(outputs[c], frame.depth());
+    }
+    cv::merge(outputs, output);
+}
+
+int ConvolutionEngine::tolerance() const {
+    // Direct is filter2D itself and FixedPoint is exact; Unrolled rounds its taps by less than half a level
+    // in total, and the others differ in float rounding order, so each is at most one level off
+    return chosen == Direct || chosen == FixedPoint ? 0 : 1;
+}
+
+const char* ConvolutionEngine::strategyName(Strategy strategy) {
+    switch (strategy) {
+        case FixedPoint: return "fixed-point";
+        case Separable: return "separable";
+        case Unrolled: return "unrolled";
+        case Fft: return "fft";
+        default: return "direct";
+    }
+}
+
+std::string ConvolutionEngine::describe() const {
+    std::ostringstream text;
+    text << kernel.rows << "x" << kernel.cols << " kernel -> " << strategyName(chosen);
+    switch (chosen) {
+        case FixedPoint:
+        case Unrolled: {
+            FixedKernel fixed;
+            prepareFixedKernel(taps, kernel.rows, kernel.cols, shift, 1, fixed);
+            text << " (" << cv::countNonZero(kernel) << " nonzero taps / 2^" << shift << ", " << (fixed.narrow ? 8 : 16) << "-bit";
+            if (fixed.count / 2 <= maxUnrolledPairs) text << ", unrolled";
+            text << ")";
+            break;
+        }
+        case Separable: text << " (" << kernel.cols << "-tap row pass + " << kernel.rows << "-tap column pass)"; break;
+        case Fft: text << " (kernel spectrum cached per frame size)"; break;
+        default: break;
+    }
+    text << ", within " << tolerance() << " level" << (tolerance() == 1 ? "" : "s") << " of filter2D";
+    return text.str();
+}
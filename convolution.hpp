@@ -0,0 +1,62 @@
+#ifndef CONVOLUTION_HPP
+#define CONVOLUTION_HPP
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Convolution (cv::filter2D semantics: correlation, centered anchor, reflect-101 border)
+// that inspects the kernel once when it is set and picks the cheapest strategy:
+//   FixedPoint  kernels up to 11x11 whose taps are exact multiples of 1 / 2^n: 16-bit integer
+//               taps, SIMD integer accumulation, exact; 3x3 and 5x5 bodies are unrolled at compile time
+//   Separable   rank-1 kernels: a row pass and a column pass (sepFilter2D)
+//   Unrolled    other 3x3 and 5x5 kernels: taps rounded to 16-bit fixed point, same unrolled bodies
+//   Fft         kernels of 25 or more rows/columns: frequency domain with the kernel
+//               spectrum cached per frame size
+//   Direct      anything else: cv::filter2D
+// Every strategy stays within tolerance() levels of cv::filter2D on 8-bit images.
+class ConvolutionEngine {
+public:
+    enum Strategy { Direct, FixedPoint, Separable, Unrolled, Fft };
+
+    // Analyze a kernel (any numeric type, odd rows and columns) and choose the strategy; prints nothing.
+    // Returns false and keeps the previous kernel if it is empty or even-sized.
+    bool setKernel(const cv::Mat& kernel);
+
+    // True if 'kernel' has the same size and values as the current one
+    bool hasKernel(const cv::Mat& kernel) const;
+
+    // Convolve; returns false if no kernel is set. Input that is not 8-bit goes through filter2D.
+    bool apply(const cv::Mat& frame, cv::Mat& output);
+
+    Strategy strategy() const { return chosen; }
+    int tolerance() const;            // Largest difference from cv::filter2D, in levels
+    std::string describe() const;     // e.g. "5x5 kernel -> separable (5-tap row pass + 5-tap column pass), within 1 level of filter2D"
+
+    static const char* strategyName(Strategy strategy);
+
+private:
+    void applyFixedPoint(const cv::Mat& frame, cv::Mat& output);
+    void applyFft(const cv::Mat& frame, cv::Mat& output);
+
+    cv::Mat kernel;                   // CV_32F copy of the kernel as set
+    Strategy chosen = Direct;
+
+    // FixedPoint and Unrolled: kernel ~= taps / 2^shift, row-major
+    std::vector<short> taps;
+    int shift = 0;
+
+    // Separable: kernel = columnKernel * rowKernel^T
+    cv::Mat rowKernel, columnKernel;
+
+    // Fft: cached for the last frame size
+    cv::Size spectrumSize;            // Frame size the spectrum was built for
+    cv::Mat kernelSpectrum;
+    std::vector<cv::Mat> planes;      // Per-channel bordered input
+    std::vector<cv::Mat> outputs;     // Per-channel results
+    cv::Mat work;                     // Frequency-domain buffer
+
+    cv::Mat padded;                   // Fft input with its border, or a copy of in-place FixedPoint input; reused between frames
+};
+
+#endif // CONVOLUTION_HPP
@@ -0,0 +1,141 @@
+#ifndef FRAME_RING_HPP
+#define FRAME_RING_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// What a producer does when the ring is full
+enum class RingPolicy {
+    DropOldest, // Discard the oldest queued item to make room (live sources)
+    Block       // Wait until the consumer frees a slot (offline sources)
+};
+
+// Lock-free bounded multi-producer/multi-consumer ring (Vyukov's sequence-per-slot queue).
+// Capacity is rounded up to a power of two. Blocking calls spin, yield, then back off
+// with short sleeps; nothing ever takes a mutex.
+template <typename T>
+class BoundedRing {
+public:
+    BoundedRing(size_t capacity, RingPolicy policy)
+        : slots(roundUpPowerOfTwo(capacity)), mask(slots.size() - 1), ringPolicy(policy),
+          enqueuePos(0), dequeuePos(0), pushCount(0), dropCount(0), closed(false) {
+        for (size_t i = 0; i < slots.size(); ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Enqueue without waiting; returns false if the ring is full
+    bool tryPush(T& item) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots[pos & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(item);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    pushCount.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // Full
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Dequeue without waiting; returns false if the ring is empty
+    bool tryPop(T& item) {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots[pos & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    item = std::move(slot.value);
+                    slot.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // Empty
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Enqueue according to the policy; returns false only if the ring was closed
+    bool push(T item) {
+        for (int attempt = 0; !closed.load(std::memory_order_acquire); ++attempt) {
+            if (tryPush(item)) return true;
+            if (ringPolicy == RingPolicy::DropOldest) {
+                T oldest;
+                if (tryPop(oldest)) dropCount.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                backoff(attempt);
+            }
+        }
+        return false;
+    }
+
+    // Dequeue, waiting for an item; returns false once the ring is closed and drained
+    bool pop(T& item) {
+        for (int attempt = 0;; ++attempt) {
+            if (tryPop(item)) return true;
+            if (closed.load(std::memory_order_acquire)) return tryPop(item);
+            backoff(attempt);
+        }
+    }
+
+    // Wake every waiter; pushes fail from now on, pops drain what is left
+    void close() { closed.store(true, std::memory_order_release); }
+    bool isClosed() const { return closed.load(std::memory_order_acquire); }
+
+    size_t capacity() const { return slots.size(); }
+    RingPolicy policy() const { return ringPolicy; }
+
+    // Approximate number of queued items
+    size_t depth() const {
+        size_t in = enqueuePos.load(std::memory_order_relaxed);
+        size_t out = dequeuePos.load(std::memory_order_relaxed);
+        return in > out ? in - out : 0;
+    }
+    uint64_t pushed() const { return pushCount.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropCount.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static size_t roundUpPowerOfTwo(size_t n) {
+        size_t size = 1;
+        while (size < n) size <<= 1;
+        return size < 2 ? 2 : size;
+    }
+
+    static void backoff(int attempt) {
+        if (attempt < 64) return;                      // Spin
+        if (attempt < 128) std::this_thread::yield();  // Give up the time slice
+        else std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    std::vector<Slot> slots;
+    const size_t mask;
+    const RingPolicy ringPolicy;
+    alignas(64) std::atomic<size_t> enqueuePos;
+    alignas(64) std::atomic<size_t> dequeuePos;
+    std::atomic<uint64_t> pushCount;
+    std::atomic<uint64_t> dropCount;
+    std::atomic<bool> closed;
+};
+
+#endif // FRAME_RING_HPP
@@ -0,0 +1,183 @@
+#include "frame_source.hpp"
+#include "raw_video.hpp"
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+
+
+// Open a camera by index
+CaptureSource::CaptureSource(int cameraIndex)
+    : cap(cameraIndex), name("camera:" + std::to_string(cameraIndex)), seekable(false) {}
+
+// Open a video file or stream URL
+CaptureSource::CaptureSource(const std::string& path)
+    : cap(path), name("video:" + path), seekable(path.find("://") == std::string::npos) {}
+
+bool CaptureSource::read(cv::Mat& frame) {
+    return cap.read(frame) && !frame.empty();
+}
+
+// Seek back to the first frame; only files can be replayed
+bool CaptureSource::rewind() {
+    if (!seekable) return false;
+    return cap.set(cv::CAP_PROP_POS_FRAMES, 0);
+}
+
+double CaptureSource::fps() const {
+    return cap.get(cv::CAP_PROP_FPS);
+}
+
+
+// Decode every matching image once so that reads are just header copies
+ImageSequenceSource::ImageSequenceSource(const std::string& pattern, double fps)
+    : next(0), frameRate(fps), name("images:" + pattern) {
+    std::vector<std::string> files;
+    cv::glob(pattern, files);
+    std::sort(files.begin(), files.end());
+    for (size_t i = 0; i < files.size(); ++i) {
+        cv::Mat image = cv::imread(files[i], cv::IMREAD_COLOR);
+        if (image.empty()) {
+            std::cerr << "Warning: skipping unreadable image " << files[i] << std::endl;
+            continue;
+        }
+        frames.push_back(image);
+    }
+}
+
+bool ImageSequenceSource::read(cv::Mat& frame) {
+    if (next >= frames.size()) return false;
+    frame = frames[next++];
+    return true;
+}
+
+bool ImageSequenceSource::rewind() {
+    next = 0;
+    return !frames.empty();
+}
+
+
+static const size_t syntheticCacheBytes = size_t(64) << 20; // Per source: 10 frames at 1080p, 2 at 4K
+
+SyntheticSource::SyntheticSource(int width, int height, double fps, unsigned seed, int period)
+    : next(0), frameRate(fps) {
+    name = "synthetic:" + std::to_string(width) + "x" + std::to_string(height) + "@" + std::to_string(static_cast<int>(fps));
+    const size_t frameBytes = static_cast<size_t>(width) * height * 3;
+    const size_t fitting = std::max<size_t>(1, syntheticCacheBytes / std::max<size_t>(frameBytes, 1));
+    frames.resize(std::min(static_cast<size_t>(std::max(period, 1)), fitting));
+    for (size_t i = 0; i < frames.size(); ++i) {
+        render(frames[i], width, height, static_cast<int>(i), seed);
+    }
+}
+
+// A copy, so consumers that write into the frame cannot change the loop
+bool SyntheticSource::read(cv::Mat& frame) {
+    if (next >= frames.size()) return false;
+    frames[next++].copyTo(frame);
+    return true;
+}
+
+bool SyntheticSource::rewind() {
+    next = 0;
+    return true;
+}
+
+// Gradient background, a few moving colored shapes and mild noise, all derived from (seed, index)
+void SyntheticSource::render(cv::Mat& frame, int width, int height, int index, unsigned seed) {
+    frame.create(height, width, CV_8UC3);
+    for (int y = 0; y < height; ++y) {
+        uchar* row = frame.ptr<uchar>(y);
+        for (int x = 0; x < width; ++x) {
+            row[3 * x + 0] = static_cast<uchar>(x * 255 / std::max(width - 1, 1));
+            row[3 * x + 1] = static_cast<uchar>(y * 255 / std::max(height - 1, 1));
+            row[3 * x + 2] = static_cast<uchar>((x + y + index * 4) & 255);
+        }
+    }
+
+    // Shape layout depends only on the seed; position depends on the frame index
+    cv::RNG layout(seed);
+    const int shapeCount = 12;
+    for (int i = 0; i < shapeCount; ++i) {
+        int size = layout.uniform(std::max(width, height) / 40 + 1, std::max(width, height) / 8 + 2);
+        int startX = layout.uniform(0, width), startY = layout.uniform(0, height);
+        int speedX = layout.uniform(-8, 9), speedY = layout.uniform(-8, 9);
+        cv::Scalar color(layout.uniform(0, 256), layout.uniform(0, 256), layout.uniform(0, 256));
+        int x = ((startX + speedX * index) % width + width) % width;
+        int y = ((startY + speedY * index) % height + height) % height;
+        if (i % 2 == 0) {
+            cv::circle(frame, cv::Point(x, y), size / 2, color, cv::FILLED);
+        } else {
+            cv::rectangle(frame, cv::Rect(x, y, size, size * 2 / 3 + 1), color, cv::FILLED);
+        }
+    }
+
+    cv::Mat noise(height, width, CV_8UC3);
+    cv::RNG grain(seed * 7919u + static_cast<unsigned>(index));
+    grain.fill(noise, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(8));
+    frame += noise;
+}
+
+
+// Parse "<W>x<H>[@fps]"; returns false on malformed input
+static bool parseResolution(const std::string& text, int& width, int& height, double& fps) {
+    size_t xPos = text.find('x');
+    if (xPos == std::string::npos) return false;
+    size_t atPos = text.find('@');
+    width = std::atoi(text.substr(0, xPos).c_str());
+    height = std::atoi(text.substr(xPos + 1, atPos == std::string::npos ? std::string::npos : atPos - xPos - 1).c_str());
+    if (atPos != std::string::npos) fps = std::atof(text.substr(atPos + 1).c_str());
+    return width > 0 && height > 0 && fps > 0;
+}
+
+std::unique_ptr<FrameSource> createFrameSource(const std::string& spec) {
+    size_t colon = spec.find(':');
+    std::string kind = colon == std::string::npos ? spec : spec.substr(0, colon);
+    std::string arg = colon == std::string::npos ? "" : spec.substr(colon + 1);
+
+    if (kind == "camera") {
+        std::unique_ptr<CaptureSource> source(new CaptureSource(arg.empty() ? 0 : std::atoi(arg.c_str())));
+        if (!source->isOpened()) {
+            std::cerr << "Error: Could not open the camera!" << std::endl;
+            return std::unique_ptr<FrameSource>();
+        }
+        return std::unique_ptr<FrameSource>(std::move(source));
+    }
+    if (kind == "video" || kind == "rtsp" || kind == "http" || kind == "https") {
+        std::unique_ptr<CaptureSource> source(new CaptureSource(kind == "video" ? arg : spec));
+        if (!source->isOpened()) {
+            std::cerr << "Error: Could not open video " << arg << std::endl;
+            return std::unique_ptr<FrameSource>();
+        }
+        return std::unique_ptr<FrameSource>(std::move(source));
+    }
+    if (kind == "images") {
+        double fps = 30;
+        size_t atPos = arg.rfind('@');
+        if (atPos != std::string::npos) {
+            fps = std::atof(arg.substr(atPos + 1).c_str());
+            arg = arg.substr(0, atPos);
+        }
+        std::unique_ptr<ImageSequenceSource> source(new ImageSequenceSource(arg, fps > 0 ? fps : 30));
+        if (!source->isOpened()) {
+            std::cerr << "Error: No readable images match " << arg << std::endl;
+            return std::unique_ptr<FrameSource>();
+        }
+        return std::unique_ptr<FrameSource>(std::move(source));
+    }
+    if (kind == "raw") {
+        std::unique_ptr<RawVideoSource> source(new RawVideoSource(arg));
+        if (!source->isOpened()) return std::unique_ptr<FrameSource>(); // Reason already printed
+        return std::unique_ptr<FrameSource>(std::move(source));
+    }
+    if (kind == "synthetic") {
+        int width = 1280, height = 720;
+        double fps = 30;
+        if (!arg.empty() && !parseResolution(arg, width, height, fps)) {
+            std::cerr << "Error: Invalid synthetic source spec " << spec << " (expected WxH[@fps])" << std::endl;
+            return std::unique_ptr<FrameSource>();
+        }
+        return std::unique_ptr<FrameSource>(new SyntheticSource(width, height, fps));
+    }
+
+    std::cerr << "Error: Unknown frame source " << spec << std::endl;
+    return std::unique_ptr<FrameSource>();
+}
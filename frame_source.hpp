@@ -0,0 +1,95 @@
+#ifndef FRAME_SOURCE_HPP
+#define FRAME_SOURCE_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Anything that can hand out BGR frames one at a time
+class FrameSource {
+public:
+    virtual ~FrameSource() {}
+
+    // Read the next frame; returns false when the source is exhausted or broken
+    virtual bool read(cv::Mat& frame) = 0;
+
+    // Restart from the first frame; returns false if the source cannot be replayed (e.g. a live camera)
+    virtual bool rewind() = 0;
+
+    // Nominal frame rate of the source (0 if unknown)
+    virtual double fps() const = 0;
+
+    // Human readable description used in logs and reports
+    virtual std::string describe() const = 0;
+};
+
+// Camera index, video file or stream URL, read through cv::VideoCapture
+class CaptureSource : public FrameSource {
+public:
+    explicit CaptureSource(int cameraIndex);
+    explicit CaptureSource(const std::string& path);
+
+    bool isOpened() const { return cap.isOpened(); }
+    bool read(cv::Mat& frame);
+    bool rewind();
+    double fps() const;
+    std::string describe() const { return name; }
+
+private:
+    cv::VideoCapture cap;
+    std::string name;
+    bool seekable;
+};
+
+// Still images matched by a cv::glob pattern, decoded once up front so replay is deterministic and I/O free
+class ImageSequenceSource : public FrameSource {
+public:
+    ImageSequenceSource(const std::string& pattern, double fps);
+
+    bool isOpened() const { return !frames.empty(); }
+    bool read(cv::Mat& frame);
+    bool rewind();
+    double fps() const { return frameRate; }
+    std::string describe() const { return name; }
+
+private:
+    std::vector<cv::Mat> frames;
+    size_t next;
+    double frameRate;
+    std::string name;
+};
+
+// Deterministic generated scene (gradient background with moving shapes) at any resolution/fps.
+// The same seed always yields the same frames, so runs on different machines are comparable.
+// The loop is 'period' frames, or fewer at large sizes: the cache is capped at 64 MB per
+// source, so many synthetic streams fit in memory. read() copies into the caller's buffer.
+class SyntheticSource : public FrameSource {
+public:
+    SyntheticSource(int width, int height, double fps, unsigned seed = 1, int period = 60);
+
+    bool read(cv::Mat& frame);
+    bool rewind();
+    double fps() const { return frameRate; }
+    std::string describe() const { return name; }
+
+    // Render frame number 'index' of the scene into 'frame'
+    static void render(cv::Mat& frame, int width, int height, int index, unsigned seed);
+
+private:
+    std::vector<cv::Mat> frames; // Pre-rendered loop so generation cost stays out of measurements
+    size_t next;
+    double frameRate;
+    std::string name;
+};
+
+// Create a source from a spec string:
+//   camera:<index>             live camera (default "camera:0")
+//   video:<path or URL>        video file or stream through cv::VideoCapture
+//   images:<glob>[@fps]        image sequence, e.g. images:frames/*.png@30
+//   raw:<path>                 memory-mapped Y4M or raw BGR/gray file, see raw_video.hpp
+//   synthetic:<W>x<H>[@fps]    generated frames, e.g. synthetic:1920x1080@60
+// Returns an empty pointer (after printing the reason) if the source cannot be opened.
+std::unique_ptr<FrameSource> createFrameSource(const std::string& spec);
+
+#endif // FRAME_SOURCE_HPP
@@ -0,0 +1,196 @@
+#include "geometry.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+
+// Fixed-point layout of cv::warpAffine's coordinate computation
+static const int abBits = 10;
+static const int abScale = 1 << abBits;
+static const int roundDelta = abScale / cv::INTER_TAB_SIZE / 2;
+
+void invertAffine(const double (&forward)[6], double (&inverse)[6]) {
+    std::copy(forward, forward + 6, inverse);
+    double* m = inverse;
+    double d = m[0] * m[4] - m[1] * m[3];
+    d = d != 0 ? 1. / d : 0;
+    double a11 = m[4] * d, a22 = m[0] * d;
+    m[0] = a11; m[1] *= -d;
+    m[3] *= -d; m[4] = a22;
+    double b1 = -m[0] * m[2] - m[1] * m[5];
+    double b2 = -m[3] * m[2] - m[4] * m[5];
+    m[2] = b1; m[5] = b2;
+}
+
+void composeAffine(const double (&earlier)[6], const double (&later)[6], double (&result)[6]) {
+    const double* a = earlier;
+    const double* b = later;
+    double m[6] = {
+        a[0] * b[0] + a[1] * b[3], a[0] * b[1] + a[1] * b[4], a[0] * b[2] + a[1] * b[5] + a[2],
+        a[3] * b[0] + a[4] * b[3], a[3] * b[1] + a[4] * b[4], a[3] * b[2] + a[4] * b[5] + a[5],
+    };
+    std::copy(m, m + 6, result);
+}
+
+void rotationInverse(double angle, cv::Size size, double (&inverse)[6]) {
+    // Same matrix as cv::getRotationMatrix2D around (cols / 2, rows / 2) with scale 1
+    double cx = size.width / 2.0f, cy = size.height / 2.0f;
+    double radians = angle * CV_PI / 180.0;
+    double alpha = std::cos(radians), beta = std::sin(radians);
+    double forward[6] = {
+        alpha, beta, (1 - alpha) * cx - beta * cy,
+        -beta, alpha, beta * cx + (1 - alpha) * cy,
+    };
+    invertAffine(forward, inverse);
+}
+
+void resizeInverse(cv::Size src, cv::Size dst, double (&inverse)[6]) {
+    double sx = double(src.width) / dst.width, sy = double(src.height) / dst.height;
+    double m[6] = {sx, 0, 0.5 * sx - 0.5, 0, sy, 0.5 * sy - 0.5};
+    std::copy(m, m + 6, inverse);
+}
+
+void cropInverse(int x, int y, double (&inverse)[6]) {
+    double m[6] = {1, 0, double(x), 0, 1, double(y)};
+    std::copy(m, m + 6, inverse);
+}
+
+// Fill the remap tables the way warpAffine's invoker does for INTER_LINEAR
+static void buildWarpTables(WarpMaps& maps) {
+    const double* m = maps.inverse;
+    const int width = maps.dstSize.width, height = maps.dstSize.height;
+    maps.xy.create(height, width, CV_16SC2);
+    maps.alpha.create(height, width, CV_16UC1);
+
+    std::vector<int> adelta(width), bdelta(width);
+    for (int x = 0; x < width; x++) {
+        adelta[x] = cv::saturate_cast<int>(m[0] * x * abScale);
+        bdelta[x] = cv::saturate_cast<int>(m[3] * x * abScale);
+    }
+    for (int y = 0; y < height; y++) {
+        short* xy = maps.xy.ptr<short>(y);
+        ushort* alpha = maps.alpha.ptr<ushort>(y);
+        int x0 = cv::saturate_cast<int>((m[1] * y + m[2]) * abScale) + roundDelta;
+        int y0 = cv::saturate_cast<int>((m[4] * y + m[5]) * abScale) + roundDelta;
+        for (int x = 0; x < width; x++) {
+            int X = (x0 + adelta[x]) >> (abBits - cv::INTER_BITS);
+            int Y = (y0 + bdelta[x]) >> (abBits - cv::INTER_BITS);
+            xy[2 * x] = cv::saturate_cast<short>(X >> cv::INTER_BITS);
+            xy[2 * x + 1] = cv::saturate_cast<short>(Y >> cv::INTER_BITS);
+            alpha[x] = static_cast<ushort>((Y & (cv::INTER_TAB_SIZE - 1)) * cv::INTER_TAB_SIZE + (X & (cv::INTER_TAB_SIZE - 1)));
+        }
+    }
+}
+
+// Check whether the tables describe a pure transpose/flip/shift of the source
+static bool detectPermutation(WarpMaps& maps) {
+    const int width = maps.dstSize.width, height = maps.dstSize.height;
+    if (width < 2 || height < 2) return false;
+
+    const short* first = maps.xy.ptr<short>(0);
+    const short* second = maps.xy.ptr<short>(1);
+    int* c = maps.coeff;
+    c[2] = first[0];
+    c[5] = first[1];
+    c[0] = first[2] - c[2];
+    c[3] = first[3] - c[5];
+    c[1] = second[0] - c[2];
+    c[4] = second[1] - c[5];
+    bool straight = c[1] == 0 && c[3] == 0 && std::abs(c[0]) == 1 && std::abs(c[4]) == 1;
+    bool transposed = c[0] == 0 && c[4] == 0 && std::abs(c[1]) == 1 && std::abs(c[3]) == 1;
+    if (!straight && !transposed) return false;
+
+    for (int y = 0; y < height; y++) {
+        const short* xy = maps.xy.ptr<short>(y);
+        const ushort* alpha = maps.alpha.ptr<ushort>(y);
+        for (int x = 0; x < width; x++) {
+            if (alpha[x] != 0 || xy[2 * x] != c[0] * x + c[1] * y + c[2] || xy[2 * x + 1] != c[3] * x + c[4] * y + c[5]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool prepareWarp(WarpMaps& maps, const double (&inverse)[6], cv::Size srcSize, cv::Size dstSize, int border) {
+    if (maps.valid && maps.srcSize == srcSize && maps.dstSize == dstSize && maps.border == border &&
+        std::equal(inverse, inverse + 6, maps.inverse)) {
+        return false;
+    }
+    std::copy(inverse, inverse + 6, maps.inverse);
+    maps.srcSize = srcSize;
+    maps.dstSize = dstSize;
+    maps.border = border;
+    buildWarpTables(maps);
+    maps.permutation = detectPermutation(maps);
+    maps.valid = true;
+    return true;
+}
+
+// Destination positions [begin, end) along one axis whose source coordinate
+// 'coefficient * position + offset' lies inside [0, limit)
+static void validSpan(int coefficient, int offset, int limit, int size, int& begin, int& end) {
+    if (coefficient == 1) {
+        begin = -offset;
+        end = limit - offset;
+    } else {
+        begin = offset - limit + 1;
+        end = offset + 1;
+    }
+    begin = std::min(std::max(begin, 0), size);
+    end = std::max(std::min(end, size), begin);
+}
+
+// Copy path for permutation maps; returns false if it cannot reproduce the border
+static bool applyPermutation(const WarpMaps& maps, const cv::Mat& src, cv::Mat& dst) {
+    const int* c = maps.coeff;
+    const bool transposed = c[0] == 0;
+    int x0, x1, y0, y1;
+    if (transposed) {
+        validSpan(c[3], c[5], src.rows, maps.dstSize.width, x0, x1);
+        validSpan(c[1], c[2], src.cols, maps.dstSize.height, y0, y1);
+    } else {
+        validSpan(c[0], c[2], src.cols, maps.dstSize.width, x0, x1);
+        validSpan(c[4], c[5], src.rows, maps.dstSize.height, y0, y1);
+    }
+    const cv::Rect inside(x0, y0, std::max(x1 - x0, 0), std::max(y1 - y0, 0));
+    const bool full = inside.width == maps.dstSize.width && inside.height == maps.dstSize.height;
+    if (!full && maps.border != cv::BORDER_CONSTANT) return false;
+
+    dst.create(maps.dstSize, src.type());
+    if (!full) {
+        // Black everywhere the source does not reach
+        dst.rowRange(0, y0).setTo(cv::Scalar::all(0));
+        dst.rowRange(std::max(y1, y0), dst.rows).setTo(cv::Scalar::all(0));
+        dst(cv::Rect(0, y0, x0, inside.height)).setTo(cv::Scalar::all(0));
+        dst(cv::Rect(std::max(x1, x0), y0, dst.cols - std::max(x1, x0), inside.height)).setTo(cv::Scalar::all(0));
+        if (inside.area() == 0) return true;
+    }
+
+    // Source rectangle covered by 'inside', from two opposite corners
+    int sxA = c[0] * x0 + c[1] * y0 + c[2], sxB = c[0] * (x1 - 1) + c[1] * (y1 - 1) + c[2];
+    int syA = c[3] * x0 + c[4] * y0 + c[5], syB = c[3] * (x1 - 1) + c[4] * (y1 - 1) + c[5];
+    cv::Rect source(std::min(sxA, sxB), std::min(syA, syB), std::abs(sxB - sxA) + 1, std::abs(syB - syA) + 1);
+    cv::Mat target = dst(inside);
+
+    bool flipColumns, flipRows;
+    if (transposed) {
+        cv::transpose(src(source), target);
+        flipColumns = c[3] < 0;
+        flipRows = c[1] < 0;
+    } else {
+        flipColumns = c[0] < 0;
+        flipRows = c[4] < 0;
+    }
+    const cv::Mat& from = transposed ? target : src(source);
+    if (flipColumns && flipRows) cv::flip(from, target, -1);
+    else if (flipColumns) cv::flip(from, target, 1);
+    else if (flipRows) cv::flip(from, target, 0);
+    else if (!transposed) from.copyTo(target);
+    return true;
+}
+
+void applyWarp(const WarpMaps& maps, const cv::Mat& src, cv::Mat& dst) {
+    if (maps.permutation && applyPermutation(maps, src, dst)) return;
+    cv::remap(src, dst, maps.xy, maps.alpha, cv::INTER_LINEAR, maps.border, cv::Scalar());
+}
@@ -0,0 +1,45 @@
+#ifndef GEOMETRY_HPP
+#define GEOMETRY_HPP
+
+#include <opencv2/opencv.hpp>
+
+// Affine maps here always go from destination to source pixel coordinates:
+//   srcX = m[0] * x + m[1] * y + m[2],  srcY = m[3] * x + m[4] * y + m[5]
+
+// Cached remap tables for one affine map, source size and destination size.
+// Rebuilt by prepareWarp() only when one of those changes, so steady-state frames skip
+// the matrix and coordinate work of cv::warpAffine and go straight to the pixel pass.
+struct WarpMaps {
+    cv::Mat xy;                 // CV_16SC2: integer source coordinates
+    cv::Mat alpha;              // CV_16UC1: index into OpenCV's bilinear weight table
+    cv::Size srcSize, dstSize;
+    double inverse[6] = {0, 0, 0, 0, 0, 0};
+    int border = cv::BORDER_CONSTANT;
+    bool valid = false;
+    // Set when every destination pixel lands exactly on a source pixel through a transpose
+    // and/or flips (rotations by multiples of 90 degrees, pure crops): applyWarp then copies
+    // pixels instead of interpolating, with the same result.
+    bool permutation = false;
+    int coeff[6] = {0, 0, 0, 0, 0, 0}; // Integer form of 'inverse' when 'permutation' is set
+};
+
+// Destination -> source map of warpAffine(forward), inverted exactly as warpAffine inverts it
+void invertAffine(const double (&forward)[6], double (&inverse)[6]);
+
+// Map of operation 'earlier' followed by operation 'later': result(p) = earlier(later(p))
+void composeAffine(const double (&earlier)[6], const double (&later)[6], double (&result)[6]);
+
+// Inverse maps of the menu's geometric operations
+void rotationInverse(double angle, cv::Size size, double (&inverse)[6]);   // About the image center, same size
+void resizeInverse(cv::Size src, cv::Size dst, double (&inverse)[6]);      // Pixel-center mapping of cv::resize
+void cropInverse(int x, int y, double (&inverse)[6]);
+
+// Make 'maps' hold the tables for this map and these sizes; returns true if they were rebuilt.
+// The tables use warpAffine's own fixed-point coordinate rounding.
+bool prepareWarp(WarpMaps& maps, const double (&inverse)[6], cv::Size srcSize, cv::Size dstSize, int border);
+
+// Warp 'src' into 'dst' with prepared maps: bilinear, outside pixels black (BORDER_CONSTANT)
+// or replicated (BORDER_REPLICATE). Same output as cv::warpAffine with INTER_LINEAR.
+void applyWarp(const WarpMaps& maps, const cv::Mat& src, cv::Mat& dst);
+
+#endif // GEOMETRY_HPP
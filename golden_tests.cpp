@@ -0,0 +1,322 @@
+#include <opencv2/opencv.hpp>
+#include "blobs.hpp"
+#include "blur.hpp"
+#include "color_kernel.hpp"
+#include "color_lut.hpp"
+#include "convolution.hpp"
+#include "frame_source.hpp"
+#include "image_processing.hpp"
+#include "incremental_pipeline.hpp"
+#include "packed_mask.hpp"
+#include "pipeline.hpp"
+#include "processing_params.hpp"
+#include "test_support.hpp"
+#include "thread_pool.hpp"
+#include "tiled_pipeline.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Golden-output checks: every optimized path against the OpenCV path it replaces, on
+// deterministic synthetic frames of an awkward size (odd, not a multiple of any vector width)
+// and a common one, in gray and BGR where the operation takes both. Exact paths must match
+// bit for bit; approximate ones must stay within their documented bound. Each check prints
+// one JSON line; the exit status is 1 if any failed. Built by CMakeLists.txt as the
+// golden_tests target and run by ctest.
+
+struct TestSize {
+    int width, height;
+};
+
+static const TestSize testSizes[] = {{643, 481}, {1280, 720}};
+static const int testFrames = 3;            // Distinct frames compared per size
+static const double mismatch = 1e9;         // Difference reported for results of another size or type
+
+struct ColorCase {
+    const char* choice;
+    int lower[3];
+    int upper[3];
+};
+
+static const ColorCase colorCases[] = {
+    {"HSV", {100, 80, 50}, {130, 255, 255}},
+    {"HSV", {0, 0, 0}, {180, 255, 255}},
+    {"BGR", {20, 40, 60}, {200, 220, 240}},
+    {"HSV", {40, 300, 0}, {20, 255, -5}},    // Empty and out-of-range intervals match nothing
+};
+
+static int checks = 0, failures = 0;
+
+// Largest per-element difference, or 'mismatch' if the images cannot be compared
+static double maxDifference(const cv::Mat& expected, const cv::Mat& actual) {
+    if (expected.size() != actual.size() || expected.type() != actual.type()) return mismatch;
+    if (expected.empty()) return 0;
+    return cv::norm(expected, actual, cv::NORM_INF);
+}
+
+static std::string sizeName(const cv::Mat& frame) {
+    return std::to_string(frame.cols) + "x" + std::to_string(frame.rows);
+}
+
+// Record and print one check
+static void report(const std::string& test, const std::string& variant, const std::string& params, const cv::Mat& frame,
+                   double difference, double bound) {
+    const bool pass = difference <= bound;
+    checks++;
+    if (!pass) failures++;
+    char line[512];
+    std::snprintf(line, sizeof(line),
+                  "{\"test\":\"%s\",\"variant\":\"%s\",\"params\":\"%s\",\"size\":\"%s\",\"channels\":%d,\"max_diff\":%.0f,\"bound\":%.1f,\"pass\":%s}",
+                  test.c_str(), variant.c_str(), params.c_str(), sizeName(frame).c_str(), frame.channels(), difference, bound,
+                  pass ? "true" : "false");
+    std::cout << line << std::endl;
+}
+
+static std::string colorParams(const ColorCase& color) {
+    char text[96];
+    std::snprintf(text, sizeof(text), "space=%s lower=%d,%d,%d upper=%d,%d,%d", color.choice, color.lower[0], color.lower[1],
+                  color.lower[2], color.upper[0], color.upper[1], color.upper[2]);
+    return text;
+}
+
+// Single-pass color kernel on every instruction set this CPU has, and the lookup table
+static void checkColor(const std::vector<cv::Mat>& frames) {
+    const std::string detected = colorKernelInstructionSet();
+    ProcessingScratch scratch;
+    cv::Mat expected, actual;
+    for (const ColorCase& color : colorCases) {
+        for (const char* instructionSet : {"scalar", "sse4.1", "avx2", "avx512"}) {
+            if (!setColorKernelInstructionSet(instructionSet)) continue;
+            double difference = 0;
+            for (const cv::Mat& frame : frames) {
+                computeColorMask(frame, expected, color.choice, color.lower, color.upper, scratch);
+                computeColorMaskFast(frame, actual, color.choice, color.lower, color.upper);
+                difference = std::max(difference, maxDifference(expected, actual));
+            }
+            report("color_kernel", instructionSet, colorParams(color), frames[0], difference, 0);
+        }
+        setColorKernelInstructionSet(detected);
+
+        waitForColorLut(color.choice, color.lower, color.upper);
+        double difference = 0;
+        for (const cv::Mat& frame : frames) {
+            computeColorMask(frame, expected, color.choice, color.lower, color.upper, scratch);
+            if (!computeColorMaskLut(frame, actual, color.choice, color.lower, color.upper)) actual.release();
+            difference = std::max(difference, maxDifference(expected, actual));
+        }
+        report("color_lut", "lut", colorParams(color), frames[0], difference, 0);
+
+        // Packed producer: bits straight from the color test, against inRange
+        std::string choice = color.choice;
+        cv::Mat converted;
+        PackedMask mask;
+        difference = 0;
+        for (const cv::Mat& frame : frames) {
+            const cv::Mat* image = &frame;
+            if (choice == "HSV") {
+                cv::cvtColor(frame, converted, cv::COLOR_BGR2HSV);
+                image = &converted;
+            }
+            cv::inRange(*image, cv::Scalar(color.lower[0], color.lower[1], color.lower[2]),
+                        cv::Scalar(color.upper[0], color.upper[1], color.upper[2]), expected);
+            if (colorRangeToMask(frame, color.choice, color.lower, color.upper, mask)) unpackMask(mask, actual);
+            else actual.release();
+            difference = std::max(difference, maxDifference(expected, actual));
+        }
+        report("color_range_mask", "packed", colorParams(color), frames[0], difference, 0);
+    }
+}
+
+// Stacked box filters against cv::GaussianBlur, within the documented bound (plus one level of Gaussian rounding)
+static void checkBoxBlur(const std::vector<cv::Mat>& frames) {
+    ProcessingScratch scratch;
+    cv::Mat expected, actual;
+    for (int kernelSize : {11, 25, 51}) {
+        double difference = 0;
+        for (const cv::Mat& frame : frames) {
+            computeBlurred(frame, expected, kernelSize, "gaussian", scratch);
+            computeBlurred(frame, actual, kernelSize, "box", scratch);
+            difference = std::max(difference, maxDifference(expected, actual));
+        }
+        report("box_blur", "box", "ksize=" + std::to_string(kernelSize), frames[0], difference, boxBlurErrorBound(kernelSize) + 1);
+    }
+}
+
+// Convolution engine strategies against cv::filter2D, within the strategy's tolerance
+static void checkConvolution(const std::vector<cv::Mat>& frames) {
+    const std::vector<float> sharpen = {0, -1, 0, -1, 5, -1, 0, -1, 0};
+    const std::vector<float> gauss = {1 / 16.f, 2 / 16.f, 1 / 16.f, 2 / 16.f, 4 / 16.f, 2 / 16.f, 1 / 16.f, 2 / 16.f, 1 / 16.f};
+    const std::vector<float> emboss = {-2, -1, 0, 0, 0, -1, -1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 1, 2};
+    const std::vector<float> box(9, 1 / 9.f);
+    const struct { const char* name; cv::Mat kernel; } cases[] = {
+        {"sharpen3", cv::Mat(sharpen, true).reshape(1, 3)},
+        {"gauss3", cv::Mat(gauss, true).reshape(1, 3)},
+        {"emboss5", cv::Mat(emboss, true).reshape(1, 5)},
+        {"box3", cv::Mat(box, true).reshape(1, 3)},
+        {"random3", randomKernel(3)},
+        {"random5", randomKernel(5)},
+        {"random7", randomKernel(7)},
+        {"random31", randomKernel(31)},
+    };
+    cv::Mat expected, actual;
+    for (const auto& test : cases) {
+        ConvolutionEngine engine;
+        engine.setKernel(test.kernel);
+        double difference = 0;
+        for (const cv::Mat& frame : frames) {
+            cv::filter2D(frame, expected, -1, test.kernel);
+            if (!engine.apply(frame, actual)) actual.release();
+            difference = std::max(difference, maxDifference(expected, actual));
+        }
+        report("convolution", ConvolutionEngine::strategyName(engine.strategy()), std::string("kernel=") + test.name, frames[0],
+               difference, engine.tolerance());
+    }
+}
+
+// Cached remap tables against cv::warpAffine
+static void checkRotation(const std::vector<cv::Mat>& frames) {
+    ProcessingScratch scratch;
+    cv::Mat expected, actual;
+    for (double angle : {0.0, 15.0, 45.0, 90.0, 180.0, -30.0}) {
+        double difference = 0;
+        for (const cv::Mat& frame : frames) {
+            const cv::Mat rotation = cv::getRotationMatrix2D(cv::Point2f(frame.cols / 2.0f, frame.rows / 2.0f), angle, 1.0);
+            cv::warpAffine(frame, expected, rotation, frame.size());
+            computeRotated(frame, actual, angle, scratch);
+            difference = std::max(difference, maxDifference(expected, actual));
+        }
+        report("rotation", "warp_maps", "angle=" + std::to_string(static_cast<int>(angle)), frames[0], difference, 0);
+    }
+}
+
+// Packed threshold and Canny masks, and packed morphology, against the 0/255 cv::Mat paths
+static void checkPackedMasks(const std::vector<cv::Mat>& frames) {
+    ProcessingScratch scratch;
+    PackedMask mask, result;
+    cv::Mat expected, actual, source;
+    const std::string detected = colorKernelInstructionSet();
+    for (int threshold : {64, 128, 192}) {
+        for (const char* instructionSet : {"scalar", "sse4.1", "avx2", "avx512"}) { // The fused gray rows share the color kernels' dispatch
+            if (!setColorKernelInstructionSet(instructionSet)) continue;
+            double difference = 0;
+            for (const cv::Mat& frame : frames) {
+                computeThresholded(frame, expected, threshold, scratch);
+                if (computeThresholdMask(frame, mask, threshold)) unpackMask(mask, actual);
+                else actual.release();
+                difference = std::max(difference, maxDifference(expected, actual));
+            }
+            report("threshold_mask", instructionSet, "threshold=" + std::to_string(threshold), frames[0], difference, 0);
+        }
+        setColorKernelInstructionSet(detected);
+    }
+
+    double difference = 0;
+    for (const cv::Mat& frame : frames) {
+        computeCanny(frame, expected, 50, 150, scratch);
+        computeCannyMask(frame, mask, 50, 150, scratch);
+        unpackMask(mask, actual);
+        difference = std::max(difference, maxDifference(expected, actual));
+    }
+    report("canny_mask", "packed", "low=50 high=150", frames[0], difference, 0);
+
+    for (int kernelSize : {3, 9, 25}) {
+        for (int dilate = 0; dilate < 2; ++dilate) {
+            difference = 0;
+            for (const cv::Mat& frame : frames) {
+                computeThresholded(frame, source, 128, scratch);
+                computeThresholdMask(frame, mask, 128);
+                if (dilate) {
+                    computeDilation(source, expected, kernelSize, scratch);
+                    computeMaskDilation(mask, result, kernelSize, scratch);
+                } else {
+                    computeErosion(source, expected, kernelSize, scratch);
+                    computeMaskErosion(mask, result, kernelSize, scratch);
+                }
+                unpackMask(result, actual);
+                difference = std::max(difference, maxDifference(expected, actual));
+            }
+            report(dilate ? "mask_dilation" : "mask_erosion", "packed", "ksize=" + std::to_string(kernelSize), frames[0], difference, 0);
+        }
+    }
+}
+
+// Blob statistics against cv::connectedComponentsWithStats: number of blobs that differ
+static void checkBlobs(const std::vector<cv::Mat>& frames) {
+    ProcessingScratch scratch;
+    BlobWork work;
+    std::vector<Blob> blobs, reference;
+    cv::Mat mask;
+    for (int connectivity : {8, 4}) {
+        BlobOptions options;
+        options.connectivity = connectivity;
+        double differing = 0;
+        for (const cv::Mat& frame : frames) {
+            computeThresholded(frame, mask, 128, scratch);
+            extractBlobs(mask, blobs, options, work);
+            referenceBlobs(mask, connectivity, reference);
+            differing += blobDifferences(reference, blobs);
+        }
+        report("blobs", "runs", "connectivity=" + std::to_string(connectivity), frames[0], differing, 0);
+    }
+}
+
+// Tile-parallel and incremental engines against the whole-frame pipeline
+static void checkEngines(const std::vector<cv::Mat>& frames) {
+    const ProcessingParams params;
+    ThreadPool pool(4);
+    for (const char* chain : {"3", "3C9A", "49A", "3C9AB", "78", "4E"}) {
+        Pipeline pipeline;
+        TiledPipeline tiled(pool);
+        IncrementalPipeline incremental;
+        if (!pipeline.configure(chain) || !tiled.configure(chain) || !incremental.configure(chain)) {
+            report("engine", "configure", std::string("chain=") + chain, frames[0], mismatch, 0);
+            continue;
+        }
+
+        double tiledDifference = 0, incrementalDifference = 0;
+        cv::Mat changed;
+        for (size_t i = 0; i < frames.size(); ++i) {
+            const cv::Mat& frame = frames[i];
+            tiledDifference = std::max(tiledDifference, maxDifference(pipeline.run(frame, params), tiled.run(frame, params)));
+
+            // A new frame, the same frame again, then one with only a square changed
+            frame.copyTo(changed);
+            const cv::Rect square(frame.cols / 3, frame.rows / 3, frame.cols / 5, frame.rows / 5);
+            cv::Mat region = changed(square);
+            frames[(i + 1) % frames.size()](square).copyTo(region);
+            const cv::Mat* inputs[] = {&frame, &frame, &changed};
+            for (const cv::Mat* input : inputs) {
+                incrementalDifference = std::max(incrementalDifference,
+                                                 maxDifference(pipeline.run(*input, params), incremental.run(*input, params)));
+            }
+        }
+        report("tiled_pipeline", "threads=4", std::string("chain=") + chain, frames[0], tiledDifference, 0);
+        report("incremental_pipeline", "tiles", std::string("chain=") + chain, frames[0], incrementalDifference, 0);
+    }
+}
+
+int main() {
+    setDisplayEnabled(false);
+    for (const TestSize& size : testSizes) {
+        std::vector<cv::Mat> bgrFrames(testFrames), grayFrames(testFrames);
+        for (int i = 0; i < testFrames; ++i) {
+            SyntheticSource::render(bgrFrames[i], size.width, size.height, i * 7, 1);
+            cv::cvtColor(bgrFrames[i], grayFrames[i], cv::COLOR_BGR2GRAY);
+        }
+
+        checkColor(bgrFrames);
+        checkEngines(bgrFrames);
+        for (const std::vector<cv::Mat>* frames : {&bgrFrames, &grayFrames}) {
+            checkBoxBlur(*frames);
+            checkConvolution(*frames);
+            checkRotation(*frames);
+            checkPackedMasks(*frames);
+            checkBlobs(*frames);
+        }
+    }
+    std::cout << "{\"test\":\"summary\",\"checks\":" << checks << ",\"failures\":" << failures << "}" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+#include "headless.hpp"
+#include "mat_allocator.hpp"
+#include "metrics.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+
+double percentile(std::vector<double>& values, double pct) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t rank = static_cast<size_t>(pct / 100.0 * (values.size() - 1) + 0.5);
+    return values[std::min(rank, values.size() - 1)];
+}
+
+HeadlessStats runHeadless(FrameSource& source, int frameCount, int warmupFrames,
+                          const std::function<void(const cv::Mat&)>& process) {
+    typedef std::chrono::steady_clock Clock;
+    HeadlessStats stats;
+    std::vector<double> latencies;
+    latencies.reserve(std::max(frameCount, 0));
+
+    MetricCounter* processedTotal = metricsCounter("frames_processed_total");
+    cv::Mat frame;
+    Clock::time_point start = Clock::now();
+    AllocationStats allocationsBefore = getAllocationStats();
+    for (int i = 0; i < warmupFrames + frameCount; ++i) {
+        if (i == warmupFrames) { // Measurement starts after warm-up
+            start = Clock::now();
+            allocationsBefore = getAllocationStats();
+            armFreshAllocationCheck(warmupFrames > 0); // Without warm-up every buffer is a first one
+        }
+
+        if (!source.read(frame)) {
+            if (!source.rewind() || !source.read(frame)) {
+                std::cerr << "Warning: " << source.describe() << " ran out after " << i << " frames" << std::endl;
+                break;
+            }
+        }
+
+        Clock::time_point before = Clock::now();
+        process(frame);
+        Clock::time_point after = Clock::now();
+        processedTotal->add();
+
+        if (i >= warmupFrames) {
+            latencies.push_back(std::chrono::duration<double, std::milli>(after - before).count());
+        }
+    }
+    Clock::time_point end = Clock::now();
+    armFreshAllocationCheck(false);
+    AllocationStats allocationsAfter = getAllocationStats();
+
+    stats.frames = static_cast<int>(latencies.size());
+    stats.seconds = std::chrono::duration<double>(end - start).count();
+    stats.fps = stats.seconds > 0 ? stats.frames / stats.seconds : 0;
+    stats.p50Ms = percentile(latencies, 50);
+    stats.p99Ms = percentile(latencies, 99);
+    stats.maxMs = latencies.empty() ? 0 : latencies.back(); // Sorted by percentile()
+    if (stats.frames > 0) {
+        stats.allocationsPerFrame = double(allocationsAfter.allocations - allocationsBefore.allocations) / stats.frames;
+        stats.freshAllocationsPerFrame = double((allocationsAfter.allocations - allocationsAfter.poolHits) -
+                                                (allocationsBefore.allocations - allocationsBefore.poolHits)) / stats.frames;
+        stats.bytesPerFrame = double(allocationsAfter.bytesAllocated - allocationsBefore.bytesAllocated) / stats.frames;
+    }
+    return stats;
+}
+
+void printHeadlessStats(const std::string& label, const HeadlessStats& stats) {
+    char line[384];
+    std::snprintf(line, sizeof(line), "%s frames=%d fps=%.1f p50_ms=%.3f p99_ms=%.3f max_ms=%.3f allocs_per_frame=%.2f fresh_per_frame=%.2f bytes_per_frame=%.0f",
+                  label.c_str(), stats.frames, stats.fps, stats.p50Ms, stats.p99Ms, stats.maxMs,
+                  stats.allocationsPerFrame, stats.freshAllocationsPerFrame, stats.bytesPerFrame);
+    std::cout << line << std::endl;
+}
@@ -0,0 +1,37 @@
+#ifndef HEADLESS_HPP
+#define HEADLESS_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "frame_source.hpp"
+
+// Timing summary of one headless run
+struct HeadlessStats {
+    int frames = 0;          // Frames processed (excluding warm-up)
+    double seconds = 0;      // Wall time of the measured frames, including reads
+    double fps = 0;          // frames / seconds
+    double p50Ms = 0;        // Median per-frame processing latency
+    double p99Ms = 0;        // 99th percentile per-frame processing latency
+    double maxMs = 0;        // Worst per-frame processing latency
+    double allocationsPerFrame = 0; // cv::Mat buffers allocated per measured frame
+    double freshAllocationsPerFrame = 0; // ... of which the heap provided (the rest came from the pool)
+    double bytesPerFrame = 0;       // Bytes allocated per measured frame
+};
+
+// Run 'process' on 'frameCount' frames from 'source' without any display.
+// The first 'warmupFrames' frames are processed but not measured. Replayable sources
+// are rewound when they run out, so short clips can drive long runs. The measured frames
+// run with the fresh allocation check armed (see setFreshAllocationCheck).
+HeadlessStats runHeadless(FrameSource& source, int frameCount, int warmupFrames,
+                          const std::function<void(const cv::Mat&)>& process);
+
+// Percentile (0-100) of a list of latencies, nearest-rank; the vector is sorted in place
+double percentile(std::vector<double>& values, double pct);
+
+// Print one machine-greppable result line, e.g.
+// "op=3 frames=500 fps=812.4 p50_ms=1.20 p99_ms=1.71 max_ms=2.03 allocs_per_frame=2.00 fresh_per_frame=0.00 bytes_per_frame=6220800"
+void printHeadlessStats(const std::string& label, const HeadlessStats& stats);
+
+#endif // HEADLESS_HPP
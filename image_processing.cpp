@@ -1,134 +1,333 @@
 #include "image_processing.hpp"
+#include "color_kernel.hpp"
+#include "color_lut.hpp"
+#include "blur.hpp"
+#include "metrics.hpp"
 #include <iostream>
 #include <string>
+#include <cmath>
 #include <opencv2/opencv.hpp>
 #include <algorithm>  // for std::transform
 #include <cctype>     // for std::toupper
 
 
-// Convert the frame to grayscale and display it
-void showGrayscale(const cv::Mat& frame) {
-    cv::Mat grayscaleImage;
-    cv::cvtColor(frame, grayscaleImage, cv::COLOR_BGR2GRAY); // Convert the input frame to grayscale
-    cv::imshow("Grayscale Image", grayscaleImage); // Display the grayscale image
+static bool displayEnabled = true; // Cleared in headless mode so no operation touches highgui
+
+void setDisplayEnabled(bool enabled) {
+    displayEnabled = enabled;
 }
 
-// Convert the frame to HSV and display it
-void showHSV(const cv::Mat& frame) {
-    cv::Mat hsvImage;
-    cv::cvtColor(frame, hsvImage, cv::COLOR_BGR2HSV); // Convert the input frame to HSV color space
-    cv::imshow("HSV Image", hsvImage); // Display the HSV image
+bool isDisplayEnabled() {
+    return displayEnabled;
 }
 
-// Apply Gaussian blur to the image and display it
-void showBlurred(const cv::Mat& frame, int kernelSize) {
+// Show an image unless display is disabled
+static void displayImage(const std::string& windowName, const cv::Mat& image) {
+    if (displayEnabled) {
+        cv::imshow(windowName, image);
+    }
+}
+
+
+// ---------------------------------------------------------------------------
+// Compute API: no display, results go to caller-owned buffers
+// ---------------------------------------------------------------------------
+
+// Convert the frame to grayscale (single-channel frames are copied as they are)
+void computeGrayscale(const cv::Mat& frame, cv::Mat& output) {
+    if (frame.channels() == 1) {
+        frame.copyTo(output);
+        return;
+    }
+    cv::cvtColor(frame, output, cv::COLOR_BGR2GRAY); // Convert the input frame to grayscale
+}
+
+// Convert the frame to HSV
+void computeHSV(const cv::Mat& frame, cv::Mat& output) {
+    cv::cvtColor(frame, output, cv::COLOR_BGR2HSV); // Convert the input frame to HSV color space
+}
+
+// Apply Gaussian blur to the image, exactly or with the constant-time box approximation
+void computeBlurred(const cv::Mat& frame, cv::Mat& output, int kernelSize, const std::string& engine, ProcessingScratch& scratch) {
     // Ensure the kernel size is valid
     if (kernelSize <= 0 || kernelSize % 2 == 0) {
         std::cout << "Invalid kernel size. Using default kernel size of 15." << std::endl;
         kernelSize = 15; // Set default kernel size if input is invalid
     }
 
-    cv::Mat blurredImage;
-    cv::GaussianBlur(frame, blurredImage, cv::Size(kernelSize, kernelSize), 0); // Apply Gaussian blur
-    cv::imshow("Blurred Image", blurredImage); // Display the blurred image
+    if (engine == "box") {
+        computeBoxBlur(frame, output, kernelSize, scratch.blurWork);
+        return;
+    }
+    cv::GaussianBlur(frame, output, cv::Size(kernelSize, kernelSize), 0); // Apply Gaussian blur
 }
 
-// Apply thresholding to the grayscale image and display the result
-void showThresholded(const cv::Mat& frame, int thresholdValue) {
+// Apply thresholding to the grayscale image
+void computeThresholded(const cv::Mat& frame, cv::Mat& output, int thresholdValue, ProcessingScratch& scratch) {
     // Ensure the threshold value is valid
     if (thresholdValue < 0 || thresholdValue > 255) {
         std::cout << "Invalid threshold value. Using default threshold of 128." << std::endl;
         thresholdValue = 128; // Use default threshold if input is invalid
     }
 
-    cv::Mat grayscaleImage, thresholdedImage;
-    cv::cvtColor(frame, grayscaleImage, cv::COLOR_BGR2GRAY); // Convert to grayscale
-    cv::threshold(grayscaleImage, thresholdedImage, thresholdValue, 255, cv::THRESH_BINARY); // Apply binary thresholding
-    cv::imshow("Thresholded Image", thresholdedImage); // Display the thresholded image
+    const cv::Mat* gray = &frame;
+    if (frame.channels() != 1) {
+        cv::cvtColor(frame, scratch.gray, cv::COLOR_BGR2GRAY); // Convert to grayscale
+        gray = &scratch.gray;
+    }
+    cv::threshold(*gray, output, thresholdValue, 255, cv::THRESH_BINARY); // Apply binary thresholding
 }
 
-// Crop the image and display it
-void showCropped(const cv::Mat& frame, int x, int y, int width, int height) {
+// Crop the image; the output is a view into 'frame', no pixels are copied
+bool computeCropped(const cv::Mat& frame, cv::Mat& output, int x, int y, int width, int height) {
     // Ensure the cropping dimensions are valid
     if (x >= 0 && y >= 0 && x + width <= frame.cols && y + height <= frame.rows) {
-        cv::Mat croppedImage = frame(cv::Rect(x, y, width, height)); // Crop the image
-        cv::imshow("Cropped Image", croppedImage); // Display the cropped image
-    } else {
-        std::cout << "Invalid cropping dimensions!" << std::endl;
+        output = frame(cv::Rect(x, y, width, height)); // Crop the image
+        return true;
     }
+    std::cout << "Invalid cropping dimensions!" << std::endl;
+    return false;
 }
 
-// Resize the image and display it
-void showResized(const cv::Mat& frame, int newWidth, int newHeight) {
+// Resize the image
+bool computeResized(const cv::Mat& frame, cv::Mat& output, int newWidth, int newHeight) {
     // Ensure valid resizing dimensions
     if (newWidth > 0 && newHeight > 0) {
-        cv::Mat resizedImage;
-        cv::resize(frame, resizedImage, cv::Size(newWidth, newHeight)); // Resize the image
-        cv::imshow("Resized Image", resizedImage); // Display the resized image
-    } else {
-        std::cout << "Invalid dimensions for resizing!" << std::endl;
+        cv::resize(frame, output, cv::Size(newWidth, newHeight)); // Resize the image
+        return true;
     }
+    std::cout << "Invalid dimensions for resizing!" << std::endl;
+    return false;
 }
 
-// Rotate the image and display it
-void showRotated(const cv::Mat& frame, double angle) {
-    // Define the center of the image for rotation
-    cv::Point2f center(frame.cols / 2.0f, frame.rows / 2.0f);
-    cv::Mat rotationMatrix = cv::getRotationMatrix2D(center, angle, 1.0); // Generate rotation matrix
-    cv::Mat rotatedImage;
-    cv::warpAffine(frame, rotatedImage, rotationMatrix, frame.size()); // Rotate the image
-    cv::imshow("Rotated Image", rotatedImage); // Display the rotated image
+// Rotate the image around its center. The remap tables are cached in scratch and only rebuilt
+// when the angle or frame size changes; multiples of 90 degrees are done by transpose/flip.
+void computeRotated(const cv::Mat& frame, cv::Mat& output, double angle, ProcessingScratch& scratch) {
+    double inverse[6];
+    rotationInverse(angle, frame.size(), inverse); // Same matrix as cv::getRotationMatrix2D, inverted
+    prepareWarp(scratch.rotation, inverse, frame.size(), frame.size(), cv::BORDER_CONSTANT);
+    applyWarp(scratch.rotation, frame, output); // Same pixels as cv::warpAffine
 }
 
-// Apply convolution to the image and display the result
-void applyConvolution(const cv::Mat& frame, const cv::Mat& kernel) {
+// Apply convolution to the image; the kernel is analyzed once and the strategy kept in scratch
+bool computeConvolution(const cv::Mat& frame, cv::Mat& output, const cv::Mat& kernel, ProcessingScratch& scratch) {
     // Validate the kernel size
     if (kernel.empty() || kernel.rows % 2 == 0 || kernel.cols % 2 == 0) {
         std::cout << "Invalid kernel. Please provide a valid odd-sized kernel." << std::endl;
-        return;
+        return false;
     }
 
-    cv::Mat result;
-    cv::filter2D(frame, result, -1, kernel); // Perform 2D convolution
-    cv::imshow("Convolution Result", result); // Display the result of the convolution
+    if (!scratch.convolution.hasKernel(kernel) && !scratch.convolution.setKernel(kernel)) return false;
+    return scratch.convolution.apply(frame, output); // Perform 2D convolution
 }
 
-// Apply erosion to the image and display the result
-void applyErosion(const cv::Mat& frame, int kernelSize) {
+// Rectangular structuring element, rebuilt only when the size changes
+static const cv::Mat& rectElement(ProcessingScratch& scratch, int kernelSize) {
+    if (scratch.elementSize != kernelSize) {
+        scratch.element = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(kernelSize, kernelSize));
+        scratch.elementSize = kernelSize;
+    }
+    return scratch.element;
+}
+
+// Apply erosion to the image
+void computeErosion(const cv::Mat& frame, cv::Mat& output, int kernelSize, ProcessingScratch& scratch) {
     // Validate the kernel size
     if (kernelSize <= 0 || kernelSize % 2 == 0) {
         std::cout << "Invalid kernel size. Using default size of 3." << std::endl;
         kernelSize = 3; // Use default kernel size if input is invalid
     }
 
-    // Define the kernel for erosion
-    cv::Mat element = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(kernelSize, kernelSize));
-    cv::Mat erodedImage;
-    cv::erode(frame, erodedImage, element); // Apply erosion
-    cv::imshow("Eroded Image", erodedImage); // Display the eroded image
+    cv::erode(frame, output, rectElement(scratch, kernelSize)); // Apply erosion
 }
 
-// Apply dilation to the image and display the result
-void applyDilation(const cv::Mat& frame, int kernelSize) {
+// Apply dilation to the image
+void computeDilation(const cv::Mat& frame, cv::Mat& output, int kernelSize, ProcessingScratch& scratch) {
+    // Validate the kernel size
+    if (kernelSize <= 0 || kernelSize % 2 == 0) {
+        std::cout << "Invalid kernel size. Using default size of 3." << std::endl;
+        kernelSize = 3; // Use default kernel size if input is invalid
+    }
+
+    cv::dilate(frame, output, rectElement(scratch, kernelSize)); // Apply dilation
+}
+
+// Perform Canny edge detection
+void computeCanny(const cv::Mat& frame, cv::Mat& output, int lowerThreshold, int upperThreshold, ProcessingScratch& scratch) {
+    const cv::Mat* gray = &frame;
+    if (frame.channels() != 1) {
+        cv::cvtColor(frame, scratch.gray, cv::COLOR_BGR2GRAY);
+        gray = &scratch.gray;
+    }
+    cv::Canny(*gray, output, lowerThreshold, upperThreshold); // Apply Canny edge detection
+}
+
+// Keep only the pixels whose color lies inside [lowerBound, upperBound]; returns false for an unknown color space
+bool computeColorMask(const cv::Mat& frame, cv::Mat& output, std::string choice, const int (&lowerBound)[3], const int (&upperBound)[3], ProcessingScratch& scratch) {
+    cv::Scalar lowerBoundn = cv::Scalar(lowerBound[0], lowerBound[1], lowerBound[2]);
+    cv::Scalar upperBoundn = cv::Scalar(upperBound[0], upperBound[1], upperBound[2]);
+
+    // Convert choice to uppercase
+    std::transform(choice.begin(), choice.end(), choice.begin(), ::toupper);
+
+    if (choice == "HSV") {
+        cv::cvtColor(frame, scratch.hsv, cv::COLOR_BGR2HSV);
+        cv::inRange(scratch.hsv, lowerBoundn, upperBoundn, scratch.mask); // Apply the color filter
+    } else if (choice == "RBG" || choice == "BGR") {
+        cv::inRange(frame, lowerBoundn, upperBoundn, scratch.mask); // Mask the image based on the color range
+    } else {
+        return false;
+    }
+
+    // Combine the mask with the original frame. bitwise_and only zeroes the
+    // masked-out pixels of a freshly allocated output, so clear the reused one first.
+    output.create(frame.size(), frame.type());
+    output.setTo(cv::Scalar::all(0));
+    frame.copyTo(output, scratch.mask);
+    return true;
+}
+
+
+// ---------------------------------------------------------------------------
+// Packed-mask API: one bit per pixel, same validation as the cv::Mat versions
+// ---------------------------------------------------------------------------
+
+// Threshold straight into a packed mask: gray conversion and threshold in one pass
+bool computeThresholdMask(const cv::Mat& frame, PackedMask& mask, int thresholdValue) {
+    // Ensure the threshold value is valid
+    if (thresholdValue < 0 || thresholdValue > 255) {
+        std::cout << "Invalid threshold value. Using default threshold of 128." << std::endl;
+        thresholdValue = 128; // Use default threshold if input is invalid
+    }
+    return thresholdToMask(frame, thresholdValue, mask);
+}
+
+bool computeBlobs(const cv::Mat& frame, cv::Mat& output, int thresholdValue, const BlobOptions& options, ProcessingScratch& scratch) {
+    if (!computeThresholdMask(frame, scratch.blobWork.mask, thresholdValue)) return false;
+    extractBlobs(scratch.blobWork.mask, scratch.blobs, options, scratch.blobWork);
+    static MetricGauge* const blobCount = metricsGauge("blobs");
+    blobCount->set(static_cast<double>(scratch.blobs.size()));
+    if (frame.channels() == 1) cv::cvtColor(frame, output, cv::COLOR_GRAY2BGR);
+    else frame.copyTo(output);
+    drawBlobs(output, scratch.blobs);
+    return true;
+}
+
+// Canny edges as a packed mask (the 0/255 edge image goes through scratch.mask)
+void computeCannyMask(const cv::Mat& frame, PackedMask& mask, int lowerThreshold, int upperThreshold, ProcessingScratch& scratch) {
+    computeCanny(frame, scratch.mask, lowerThreshold, upperThreshold, scratch);
+    packMask(scratch.mask, mask);
+}
+
+// Apply erosion to a packed mask
+void computeMaskErosion(const PackedMask& mask, PackedMask& output, int kernelSize, ProcessingScratch& scratch) {
+    // Validate the kernel size
+    if (kernelSize <= 0 || kernelSize % 2 == 0) {
+        std::cout << "Invalid kernel size. Using default size of 3." << std::endl;
+        kernelSize = 3; // Use default kernel size if input is invalid
+    }
+
+    erodeMask(mask, output, kernelSize, scratch.maskWork);
+}
+
+// Apply dilation to a packed mask
+void computeMaskDilation(const PackedMask& mask, PackedMask& output, int kernelSize, ProcessingScratch& scratch) {
     // Validate the kernel size
     if (kernelSize <= 0 || kernelSize % 2 == 0) {
         std::cout << "Invalid kernel size. Using default size of 3." << std::endl;
         kernelSize = 3; // Use default kernel size if input is invalid
     }
 
-    // Define the kernel for dilation
-    cv::Mat element = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(kernelSize, kernelSize));
-    cv::Mat dilatedImage;
-    cv::dilate(frame, dilatedImage, element); // Apply dilation
-    cv::imshow("Dilated Image", dilatedImage); // Display the dilated image
+    dilateMask(mask, output, kernelSize, scratch.maskWork);
+}
+
+
+// ---------------------------------------------------------------------------
+// Display API: compute into persistent buffers, then show
+// ---------------------------------------------------------------------------
+
+static ProcessingScratch displayScratch; // Shared by the show* wrappers, which all run on the UI thread
+
+// Convert the frame to grayscale and display it
+void showGrayscale(const cv::Mat& frame) {
+    static cv::Mat grayscaleImage;
+    computeGrayscale(frame, grayscaleImage);
+    displayImage("Grayscale Image", grayscaleImage); // Display the grayscale image
+}
+
+// Convert the frame to HSV and display it
+void showHSV(const cv::Mat& frame) {
+    static cv::Mat hsvImage;
+    computeHSV(frame, hsvImage);
+    displayImage("HSV Image", hsvImage); // Display the HSV image
+}
+
+// Apply Gaussian blur to the image and display it
+void showBlurred(const cv::Mat& frame, int kernelSize, const std::string& engine) {
+    static cv::Mat blurredImage;
+    computeBlurred(frame, blurredImage, kernelSize, engine, displayScratch);
+    displayImage("Blurred Image", blurredImage); // Display the blurred image
+}
+
+// Apply thresholding to the grayscale image and display the result
+void showThresholded(const cv::Mat& frame, int thresholdValue) {
+    static cv::Mat thresholdedImage;
+    computeThresholded(frame, thresholdedImage, thresholdValue, displayScratch);
+    displayImage("Thresholded Image", thresholdedImage); // Display the thresholded image
+}
+
+// Crop the image and display it
+void showCropped(const cv::Mat& frame, int x, int y, int width, int height) {
+    cv::Mat croppedImage;
+    if (computeCropped(frame, croppedImage, x, y, width, height)) {
+        displayImage("Cropped Image", croppedImage); // Display the cropped image
+    }
+}
+
+// Resize the image and display it
+void showResized(const cv::Mat& frame, int newWidth, int newHeight) {
+    static cv::Mat resizedImage;
+    if (computeResized(frame, resizedImage, newWidth, newHeight)) {
+        displayImage("Resized Image", resizedImage); // Display the resized image
+    }
+}
+
+// Rotate the image and display it
+void showRotated(const cv::Mat& frame, double angle) {
+    static cv::Mat rotatedImage;
+    computeRotated(frame, rotatedImage, angle, displayScratch);
+    displayImage("Rotated Image", rotatedImage); // Display the rotated image
+}
+
+// Apply convolution to the image and display the result
+void applyConvolution(const cv::Mat& frame, const cv::Mat& kernel) {
+    static cv::Mat result;
+    const bool newKernel = !displayScratch.convolution.hasKernel(kernel);
+    if (computeConvolution(frame, result, kernel, displayScratch)) {
+        if (newKernel) std::cout << "Convolution: " << displayScratch.convolution.describe() << std::endl;
+        displayImage("Convolution Result", result); // Display the result of the convolution
+    }
+}
+
+// Apply erosion to the image and display the result
+void applyErosion(const cv::Mat& frame, int kernelSize) {
+    static cv::Mat erodedImage;
+    computeErosion(frame, erodedImage, kernelSize, displayScratch);
+    displayImage("Eroded Image", erodedImage); // Display the eroded image
+}
+
+// Apply dilation to the image and display the result
+void applyDilation(const cv::Mat& frame, int kernelSize) {
+    static cv::Mat dilatedImage;
+    computeDilation(frame, dilatedImage, kernelSize, displayScratch);
+    displayImage("Dilated Image", dilatedImage); // Display the dilated image
 }
 
 // Perform Canny edge detection and display the result
 void applyCanny(const cv::Mat& frame, int lowerThreshold, int upperThreshold) {
-    cv::Mat edges, imgGray;
-    cv::cvtColor(frame, imgGray, cv::COLOR_BGR2GRAY);
-    cv::Canny(imgGray, edges, lowerThreshold, upperThreshold); // Apply Canny edge detection
-    cv::imshow("Canny Edge Detection", edges); // Display edge-detected image
+    static cv::Mat edges;
+    computeCanny(frame, edges, lowerThreshold, upperThreshold, displayScratch);
+    displayImage("Canny Edge Detection", edges); // Display edge-detected image
 }
 
 
@@ -142,47 +341,20 @@ void applyCanny(const cv::Mat& frame, int lowerThreshold, int upperThreshold) {
 //     // Callback function does nothing; it’s here to satisfy OpenCV’s API
 // }
 
-void detectColor(const cv::Mat &frame, std::string choice, int (&lowerBound)[3], int (&upperBound)[3]) {
-    // Create a window for color detection
-    const std::string windowName = "Color Detection";
-    cv::namedWindow(windowName, cv::WINDOW_AUTOSIZE);
-
-    // Extract current HSV bounds
-    int lowerH = static_cast<int>(lowerBound[0]);
-    int lowerS = static_cast<int>(lowerBound[1]);
-    int lowerV = static_cast<int>(lowerBound[2]);
-    int upperH = static_cast<int>(upperBound[0]);
-    int upperS = static_cast<int>(upperBound[1]);
-    int upperV = static_cast<int>(upperBound[2]);
-    // Update HSV bounds from trackbars
-    cv::Scalar lowerBoundn = cv::Scalar(lowerH, lowerS, lowerV);
-    cv::Scalar upperBoundn = cv::Scalar(upperH, upperS, upperV);
-
-    // Convert choice to uppercase
-    std::transform(choice.begin(), choice.end(), choice.begin(), ::toupper);
+void detectColor(const cv::Mat &frame, std::string choice, int (&lowerBound)[3], int (&upperBound)[3], const std::string& engine) {
+    const std::string windowName = "Color Detection"; // Created with its trackbars once per mode, or by the first imshow
 
-    if (choice == "HSV") {
-
-        cv::Mat hsv;
-        cv::cvtColor(frame, hsv, cv::COLOR_BGR2HSV);
-
-        // Apply the color filter
-        cv::Mat mask;
-        cv::inRange(hsv, lowerBoundn, upperBoundn, mask);
-
-        // Combine the mask with the original frame
-        cv::Mat result;
-        cv::bitwise_and(frame, frame, result, mask);
-
-        // Display the result on same window
-        cv::imshow(windowName, result);
-    } else if (choice == "RBG" || choice == "BGR"){
-
-        cv::Mat mask, result;
-        cv::inRange(frame, lowerBoundn, upperBoundn, mask); // Mask the image based on the color range
-        cv::bitwise_and(frame, frame, result, mask); // Apply the mask to the original frame
-        cv::imshow(windowName, result); // Display the result        
+    static cv::Mat result;
+    if ((engine == "lut" && computeColorMaskLut(frame, result, choice, lowerBound, upperBound)) ||
+        computeColorMaskFast(frame, result, choice, lowerBound, upperBound) ||
+        computeColorMask(frame, result, choice, lowerBound, upperBound, displayScratch)) {
+        displayImage(windowName, result); // Display the result on same window
     }
+}
 
-    
+void showBlobs(const cv::Mat& frame, int thresholdValue, const BlobOptions& options) {
+    static cv::Mat result;
+    if (computeBlobs(frame, result, thresholdValue, options, displayScratch)) {
+        displayImage("Blobs", result);
+    }
 }
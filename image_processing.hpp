@@ -1,12 +1,68 @@
 #ifndef IMAGE_PROCESSING_HPP
 #define IMAGE_PROCESSING_HPP
 
+#include <cstdint>
 #include <string>
 #include <opencv2/opencv.hpp>
+#include "blobs.hpp"
+#include "geometry.hpp"
+#include "convolution.hpp"
+#include "packed_mask.hpp"
 
+// Enable or disable all imshow/namedWindow calls (disabled for headless runs)
+void setDisplayEnabled(bool enabled);
+bool isDisplayEnabled();
+
+// Intermediate buffers owned by the caller and reused from frame to frame.
+// Keep one per processing thread; buffers are only reallocated when the frame size or type changes.
+struct ProcessingScratch {
+    cv::Mat gray;
+    cv::Mat bgr;           // Single-channel input promoted to BGR
+    cv::Mat hsv;
+    cv::Mat mask;
+    WarpMaps rotation;     // Remap tables of the last rotation angle and frame size
+    cv::Mat blurWork[2];   // Fixed-point intermediates of the box blur engine
+    ConvolutionEngine convolution; // Strategy for the last convolution kernel
+    uint64_t convolutionVersion = 0; // ParamStore snapshot 'convolution' was set from, 0 if unknown
+    cv::Mat element;       // Structuring element for erosion/dilation
+    PackedMaskWork maskWork; // Row and column buffers of packed-mask erosion/dilation
+    int elementSize = 0;   // Size 'element' was built for
+    BlobWork blobWork;     // Mask, runs and union-find forest of blob extraction
+    std::vector<Blob> blobs; // Blobs found by the last computeBlobs
+};
+
+// Compute API: each operation writes into 'output' and never displays anything.
+// Passing the same 'output' every frame makes the steady state allocation free.
+// Operations that start from grayscale (grayscale, threshold, Canny) also accept single-channel frames.
+void computeGrayscale(const cv::Mat& frame, cv::Mat& output);
+void computeHSV(const cv::Mat& frame, cv::Mat& output);
+// Blur engines: "gaussian" (exact cv::GaussianBlur) or "box" (stacked box filters, constant cost per pixel, see blur.hpp)
+void computeBlurred(const cv::Mat& frame, cv::Mat& output, int kernelSize, const std::string& engine, ProcessingScratch& scratch);
+void computeThresholded(const cv::Mat& frame, cv::Mat& output, int thresholdValue, ProcessingScratch& scratch);
+bool computeCropped(const cv::Mat& frame, cv::Mat& output, int x, int y, int width, int height);
+bool computeResized(const cv::Mat& frame, cv::Mat& output, int newWidth, int newHeight);
+void computeRotated(const cv::Mat& frame, cv::Mat& output, double angle, ProcessingScratch& scratch);
+bool computeConvolution(const cv::Mat& frame, cv::Mat& output, const cv::Mat& kernel, ProcessingScratch& scratch);
+void computeErosion(const cv::Mat& frame, cv::Mat& output, int kernelSize, ProcessingScratch& scratch);
+void computeDilation(const cv::Mat& frame, cv::Mat& output, int kernelSize, ProcessingScratch& scratch);
+void computeCanny(const cv::Mat& frame, cv::Mat& output, int lowerThreshold, int upperThreshold, ProcessingScratch& scratch);
+bool computeColorMask(const cv::Mat& frame, cv::Mat& output, std::string choice, const int (&lowerBound)[3], const int (&upperBound)[3], ProcessingScratch& scratch);
+// Blobs of the pixels brighter than thresholdValue (see blobs.hpp), left in scratch.blobs and drawn
+// onto a BGR copy of the frame. Returns false for input that is not 8-bit BGR or gray.
+bool computeBlobs(const cv::Mat& frame, cv::Mat& output, int thresholdValue, const BlobOptions& options, ProcessingScratch& scratch);
+
+// Packed-mask API: binary results at one bit per pixel (see packed_mask.hpp), for chains
+// that keep a mask through several operations. Same pixels as the cv::Mat versions above.
+// computeThresholdMask returns false for input that is not 8-bit BGR or gray.
+bool computeThresholdMask(const cv::Mat& frame, PackedMask& mask, int thresholdValue);
+void computeCannyMask(const cv::Mat& frame, PackedMask& mask, int lowerThreshold, int upperThreshold, ProcessingScratch& scratch);
+void computeMaskErosion(const PackedMask& mask, PackedMask& output, int kernelSize, ProcessingScratch& scratch);
+void computeMaskDilation(const PackedMask& mask, PackedMask& output, int kernelSize, ProcessingScratch& scratch);
+
+// Display API: thin wrappers that compute into persistent buffers and show the result
 void showGrayscale(const cv::Mat& frame);
 void showHSV(const cv::Mat& frame);
-void showBlurred(const cv::Mat& frame, int kernelSize);
+void showBlurred(const cv::Mat& frame, int kernelSize, const std::string& engine);
 void showThresholded(const cv::Mat& frame, int thresholdValue);
 void showCropped(const cv::Mat& frame, int x, int y, int width, int height);
 void showResized(const cv::Mat& frame, int newWidth, int newHeight);
@@ -15,6 +71,7 @@ void applyConvolution(const cv::Mat& frame, const cv::Mat& kernel);
 void applyErosion(const cv::Mat& frame, int kernelSize);
 void applyDilation(const cv::Mat& frame, int kernelSize);
 void applyCanny(const cv::Mat& frame, int lowerThreshold, int upperThreshold);
-void detectColor(const cv::Mat& frame, std::string choice, int (&lowerBound)[3], int (&upperBound)[3]);
+void detectColor(const cv::Mat& frame, std::string choice, int (&lowerBound)[3], int (&upperBound)[3], const std::string& engine);
+void showBlobs(const cv::Mat& frame, int thresholdValue, const BlobOptions& options);
 
 #endif // IMAGE_PROCESSING_HPP
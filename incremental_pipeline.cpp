@@ -0,0 +1,168 @@
+#include "incremental_pipeline.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+
+static const size_t maxWindowPipelines = 32; // Distinct window sizes kept before the cache starts over
+
+bool IncrementalPipeline::configure(const std::string& choices) {
+    Pipeline check;
+    if (!check.configure(choices)) return false; // Reports the unsupported choice
+
+    chain = choices;
+    size_t split = 0;
+    while (split < chain.size() && stageHaloRows(chain[split], ProcessingParams()) >= 0) split++;
+    tileStages = chain.substr(0, split);
+    whole.configure(tileStages);
+    rest.configure(chain.substr(split));
+    windows.clear();
+    primed = false;
+    output = nullptr;
+    counts = IncrementalStats();
+    return true;
+}
+
+std::string IncrementalPipeline::describe() const {
+    std::string text;
+    if (!tileStages.empty()) text = "tiles(" + whole.describe() + ")";
+    if (chain.size() > tileStages.size()) text += (text.empty() ? "" : " -> ") + rest.describe();
+    return text;
+}
+
+const cv::Mat& IncrementalPipeline::run(const cv::Mat& frame, const ProcessingParams& params) {
+    tileRows = (frame.rows + tileSize - 1) / tileSize;
+    tileCols = (frame.cols + tileSize - 1) / tileSize;
+    const size_t tileCount = static_cast<size_t>(tileRows) * tileCols;
+    counts.frames++;
+    counts.tiles += tileCount;
+
+    int halo = 0;
+    for (size_t k = 0; k < tileStages.size(); ++k) halo += stageHaloRows(tileStages[k], params);
+    if (!primed || frame.size() != previous.size() || frame.type() != previous.type() || !sameParams(params, lastParams) ||
+        !processDirty(frame, params, halo)) {
+        processAll(frame, params);
+        counts.fullFrames++;
+    }
+    return *output;
+}
+
+// Run every stage on the whole frame and remember the frame and the result
+void IncrementalPipeline::processAll(const cv::Mat& frame, const ProcessingParams& params) {
+    frame.copyTo(previous);
+    lastParams = params;
+    primed = true;
+    if (!tileStages.empty()) whole.run(previous, params).copyTo(tiled);
+    const cv::Mat& input = tileStages.empty() ? previous : tiled;
+    output = chain.size() > tileStages.size() ? &rest.run(input, params) : &input;
+}
+
+// Find the tiles that changed since the previous frame and recompute what depends on them.
+// Returns false if a window came out in an unexpected size or type and the frame must be redone whole.
+bool IncrementalPipeline::processDirty(const cv::Mat& frame, const ProcessingParams& params, int halo) {
+    const size_t tileCount = static_cast<size_t>(tileRows) * tileCols;
+    const size_t pixelBytes = frame.elemSize();
+    changed.assign(tileCount, 0);
+    size_t changedCount = 0;
+    for (int ty = 0; ty < tileRows; ++ty) {
+        const int y0 = ty * tileSize, y1 = std::min(frame.rows, y0 + tileSize);
+        for (int tx = 0; tx < tileCols; ++tx) {
+            const int x0 = tx * tileSize, x1 = std::min(frame.cols, x0 + tileSize);
+            for (int y = y0; y < y1; ++y) {
+                if (std::memcmp(frame.ptr(y) + x0 * pixelBytes, previous.ptr(y) + x0 * pixelBytes, (x1 - x0) * pixelBytes) != 0) {
+                    changed[ty * tileCols + tx] = 1;
+                    changedCount++;
+                    const cv::Rect tile(x0, y0, x1 - x0, y1 - y0);
+                    cv::Mat target = previous(tile);
+                    frame(tile).copyTo(target);
+                    break;
+                }
+            }
+        }
+    }
+    if (changedCount == 0) {
+        counts.skippedTiles += tileCount;
+        return true; // Same input, same parameters: the previous result stands
+    }
+    if (tileStages.empty()) {
+        output = &rest.run(previous, params);
+        return true;
+    }
+
+    // A result pixel depends on input pixels up to 'halo' away: grow the changed tiles by that many tiles
+    const int reach = (halo + tileSize - 1) / tileSize;
+    std::vector<unsigned char> across(tileCount, 0);
+    dirty.assign(tileCount, 0);
+    for (int ty = 0; ty < tileRows; ++ty) {
+        for (int tx = 0; tx < tileCols; ++tx) {
+            for (int k = std::max(0, tx - reach); k <= std::min(tileCols - 1, tx + reach) && !across[ty * tileCols + tx]; ++k) {
+                across[ty * tileCols + tx] = changed[ty * tileCols + k];
+            }
+        }
+    }
+    size_t dirtyCount = 0;
+    for (int ty = 0; ty < tileRows; ++ty) {
+        for (int tx = 0; tx < tileCols; ++tx) {
+            for (int k = std::max(0, ty - reach); k <= std::min(tileRows - 1, ty + reach) && !dirty[ty * tileCols + tx]; ++k) {
+                dirty[ty * tileCols + tx] = across[k * tileCols + tx];
+            }
+            dirtyCount += dirty[ty * tileCols + tx];
+        }
+    }
+
+    // Runs of dirty tiles along a tile row, merged with the run right above when they span the same columns
+    std::vector<cv::Rect> regions;
+    for (int ty = 0; ty < tileRows; ++ty) {
+        const int y0 = ty * tileSize, y1 = std::min(frame.rows, y0 + tileSize);
+        for (int tx = 0; tx < tileCols; ++tx) {
+            if (!dirty[ty * tileCols + tx]) continue;
+            int end = tx;
+            while (end + 1 < tileCols && dirty[ty * tileCols + end + 1]) end++;
+            const int x0 = tx * tileSize, x1 = std::min(frame.cols, (end + 1) * tileSize);
+            bool merged = false;
+            for (cv::Rect& region : regions) {
+                if (region.x == x0 && region.width == x1 - x0 && region.y + region.height == y0) {
+                    region.height += y1 - y0;
+                    merged = true;
+                    break;
+                }
+            }
+            if (!merged) regions.push_back(cv::Rect(x0, y0, x1 - x0, y1 - y0));
+            tx = end;
+        }
+    }
+
+    // Each region is computed on a window that adds the halo on every side that is not the frame edge
+    const cv::Rect frameRect(0, 0, frame.cols, frame.rows);
+    for (const cv::Rect& region : regions) {
+        const cv::Rect window = cv::Rect(region.x - halo, region.y - halo, region.width + 2 * halo, region.height + 2 * halo) & frameRect;
+        const cv::Mat& result = windowPipeline(window.size()).run(previous(window), params);
+        if (result.size() != window.size() || result.type() != tiled.type()) return false;
+        cv::Mat target = tiled(region);
+        result(cv::Rect(region.x - window.x, region.y - window.y, region.width, region.height)).copyTo(target);
+    }
+    counts.skippedTiles += tileCount - dirtyCount;
+    output = chain.size() > tileStages.size() ? &rest.run(tiled, params) : &tiled;
+    return true;
+}
+
+// Tile stages for windows of one size, so each keeps its buffers from frame to frame
+Pipeline& IncrementalPipeline::windowPipeline(const cv::Size& size) {
+    const std::pair<int, int> key(size.width, size.height);
+    std::map<std::pair<int, int>, Pipeline>::iterator found = windows.find(key);
+    if (found != windows.end()) return found->second;
+    if (windows.size() >= maxWindowPipelines) windows.clear();
+    Pipeline& pipeline = windows[key];
+    pipeline.configure(tileStages, "tile");
+    return pipeline;
+}
+
+void printIncrementalStats(const std::string& label, const IncrementalStats& stats) {
+    char line[512];
+    std::snprintf(line, sizeof(line), "%s incremental frames=%llu full_frames=%llu tiles=%llu skipped_tiles=%llu skipped_pct=%.1f",
+                  label.c_str(), static_cast<unsigned long long>(stats.frames), static_cast<unsigned long long>(stats.fullFrames),
+                  static_cast<unsigned long long>(stats.tiles), static_cast<unsigned long long>(stats.skippedTiles),
+                  stats.tiles ? 100.0 * stats.skippedTiles / stats.tiles : 0.0);
+    std::cout << line << std::endl;
+}
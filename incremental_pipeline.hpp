@@ -0,0 +1,73 @@
+#ifndef INCREMENTAL_PIPELINE_HPP
+#define INCREMENTAL_PIPELINE_HPP
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "pipeline.hpp"
+#include "processing_params.hpp"
+
+// Tiles looked at and tiles whose previous result was reused
+struct IncrementalStats {
+    uint64_t frames = 0;
+    uint64_t fullFrames = 0;    // Processed whole: the first frame, or after a size or parameter change
+    uint64_t tiles = 0;         // Tiles of every frame
+    uint64_t skippedTiles = 0;  // Not reprocessed because nothing they depend on changed
+};
+
+// Runs an operation chain on frames of a mostly static scene, reprocessing only what changed.
+//
+// Each frame is compared with the previous one tile by tile (tileSize pixels square). The
+// leading stages that work on windows of the frame (point-wise, blur, erosion, dilation; see
+// stageHaloRows) are then rerun only on the changed tiles, grown by the tiles that their
+// halo reaches, each on a window of the input widened by the halo so the tile sees real
+// pixels, exactly as in a whole-frame run. Every other tile keeps its previous result.
+// The remaining stages (Canny, convolution, geometric) need the whole frame: they run on it
+// only when at least one tile changed. A frame identical to the previous one costs one
+// comparison. The result is identical to Pipeline::run on the whole frame.
+class IncrementalPipeline {
+public:
+    static const int tileSize = 64;
+
+    // Build the chain; returns false (and prints why) on an unsupported choice
+    bool configure(const std::string& choices);
+
+    const std::string& choices() const { return chain; }
+
+    // Run the chain on one frame. The result stays valid until the next call.
+    const cv::Mat& run(const cv::Mat& frame, const ProcessingParams& params);
+
+    // Incremental stages as "tiles(...)", then the whole-frame ones, e.g. "tiles(3 -> [2 C]) -> B"
+    std::string describe() const;
+
+    const IncrementalStats& stats() const { return counts; }
+
+private:
+    void processAll(const cv::Mat& frame, const ProcessingParams& params);
+    bool processDirty(const cv::Mat& frame, const ProcessingParams& params, int halo);
+    Pipeline& windowPipeline(const cv::Size& size);
+
+    std::string chain;
+    std::string tileStages;     // Leading stages run on windows
+    Pipeline whole;             // The tile stages on a whole frame
+    Pipeline rest;              // The stages after them
+    std::map<std::pair<int, int>, Pipeline> windows; // Tile stages by window size, so each keeps its buffers
+
+    bool primed = false;        // 'previous' and 'tiled' hold the last frame and its result
+    cv::Mat previous;           // Last input
+    cv::Mat tiled;              // Result of the tile stages for 'previous'
+    const cv::Mat* output = nullptr; // Last result
+    ProcessingParams lastParams;
+    int tileRows = 0, tileCols = 0;
+    std::vector<unsigned char> changed, dirty; // Per tile: input differs, result must be recomputed
+    IncrementalStats counts;
+};
+
+// Print one result line with the share of tiles skipped, e.g.
+// "op=D incremental frames=300 full_frames=1 tiles=153000 skipped_tiles=148920 skipped_pct=97.3"
+void printIncrementalStats(const std::string& label, const IncrementalStats& stats);
+
+#endif // INCREMENTAL_PIPELINE_HPP
@@ -1,46 +1,33 @@
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include "image_processing.hpp"
-#include <thread>
-#include <atomic>
+#include "frame_source.hpp"
+#include "headless.hpp"
+#include "incremental_pipeline.hpp"
+#include "adaptive_pipeline.hpp"
+#include "batch_runner.hpp"
+#include "benchmarks.hpp"
+#include "color_lut.hpp"
+#include "mat_allocator.hpp"
+#include "metrics.hpp"
+#include "param_store.hpp"
+#include "pipeline.hpp"
+#include "processing_params.hpp"
+#include "raw_video.hpp"
+#include "recorder.hpp"
+#include "shm_ring.hpp"
+#include "staged_runner.hpp"
+#include "stream_server.hpp"
+#include "thread_pool.hpp"
+#include "tiled_pipeline.hpp"
 #include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <cctype>
 
 
-// g++ -std=c++11 -o my_program main.cpp image_processing.cpp     -I/usr/local/include/opencv4     -L/usr/local/lib     -lopencv_core -lopencv_imgproc -lopencv_highgui -lopencv_imgcodecs -lopencv_videoio
-
-struct ProcessingParams {
-    int kernelSize = 15;
-    int thresholdValue = 128;
-    int cropX = 0, cropY = 0, cropWidth = 100, cropHeight = 100;
-    int resizeWidth = 640, resizeHeight = 480;
-    double rotationAngle = 0;
-    int erosionKernelSize = 3;
-    int dilationKernelSize = 3;
-    int cannyLowerThreshold = 50, cannyUpperThreshold = 150;
-    // cv::Scalar lowerBound = cv::Scalar(0, 0, 0); // Default lower bound for color detection
-    // cv::Scalar upperBound = cv::Scalar(255, 255, 255); // Default upper bound for color detection
-    int lowerBound[3] = {0, 0, 0}; // Lower bound for color detection as int array
-    int upperBound[3] = {255, 255, 255}; // Upper bound for color detection as int array
-    
-    std::string choice = "BGR";
-};
-
-
-std::atomic<bool> userInputReceived(true);
-
-void checkUserInput() {
-    char userInput;
-    while (true) {
-        if (std::cin >> userInput) {
-            std::cout << "User input: " << userInput << std::endl;
-            // if (key == 27 || key == 'm' || key == 'M'){
-            //     userInputReceived = true;
-            // }
-            userInputReceived = true;
-        }
-    }
-}
-
+// cmake -S . -B build && cmake --build build    (also builds shm_reader, bench_kernels and golden_tests), or:
+// g++ -std=c++11 -pthread -o my_program main.cpp adaptive_pipeline.cpp image_processing.cpp blobs.cpp geometry.cpp blur.cpp convolution.cpp packed_mask.cpp frame_source.cpp headless.cpp incremental_pipeline.cpp batch_runner.cpp mat_allocator.cpp metrics.cpp param_store.cpp pipeline.cpp processing_params.cpp raw_video.cpp recorder.cpp shm_ring.cpp staged_runner.cpp stream_server.cpp color_kernel.cpp color_lut.cpp benchmarks.cpp test_support.cpp thread_pool.cpp tiled_pipeline.cpp     -I/usr/local/include/opencv4     -L/usr/local/lib     -lopencv_core -lopencv_imgproc -lopencv_highgui -lopencv_imgcodecs -lopencv_videoio
 
 void displayMenu() {
     std::cout << "\nSelect an option:" << std::endl;
@@ -56,6 +43,8 @@ void displayMenu() {
     std::cout << "A. Apply Dilation" << std::endl;
     std::cout << "B. Apply Canny Edge Detection" << std::endl;
     std::cout << "C. Detect Color in Image" << std::endl;
+    std::cout << "D. Run a Chain of Operations" << std::endl;
+    std::cout << "E. Detect Blobs in Thresholded Image" << std::endl;
     std::cout << "Press ESC to exit." << std::endl;
 }
 
@@ -68,6 +57,12 @@ void gatherParameters(char choice, ProcessingParams &params) {
                 std::cout << "Invalid kernel size. Using default kernel size of 15." << std::endl;
                 params.kernelSize = 15;
             }
+            std::cout << "Blur engine: exact Gaussian or constant-time box approximation (gaussian/box): ";
+            std::cin >> params.blurEngine;
+            if (params.blurEngine != "gaussian" && params.blurEngine != "box") {
+                std::cout << "Unknown engine. Using gaussian." << std::endl;
+                params.blurEngine = "gaussian";
+            }
             break;
         case '4':
             std::cout << "Enter threshold value (0-255): ";
@@ -89,6 +84,23 @@ void gatherParameters(char choice, ProcessingParams &params) {
             std::cout << "Enter angle for rotation: ";
             std::cin >> params.rotationAngle;
             break;
+        case '8': {
+            std::cout << "Enter kernel rows and columns (odd), then the values row by row (e.g., 3 3 0 -1 0 -1 5 -1 0 -1 0): ";
+            std::string rows, cols;
+            std::cin >> rows >> cols;
+            std::string setting = rows + " " + cols;
+            const long long count = std::atoll(rows.c_str()) * std::atoll(cols.c_str());
+            for (long long i = 0; i < count && count <= maxConvolutionSize * maxConvolutionSize; ++i) {
+                std::string value;
+                std::cin >> value;
+                setting += " " + value;
+            }
+            applyParamSetting("convolutionKernel", setting, params);
+            if (params.convolutionRows != std::atoi(rows.c_str()) || params.convolutionCols != std::atoi(cols.c_str())) {
+                std::cout << "Invalid kernel. Keeping the current " << params.convolutionRows << "x" << params.convolutionCols << " kernel." << std::endl;
+            }
+            break;
+        }
         case '9':
             std::cout << "Enter kernel size for erosion (odd number > 0): ";
             std::cin >> params.erosionKernelSize;
@@ -109,20 +121,55 @@ void gatherParameters(char choice, ProcessingParams &params) {
             std::cout << "Enter lower and upper thresholds for Canny (e.g., 50 150): ";
             std::cin >> params.cannyLowerThreshold >> params.cannyUpperThreshold;
             break;
-        case 'C':
+        case 'C': {
             std::cout << "Enter lower (R G B) and upper (R G B) color bounds (e.g., 0 0 0 255 255 255): ";
             std::cin >> params.lowerBound[0] >> params.lowerBound[1] >> params.lowerBound[2]
                      >> params.upperBound[0] >> params.upperBound[1] >> params.upperBound[2];
             std::cout << "Choose a color format: (HSV/BGR) ";
-            std::cin >> params.choice;
+            std::string format;
+            std::cin >> format;
+            applyParamSetting("colorSpace", format, params); // Keeps the current format if this one is unknown
             break;
+        }
+        case 'E':
+            std::cout << "Enter threshold value (0-255) and minimum blob area in pixels (e.g., 128 20): ";
+            std::cin >> params.thresholdValue >> params.blobMinArea;
+            if (params.thresholdValue < 0 || params.thresholdValue > 255) {
+                std::cout << "Invalid value. Using default threshold of 128." << std::endl;
+                params.thresholdValue = 128;
+            }
+            break;
+        case 'D': {
+            std::cout << "Enter the operations to chain, in order (e.g., 3C9AB): ";
+            std::string chain;
+            std::cin >> chain;
+            applyParamSetting("pipeline", chain, params);
+            // Ask for the parameters of every operation in the chain
+            for (size_t i = 0; i < params.pipeline.size(); ++i) {
+                if (params.pipeline[i] != 'D') gatherParameters(params.pipeline[i], params);
+            }
+            break;
+        }
         default:
             break;
     }
 }
 
-void onTrackbarChange(int, void* userdata) {
-    // Callback function does nothing; it’s here to satisfy OpenCV’s API
+// Positions of the color detection trackbars. The trackbars write here, on the display
+// thread; the processing thread only ever sees the bounds through the store.
+struct ColorTrackbars {
+    ParamStore *store = nullptr;
+    int lowerBound[3] = {0, 0, 0};
+    int upperBound[3] = {255, 255, 255};
+};
+
+// Publish the bounds after a trackbar moved
+void onColorTrackbarChange(int, void* userdata) {
+    const ColorTrackbars &bars = *static_cast<const ColorTrackbars*>(userdata);
+    bars.store->update([&bars](ProcessingParams &params) {
+        std::copy(bars.lowerBound, bars.lowerBound + 3, params.lowerBound);
+        std::copy(bars.upperBound, bars.upperBound + 3, params.upperBound);
+    });
 }
 
 
@@ -136,59 +183,599 @@ void printScalar(const cv::Scalar &scalar, const std::string &name) {
     std::cout << "]" << std::endl;
 }
 
+// Create the color detection window and its trackbars; done once per mode, not per frame.
+// 'bars' must outlive the window.
+void createColorTrackbars(ParamStore &store, ColorTrackbars &bars) {
+    const std::shared_ptr<const ProcessingParams> params = store.snapshot();
+    bars.store = &store;
+    std::copy(params->lowerBound, params->lowerBound + 3, bars.lowerBound);
+    std::copy(params->upperBound, params->upperBound + 3, bars.upperBound);
+
+    const std::string windowName = "Color Detection";
+    const std::string &choice = params->choice;
+    cv::namedWindow(windowName, cv::WINDOW_AUTOSIZE);
+    cv::createTrackbar("Lower " + std::string(1, choice[0]), windowName, &bars.lowerBound[0], 179, onColorTrackbarChange, &bars);
+    cv::createTrackbar("Lower " + std::string(1, choice[1]), windowName, &bars.lowerBound[1], 255, onColorTrackbarChange, &bars);
+    cv::createTrackbar("Lower " + std::string(1, choice[2]), windowName, &bars.lowerBound[2], 255, onColorTrackbarChange, &bars);
+    cv::createTrackbar("Upper " + std::string(1, choice[0]), windowName, &bars.upperBound[0], 179, onColorTrackbarChange, &bars);
+    cv::createTrackbar("Upper " + std::string(1, choice[1]), windowName, &bars.upperBound[1], 255, onColorTrackbarChange, &bars);
+    cv::createTrackbar("Upper " + std::string(1, choice[2]), windowName, &bars.upperBound[2], 255, onColorTrackbarChange, &bars);
+}
+
+// Re-read the config file into the store; the processing thread picks it up with its next frame
+void reloadParams(const std::string &path, ParamStore &store) {
+    ProcessingParams params = *store.snapshot();
+    if (loadParamsFile(path, params)) {
+        store.publish(params);
+        std::cout << "Reloaded " << path << std::endl;
+    }
+}
+
+// Serial reference path: process and display one frame on the calling thread
 void handleUserChoice(char userChoice,  ProcessingParams &params, const cv::Mat &frame) {
 
     switch (userChoice) {
         case '1': showGrayscale(frame); break;
         case '2': showHSV(frame); break;
-        case '3': showBlurred(frame, params.kernelSize); break;
+        case '3': showBlurred(frame, params.kernelSize, params.blurEngine); break;
         case '4': showThresholded(frame, params.thresholdValue); break;
         case '5': showCropped(frame, params.cropX, params.cropY, params.cropWidth, params.cropHeight); break;
         case '6': showResized(frame, params.resizeWidth, params.resizeHeight); break;
         case '7': showRotated(frame, params.rotationAngle); break;
+        case '8': applyConvolution(frame, convolutionKernelOf(params)); break;
         case '9': applyErosion(frame, params.erosionKernelSize); break;
         case 'A': applyDilation(frame, params.dilationKernelSize); break;
         case 'B': applyCanny(frame, params.cannyLowerThreshold, params.cannyUpperThreshold); break;
         case 'C': {
-            // Create trackbars
-            // Create a window for color detection
-            const std::string windowName = "Color Detection";
-            cv::namedWindow(windowName, cv::WINDOW_AUTOSIZE);
-            // Pair to hold references to bounds
-            std::string lowerLabel = "Lower " + std::string(1, params.choice[0]);
-            std::cout << lowerLabel << std::endl;
-            std::cout << params.choice[0] << std::endl;
-
-            cv::createTrackbar("Lower " + std::string(1, params.choice[0]), windowName, &params.lowerBound[0], 179, onTrackbarChange);
-            cv::createTrackbar("Lower " + std::string(1, params.choice[1]), windowName, &params.lowerBound[1], 255, onTrackbarChange);
-            cv::createTrackbar("Lower " + std::string(1, params.choice[2]), windowName, &params.lowerBound[2], 255, onTrackbarChange);
-            cv::createTrackbar("Upper " + std::string(1, params.choice[0]), windowName, &params.upperBound[0], 179, onTrackbarChange);
-            cv::createTrackbar("Upper " + std::string(1, params.choice[1]), windowName, &params.upperBound[1], 255, onTrackbarChange);
-            cv::createTrackbar("Upper " + std::string(1, params.choice[2]), windowName, &params.upperBound[2], 255, onTrackbarChange);
-
-
-            std::cout << params.lowerBound[0] << std::endl;
-
-            detectColor(frame, params.choice, params.lowerBound, params.upperBound); 
+            detectColor(frame, params.choice, params.lowerBound, params.upperBound, params.colorEngine);
             // printScalar(params.lowerBound, "Lower Bound");
             // printScalar(params.upperBound, "Upper Bound");
             break;
         }
+        case 'E': showBlobs(frame, params.thresholdValue, blobOptionsOf(params)); break;
+        case 'D': {
+            static Pipeline pipeline;
+            if (pipeline.choices() != params.pipeline) {
+                if (!pipeline.configure(params.pipeline)) break;
+                std::cout << "Pipeline: " << pipeline.describe() << std::endl;
+            }
+            const cv::Mat &output = pipeline.run(frame, params);
+            if (isDisplayEnabled()) cv::imshow("Pipeline Output", output);
+            break;
+        }
         default: std::cout << "Invalid choice!" << std::endl; break;
     
     }
 }
 
 
-int main() {
-    cv::VideoCapture cap(0); // Open the default camera (0)
-    if (!cap.isOpened()) {
-        std::cerr << "Error: Could not open the camera!" << std::endl;
-        return -1;
+// Options that can be given on the command line
+struct CommandLineOptions {
+    std::string sourceSpec = "camera:0";  // See createFrameSource() for the accepted forms
+    bool headless = false;                // Run without menu or windows and print timing
+    int frames = 300;                     // Measured frames per operation in headless mode
+    int warmupFrames = 10;                // Unmeasured frames before each headless run
+    std::string operations = "all";       // Menu choices to run headless, e.g. "3BC" or "all"
+    std::string configPath;               // Optional parameter file, see loadParamsFile()
+    bool staged = false;                  // Headless: run through the threaded capture/process/display stages
+    bool pace = false;                    // Headless staged: release frames at the source frame rate
+    size_t queueDepth = 2;                // Depth of each ring between stages
+    std::string queuePolicy = "auto";     // drop | block | auto (drop for cameras and streams, block otherwise)
+    std::string benchmark;                // Kernel benchmark to run instead of the menu, see benchmarks.hpp
+    int threads = -1;                     // Tile engine threads: -1 = off (whole-frame operations), 0 = one per hardware thread
+    bool incremental = false;             // Reprocess only the tiles that changed since the previous frame
+    double budgetMs = 0;                  // Per-frame processing budget; > 0 lowers the resolution to keep within it
+    std::string streamsPath;              // Stream list for multi-stream mode, see loadStreamList()
+    std::string shmName;                  // Publish processed frames to this shared-memory ring, see shm_ring.hpp
+    int shmSlots = 4;                     // Frames the ring holds
+    std::string recordPath;               // Record processed frames to this file on a writer thread, see recorder.hpp
+    std::string recordCodec = "MJPG";     // FOURCC of encoded recordings (.avi .mp4 .mkv .mov)
+    size_t recordQueue = 8;               // Frames waiting for the recording thread
+    std::string recordPolicy = "auto";    // drop-oldest | drop-newest | block | auto (drop-oldest for cameras and streams, block otherwise)
+    double segmentMb = 0;                 // Start a new recording file after this many MB, 0 = never
+    double segmentSeconds = 0;            // ... or after this many seconds, 0 = never
+    std::string batchInput;               // Directory or glob of images to process in batch mode, see batch_runner.hpp
+    std::string outputDir = "batch_out";  // Where batch mode writes its results
+    std::string outputExtension;          // Batch output format, e.g. ".png" (default: same as each input)
+    bool resume = true;                   // Batch: skip images a previous run into the same directory finished
+    std::string metricsPath;              // Append the metrics to this file as JSON lines, see metrics.hpp
+    int metricsPort = 0;                  // Serve the metrics as Prometheus text on 127.0.0.1:port, 0 = off
+    double metricsInterval = 1;           // Seconds between JSON lines
+    bool pool = true;                     // Recycle cv::Mat buffers through the pooled allocator, see mat_allocator.hpp
+    bool assertNoAlloc = false;           // Headless: abort on a heap allocation after warm-up
+};
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [--source SPEC] [--config FILE] [--headless] [--frames N] [--warmup N] [--op CHOICES]"
+              << " [--staged] [--pace] [--queue-depth N] [--queue-policy drop|block|auto] [--threads N] [--incremental] [--budget MS] [--streams FILE] [--shm NAME] [--shm-slots N]"
+              << " [--record FILE] [--record-codec FOURCC] [--record-queue N] [--record-policy drop-oldest|drop-newest|block|auto] [--segment-mb N] [--segment-seconds S]"
+              << " [--batch DIR|GLOB] [--out DIR] [--ext .EXT] [--no-resume] [--metrics-file FILE] [--metrics-port N] [--metrics-interval S] [--no-pool] [--assert-no-alloc]"
+              << " [--bench NAME]" << std::endl;
+    std::cout << "  --source SPEC   camera:<index> | video:<path> | images:<glob>[@fps] | raw:<file> | synthetic:<W>x<H>[@fps]" << std::endl;
+    std::cout << "  --config FILE   load parameters and the option D chain from a key = value file" << std::endl;
+    std::cout << "  --headless      process without display and report fps and p50/p99 latency" << std::endl;
+    std::cout << "  --frames N      measured frames per operation (default 300)" << std::endl;
+    std::cout << "  --warmup N      unmeasured warm-up frames per operation (default 10)" << std::endl;
+    std::cout << "  --op CHOICES    menu choices to run headless, e.g. 3BC (default all)" << std::endl;
+    std::cout << "  --staged        headless: run capture, processing and display as separate threads" << std::endl;
+    std::cout << "  --pace          headless staged: deliver frames at the source frame rate like a live camera" << std::endl;
+    std::cout << "  --queue-depth N frames buffered between stages (default 2)" << std::endl;
+    std::cout << "  --queue-policy drop|block|auto   what capture does when processing falls behind" << std::endl;
+    std::cout << "  --threads N     run operations strip by strip on N threads (0 = one per hardware thread)" << std::endl;
+    std::cout << "  --incremental   reprocess only the tiles that changed since the previous frame (instead of --threads)" << std::endl;
+    std::cout << "  --budget MS     keep processing within MS per frame by lowering resolution instead of dropping frames" << std::endl;
+    std::cout << "  --streams FILE  headless: process every stream of a list on one shared pool (--threads sets its size)" << std::endl;
+    std::cout << "  --shm NAME      publish processed frames to a shared-memory ring for other processes (see shm_reader)" << std::endl;
+    std::cout << "  --shm-slots N   frames the shared-memory ring holds (default 4)" << std::endl;
+    std::cout << "  --record FILE   record processed frames on a separate thread: FILE.avi/.mp4/.mkv/.mov encoded, FILE.y4m, or raw with a FILE.desc descriptor" << std::endl;
+    std::cout << "  --record-codec FOURCC  codec of encoded recordings (default MJPG)" << std::endl;
+    std::cout << "  --record-queue N       frames buffered for the recording thread (default 8)" << std::endl;
+    std::cout << "  --record-policy drop-oldest|drop-newest|block|auto   what happens to frames when the recording falls behind" << std::endl;
+    std::cout << "  --segment-mb N         start a new recording file every N MB" << std::endl;
+    std::cout << "  --segment-seconds S    start a new recording file every S seconds" << std::endl;
+    std::cout << "  --batch DIR|GLOB  process every image with --op (a choice or chain), decoding, processing and encoding in parallel" << std::endl;
+    std::cout << "  --out DIR       batch output directory (default batch_out)" << std::endl;
+    std::cout << "  --ext .EXT      batch output format, e.g. .png (default: same as the input)" << std::endl;
+    std::cout << "  --no-resume     batch: redo images a previous run already finished" << std::endl;
+    std::cout << "  --metrics-file FILE  append per-stage latency percentiles, counters and queue depths as JSON lines" << std::endl;
+    std::cout << "  --metrics-port N     serve the metrics as Prometheus text at http://127.0.0.1:N/metrics" << std::endl;
+    std::cout << "  --metrics-interval S seconds between JSON lines (default 1)" << std::endl;
+    std::cout << "  --no-pool       allocate every cv::Mat buffer from the heap instead of recycling them" << std::endl;
+    std::cout << "  --assert-no-alloc  headless: abort if a cv::Mat buffer comes from the heap after warm-up" << std::endl;
+    std::cout << "  --bench NAME    time a kernel against its reference: " << benchmarkNames() << " | all" << std::endl;
+}
+
+// Parse argv into 'options'; returns false if the program should exit
+bool parseCommandLine(int argc, char** argv, CommandLineOptions &options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--source" && hasValue) {
+            options.sourceSpec = argv[++i];
+        } else if (arg == "--config" && hasValue) {
+            options.configPath = argv[++i];
+        } else if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg == "--frames" && hasValue) {
+            options.frames = std::atoi(argv[++i]);
+        } else if (arg == "--warmup" && hasValue) {
+            options.warmupFrames = std::atoi(argv[++i]);
+        } else if (arg == "--op" && hasValue) {
+            options.operations = argv[++i];
+        } else if (arg == "--staged") {
+            options.staged = true;
+        } else if (arg == "--pace") {
+            options.pace = true;
+        } else if (arg == "--queue-depth" && hasValue) {
+            options.queueDepth = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--queue-policy" && hasValue) {
+            options.queuePolicy = argv[++i];
+        } else if (arg == "--threads" && hasValue) {
+            options.threads = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--incremental") {
+            options.incremental = true;
+        } else if (arg == "--budget" && hasValue) {
+            options.budgetMs = std::max(0.0, std::atof(argv[++i]));
+        } else if (arg == "--streams" && hasValue) {
+            options.streamsPath = argv[++i];
+        } else if (arg == "--shm" && hasValue) {
+            options.shmName = argv[++i];
+        } else if (arg == "--shm-slots" && hasValue) {
+            options.shmSlots = std::max(2, std::atoi(argv[++i]));
+        } else if (arg == "--record" && hasValue) {
+            options.recordPath = argv[++i];
+        } else if (arg == "--record-codec" && hasValue) {
+            options.recordCodec = argv[++i];
+        } else if (arg == "--record-queue" && hasValue) {
+            options.recordQueue = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--record-policy" && hasValue) {
+            options.recordPolicy = argv[++i];
+        } else if (arg == "--segment-mb" && hasValue) {
+            options.segmentMb = std::max(0.0, std::atof(argv[++i]));
+        } else if (arg == "--segment-seconds" && hasValue) {
+            options.segmentSeconds = std::max(0.0, std::atof(argv[++i]));
+        } else if (arg == "--batch" && hasValue) {
+            options.batchInput = argv[++i];
+        } else if (arg == "--out" && hasValue) {
+            options.outputDir = argv[++i];
+        } else if (arg == "--ext" && hasValue) {
+            options.outputExtension = argv[++i];
+        } else if (arg == "--no-resume") {
+            options.resume = false;
+        } else if (arg == "--metrics-file" && hasValue) {
+            options.metricsPath = argv[++i];
+        } else if (arg == "--metrics-port" && hasValue) {
+            options.metricsPort = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--metrics-interval" && hasValue) {
+            options.metricsInterval = std::atof(argv[++i]);
+        } else if (arg == "--no-pool") {
+            options.pool = false;
+        } else if (arg == "--assert-no-alloc") {
+            options.assertNoAlloc = true;
+        } else if (arg == "--bench" && hasValue) {
+            options.benchmark = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Window that shows the result of a menu choice
+std::string resultWindowName(char userChoice) {
+    switch (userChoice) {
+        case '1': return "Grayscale Image";
+        case '2': return "HSV Image";
+        case '3': return "Blurred Image";
+        case '4': return "Thresholded Image";
+        case '5': return "Cropped Image";
+        case '6': return "Resized Image";
+        case '7': return "Rotated Image";
+        case '8': return "Convolution Result";
+        case '9': return "Eroded Image";
+        case 'A': return "Dilated Image";
+        case 'B': return "Canny Edge Detection";
+        case 'C': return "Color Detection";
+        case 'D': return "Pipeline Output";
+        case 'E': return "Blobs";
+        default: return "Result";
+    }
+}
+
+// Where processed frames go besides the display.
+// The shared-memory ring of --shm is created on the first processed frame, with slots that
+// hold that frame or the input frame, whichever is larger; bigger frames are skipped and counted.
+// Recording (--record) happens on its own thread; frames only wait in its queue here.
+struct FrameSink {
+    std::string name;             // Shared-memory ring, empty for none
+    int slots = 4;
+    bool failed = false;
+    ShmFrameWriter writer;
+    AsyncRecorder *recorder = nullptr; // Started for --record; owned by main()
+};
+
+// Publish a processed frame to the ring, tagged with the choice (or option D chain) that produced it,
+// and append it to the recording
+void publishFrame(FrameSink &sink, char userChoice, const ProcessingParams &params, const cv::Mat &frame, const cv::Mat &output) {
+    if (sink.recorder) sink.recorder->submit(output);
+    if (sink.failed || sink.name.empty()) return;
+    if (!sink.writer.isOpen()) {
+        size_t bytes = std::max(frame.total() * frame.elemSize(), output.total() * output.elemSize());
+        if (!sink.writer.create(sink.name, sink.slots, bytes)) {
+            sink.failed = true;
+            return;
+        }
+        std::cout << "Publishing frames to shared memory " << sink.writer.name() << std::endl;
+    }
+    sink.writer.publish(output, userChoice == 'D' ? params.pipeline : std::string(1, userChoice), shmTimestampNow());
+}
+
+// Engines that take over from whole-frame processing, chosen by the command line options.
+// At most one is set: adaptive (--budget), incremental (--incremental) or tiled (--threads).
+struct ProcessingEngines {
+    std::unique_ptr<TiledPipeline> tiled;
+    std::unique_ptr<IncrementalPipeline> incremental;
+    std::unique_ptr<AdaptivePipeline> adaptive;
+};
+
+// Compute-only counterpart of handleUserChoice, safe to run off the UI thread.
+// 'pipeline' must already be configured for option D, and the engine in 'engines' (if any) for the choice.
+// With a sink, the result is also published to its shared-memory ring and recording.
+void processUserChoice(char userChoice, const ProcessingParams &params, const cv::Mat &frame, cv::Mat &output,
+                       ProcessingScratch &scratch, Pipeline &pipeline, ProcessingEngines &engines, FrameSink *sink) {
+    {
+        ScopedTimer timer(operationHistogram(userChoice)); // Processing only, not the publishing below
+        if (engines.adaptive) {
+            engines.adaptive->run(frame, params).copyTo(output);
+        } else if (engines.incremental) {
+            engines.incremental->run(frame, params).copyTo(output);
+        } else if (engines.tiled) {
+            engines.tiled->run(frame, params).copyTo(output);
+        } else if (userChoice == 'D') {
+            pipeline.run(frame, params).copyTo(output); // Copy: the pipeline reuses its buffers next frame
+        } else {
+            applyStage(userChoice, frame, output, params, scratch);
+        }
+    }
+    if (sink) publishFrame(*sink, userChoice, params, frame, output);
+}
+
+void printFrameSinkStats(const FrameSink *sink) {
+    if (!sink) return;
+    if (sink->writer.isOpen()) {
+        std::cout << "shm=" << sink->writer.name() << " published=" << sink->writer.published()
+                  << " oversized=" << sink->writer.oversized() << std::endl;
+    }
+    if (sink->recorder) printRecorderStats(*sink->recorder);
+}
+
+// Write out the frames still queued for recording and print the final counts
+void finishRecording(FrameSink *sink) {
+    if (!sink || !sink->recorder) return;
+    sink->recorder->close();
+    printRecorderStats(*sink->recorder);
+}
+
+// Cameras and streams produce frames whether or not they are consumed; files and generators wait
+bool isLiveSource(const std::string &sourceSpec) {
+    return sourceSpec.compare(0, 6, "camera") == 0 || sourceSpec.find("://") != std::string::npos;
+}
+
+// Recorder for --record: live sources drop frames rather than slow processing down, recorded ones keep every frame
+bool recorderOptionsFor(const CommandLineOptions &options, double fps, RecorderOptions &recorder) {
+    recorder.path = options.recordPath;
+    recorder.codec = options.recordCodec;
+    recorder.fps = fps;
+    recorder.queueDepth = options.recordQueue;
+    recorder.segmentBytes = static_cast<uint64_t>(options.segmentMb * 1e6);
+    recorder.segmentSeconds = options.segmentSeconds;
+    if (options.recordPolicy == "drop-oldest") recorder.policy = RecordPolicy::DropOldest;
+    else if (options.recordPolicy == "drop-newest") recorder.policy = RecordPolicy::DropNewest;
+    else if (options.recordPolicy == "block") recorder.policy = RecordPolicy::Block;
+    else if (options.recordPolicy == "auto") recorder.policy = isLiveSource(options.sourceSpec) ? RecordPolicy::DropOldest : RecordPolicy::Block;
+    else {
+        std::cerr << "Unknown recording policy: " << options.recordPolicy << " (expected drop-oldest, drop-newest, block or auto)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Ring policy for a source: live feeds drop stale frames, recorded ones must not lose any
+StagedOptions stagedOptionsFor(const CommandLineOptions &options) {
+    StagedOptions staged;
+    staged.captureQueueDepth = options.queueDepth;
+    staged.displayQueueDepth = options.queueDepth;
+    bool live = isLiveSource(options.sourceSpec);
+    if (options.queuePolicy == "drop") staged.policy = RingPolicy::DropOldest;
+    else if (options.queuePolicy == "block") staged.policy = RingPolicy::Block;
+    else staged.policy = live ? RingPolicy::DropOldest : RingPolicy::Block;
+    staged.paceToSourceFps = !live; // Files and generators play at their nominal rate on screen
+    return staged;
+}
+
+// Print the strategy the convolution engine picks for the kernel in 'params'
+void describeConvolution(const ProcessingParams &params) {
+    ConvolutionEngine engine;
+    if (engine.setKernel(convolutionKernelOf(params))) std::cout << "Convolution: " << engine.describe() << std::endl;
+}
+
+// Prepare what an option needs before its frames start flowing; returns false if it cannot run.
+// With an engine, the choice (or the option D chain) is configured on it instead.
+bool prepareUserChoice(char userChoice, const ProcessingParams &params, Pipeline &pipeline, ProcessingEngines &engines) {
+    const std::string valid = "123456789ABCDE";
+    if (valid.find(userChoice) == std::string::npos) {
+        std::cout << "Invalid choice!" << std::endl;
+        return false;
+    }
+    const std::string chain = userChoice == 'D' ? params.pipeline : std::string(1, userChoice);
+    const bool wholeFrame = !engines.adaptive && !engines.incremental && !engines.tiled && userChoice != 'D';
+    if (chain.find('8') != std::string::npos && !wholeFrame) describeConvolution(params); // applyConvolution logs its own
+    if (engines.adaptive) {
+        if (!engines.adaptive->configure(chain)) return false;
+        std::cout << "Adaptive: " << engines.adaptive->describe() << std::endl;
+    } else if (engines.incremental) {
+        if (!engines.incremental->configure(chain)) return false;
+        std::cout << "Incremental: " << engines.incremental->describe() << std::endl;
+    } else if (engines.tiled) {
+        if (!engines.tiled->configure(chain)) return false;
+        std::cout << "Tiled: " << engines.tiled->describe() << std::endl;
+    } else if (userChoice == 'D') {
+        if (!pipeline.configure(params.pipeline)) return false;
+        std::cout << "Pipeline: " << pipeline.describe() << std::endl;
+    }
+    return true;
+}
+
+// Engine for the command line options; none when operations run whole-frame
+void createProcessingEngines(const CommandLineOptions &options, std::unique_ptr<ThreadPool> &pool, ProcessingEngines &engines) {
+    if (options.budgetMs > 0) {
+        AdaptiveOptions adaptive;
+        adaptive.budgetMs = options.budgetMs;
+        engines.adaptive.reset(new AdaptivePipeline(adaptive, std::cout));
+    } else if (options.incremental) {
+        engines.incremental.reset(new IncrementalPipeline());
+    } else if (options.threads >= 0) {
+        if (!pool) pool.reset(new ThreadPool(options.threads));
+        engines.tiled.reset(new TiledPipeline(*pool));
+    }
+}
+
+void printEngineStats(const std::string &label, const ProcessingEngines &engines) {
+    if (engines.adaptive) printAdaptiveStats(label, *engines.adaptive);
+    if (engines.incremental) printIncrementalStats(label, engines.incremental->stats());
+}
+
+// Run one menu choice on a live feed until ESC or M is pressed in a window.
+// Capture and processing run on their own threads; this thread only displays. Parameter
+// changes (trackbars, R to reload the config file) reach the processing thread through 'store'.
+void runInteractiveChoice(char userChoice, ParamStore &store, FrameSource &source, const CommandLineOptions &options,
+                          std::unique_ptr<ThreadPool> &pool, FrameSink *sink) {
+    Pipeline pipeline;
+    ProcessingEngines engines;
+    createProcessingEngines(options, pool, engines);
+    if (!prepareUserChoice(userChoice, *store.snapshot(), pipeline, engines)) return; // The chain is fixed for the mode
+    ColorTrackbars colorTrackbars;
+    if (userChoice == 'C') createColorTrackbars(store, colorTrackbars);
+
+    ParamReader reader(store); // Processing thread only
+    ProcessingScratch scratch;
+    const std::string windowName = resultWindowName(userChoice);
+    StagedStats stats = runStaged(source, stagedOptionsFor(options),
+        [&](const cv::Mat &frame, cv::Mat &output) {
+            processUserChoice(userChoice, reader.params(), frame, output, scratch, pipeline, engines, sink);
+        },
+        [&](const StagedFrame *frame) {
+            if (frame) {
+                cv::imshow(windowName, frame->output);
+                cv::imshow("Processed Frame", frame->image);
+            }
+            char key = cv::waitKey(1); // Trackbar callbacks run in here
+            if ((key == 'r' || key == 'R') && !options.configPath.empty()) reloadParams(options.configPath, store);
+            return !(key == 27 || key == 'm' || key == 'M'); // Exit or menu
+        });
+    printStagedStats("op=" + std::string(1, userChoice), stats);
+    printEngineStats("op=" + std::string(1, userChoice), engines);
+    if (userChoice == 'C' && store.snapshot()->colorEngine == "lut") printColorLutStats("op=C");
+    printFrameSinkStats(sink);
+}
+
+// Run every requested operation for a fixed number of frames and print its timing
+int runHeadlessMode(const CommandLineOptions &options, ProcessingParams &params, FrameSource &source, FrameSink *sink) {
+    setDisplayEnabled(false);
+    std::unique_ptr<ThreadPool> pool;
+    std::string operations = options.operations == "all" ? "123456789ABCDE" : options.operations;
+
+    for (size_t i = 0; i < operations.size(); ++i) {
+        char userChoice = static_cast<char>(std::toupper(static_cast<unsigned char>(operations[i])));
+        source.rewind(); // Every operation sees the same frames when the source is replayable
+        std::string label = "op=" + std::string(1, userChoice) + " source=" + source.describe();
+        bool colorLut = params.colorEngine == "lut" && (userChoice == 'C' || (userChoice == 'D' && params.pipeline.find('C') != std::string::npos));
+        if (colorLut) waitForColorLut(params.choice, params.lowerBound, params.upperBound); // Measure lookups, not the first build
+
+        if (options.staged || options.threads >= 0 || options.incremental || options.budgetMs > 0 || sink) {
+            Pipeline pipeline;
+            ProcessingEngines engines;
+            createProcessingEngines(options, pool, engines);
+            if (!prepareUserChoice(userChoice, params, pipeline, engines)) continue;
+            if (engines.tiled) label += " threads=" + std::to_string(pool->size());
+            ProcessingScratch scratch;
+            if (!options.staged) {
+                cv::Mat output;
+                HeadlessStats stats = runHeadless(source, options.frames, options.warmupFrames, [&](const cv::Mat &frame) {
+                    processUserChoice(userChoice, params, frame, output, scratch, pipeline, engines, sink);
+                });
+                printHeadlessStats(label, stats);
+                printEngineStats(label, engines);
+                if (colorLut) printColorLutStats(label);
+                printFrameSinkStats(sink);
+                continue;
+            }
+            StagedOptions staged = stagedOptionsFor(options);
+            staged.paceToSourceFps = options.pace;
+            staged.maxFrames = static_cast<uint64_t>(options.warmupFrames + options.frames);
+            StagedStats stats = runStaged(source, staged,
+                [&](const cv::Mat &frame, cv::Mat &output) {
+                    processUserChoice(userChoice, params, frame, output, scratch, pipeline, engines, sink);
+                },
+                [](const StagedFrame *) { return true; });
+            printStagedStats(label, stats);
+            printEngineStats(label, engines);
+            if (colorLut) printColorLutStats(label);
+            printFrameSinkStats(sink);
+            continue;
+        }
+
+        HeadlessStats stats = runHeadless(source, options.frames, options.warmupFrames,
+                                          [&](const cv::Mat &frame) {
+                                              ScopedTimer timer(operationHistogram(userChoice));
+                                              handleUserChoice(userChoice, params, frame);
+                                          });
+        printHeadlessStats(label, stats);
+        if (colorLut) printColorLutStats(label);
+    }
+    return 0;
+}
+
+// Process every stream of the stream list on one shared pool and print the per-stream results
+int runStreamMode(const CommandLineOptions &options, const ProcessingParams &defaults) {
+    setDisplayEnabled(false);
+    std::vector<StreamSpec> streams;
+    if (!loadStreamList(options.streamsPath, defaults, streams)) return -1;
+
+    StreamServerOptions server;
+    server.frames = options.frames;
+    server.warmupFrames = options.warmupFrames;
+    server.pace = options.pace;
+    ThreadPool pool(std::max(options.threads, 0));
+    std::cout << "Serving " << streams.size() << " streams on " << pool.size() << " threads" << std::endl;
+    std::vector<StreamStats> stats = runStreamServer(streams, server, pool);
+    printStreamStats(stats);
+    return stats.size() == streams.size() ? 0 : 1;
+}
+
+// Run the --op choice or chain over a directory of images and print the throughput
+int runBatchMode(const CommandLineOptions &options, const ProcessingParams &params) {
+    setDisplayEnabled(false);
+    BatchOptions batch;
+    batch.input = options.batchInput;
+    batch.outputDir = options.outputDir;
+    batch.extension = options.outputExtension;
+    batch.threads = std::max(options.threads, 0);
+    batch.queueDepth = options.queueDepth > 2 ? options.queueDepth : 0; // The default depth suits the stream rings only
+    batch.resume = options.resume;
+    batch.chain = options.operations == "all" ? params.pipeline : options.operations;
+    for (size_t i = 0; i < batch.chain.size(); ++i) {
+        batch.chain[i] = static_cast<char>(std::toupper(static_cast<unsigned char>(batch.chain[i])));
+    }
+    if (batch.chain == "D") batch.chain = params.pipeline;
+
+    std::cout << "Batch: " << batch.input << " -> " << batch.outputDir << " running " << batch.chain << std::endl;
+    BatchStats stats;
+    if (!runBatch(batch, params, stats)) return -1;
+    printBatchStats(stats);
+    return stats.failed == 0 ? 0 : 1;
+}
+
+
+int main(int argc, char** argv) {
+    CommandLineOptions options;
+    if (!parseCommandLine(argc, argv, options)) return -1;
+    // Before any frame buffer exists, so every cv::Mat is counted (and pooled)
+    if (options.pool) installPooledAllocator();
+    else installCountingAllocator();
+    setFreshAllocationCheck(options.assertNoAlloc);
+    if (!options.benchmark.empty()) {
+        return runBenchmark(options.benchmark, options.frames) ? 0 : 1;
+    }
+    if (!options.metricsPath.empty() || options.metricsPort > 0) {
+        MetricsExportOptions metrics;
+        metrics.jsonPath = options.metricsPath;
+        metrics.port = options.metricsPort;
+        metrics.intervalSeconds = options.metricsInterval;
+        if (!startMetricsExport(metrics)) return -1;
+        std::atexit(stopMetricsExport); // Every mode returns from main; the last line covers the end of the run
     }
 
-    // userInputReceived = true;
     ProcessingParams params;
+    if (!options.configPath.empty() && !loadParamsFile(options.configPath, params)) {
+        return -1;
+    }
+    if (!options.streamsPath.empty()) {
+        return runStreamMode(options, params); // The config file gives every stream's defaults
+    }
+    if (!options.batchInput.empty()) {
+        return runBatchMode(options, params);
+    }
+
+    std::unique_ptr<FrameSource> source = createFrameSource(options.sourceSpec);
+    if (!source) {
+        return -1;
+    }
+    RecorderOptions recorderOptions;
+    if (!options.recordPath.empty() && !recorderOptionsFor(options, source->fps(), recorderOptions)) {
+        return -1;
+    }
+    AsyncRecorder recorder(recorderOptions); // On the stack: its rings are cache-line aligned
+    std::unique_ptr<FrameSink> sink; // Outlives every mode, so readers can stay attached between them
+    if (!options.shmName.empty() || !options.recordPath.empty()) {
+        sink.reset(new FrameSink());
+        sink->name = options.shmName;
+        sink->slots = options.shmSlots;
+        if (!options.recordPath.empty()) {
+            if (!recorder.start()) return -1;
+            sink->recorder = &recorder;
+        }
+    }
+    ParamStore store(params);
+    if (options.headless) {
+        ProcessingParams snapshot = *store.snapshot(); // Versioned, so per-frame parameter checks are one comparison
+        int result = runHeadlessMode(options, snapshot, *source, sink.get());
+        finishRecording(sink.get());
+        return result;
+    }
+
+    std::unique_ptr<ThreadPool> pool; // Created on first use, shared by every choice
     char userChoice;
     while (true) {
         cv::destroyAllWindows();
@@ -199,26 +786,15 @@ int main() {
         if (userChoice == 27) break; // ESC key to exit
 
         // Gather additional parameters if required
-        gatherParameters(userChoice, params);
-        
-        cv::Mat frame;
-        while (true) {
-            cap.read(frame); // Capture a new frame
-            if (frame.empty()) {
-                std::cerr << "Error: Could not read frame!" << std::endl;
-                break;
-            }
-
-            // Process and display the frame
-            handleUserChoice(userChoice, params, frame);
-            cv::imshow("Processed Frame", frame);
+        ProcessingParams edited = *store.snapshot();
+        gatherParameters(userChoice, edited);
+        store.publish(edited);
 
-            char key = cv::waitKey(1);
-            if (key == 27 || key == 'm' || key == 'M') break; // Exit or menu
-        }
+        runInteractiveChoice(userChoice, store, *source, options, pool, sink.get());
     }
 
-    cap.release();
+    source.reset();
+    finishRecording(sink.get());
     cv::destroyAllWindows();
     return 0;
 }
@@ -0,0 +1,293 @@
+#include "mat_allocator.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <vector>
+
+
+static std::atomic<uint64_t> allocationCount(0);
+static std::atomic<uint64_t> deallocationCount(0);
+static std::atomic<uint64_t> bytesAllocated(0);
+static std::atomic<uint64_t> liveBytes(0);
+static std::atomic<uint64_t> peakBytes(0);
+static std::atomic<uint64_t> poolHitCount(0);
+static std::atomic<uint64_t> poolMissCount(0);
+static std::atomic<uint64_t> pooledBytes(0);
+static std::atomic<uint64_t> peakFootprintBytes(0);
+
+static std::atomic<bool> freshCheckEnabled(false);
+static std::atomic<bool> freshCheckArmed(false);
+
+static std::atomic<size_t> maxPooledBytes(MatPoolOptions().maxPooledBytes);
+static std::atomic<int> threadCacheBuffers(MatPoolOptions().threadCacheBuffers);
+
+// Raise 'peak' if 'value' is a new maximum
+static void updatePeak(std::atomic<uint64_t>& peak, uint64_t value) {
+    uint64_t current = peak.load(std::memory_order_relaxed);
+    while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+// Bytes of a buffer for 'sizes' and 'type', filling in 'step' the way OpenCV's StdMatAllocator does
+static size_t bufferBytes(int dims, const int* sizes, int type, void* data0, size_t* step) {
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims - 1; i >= 0; i--) {
+        if (step) {
+            if (data0 && step[i] != CV_AUTOSTEP) {
+                CV_Assert(total <= step[i]);
+                total = step[i];
+            } else {
+                step[i] = total;
+            }
+        }
+        total *= sizes[i];
+    }
+    return total;
+}
+
+// Count a buffer handed out; 'fresh' if it comes from the heap
+static void countAllocation(size_t total, bool fresh) {
+    if (fresh && freshCheckArmed.load(std::memory_order_relaxed)) {
+        std::cerr << "Fresh cv::Mat allocation of " << total << " bytes after warm-up" << std::endl;
+        std::abort();
+    }
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    bytesAllocated.fetch_add(total, std::memory_order_relaxed);
+    const uint64_t live = liveBytes.fetch_add(total, std::memory_order_relaxed) + total;
+    updatePeak(peakBytes, live);
+    updatePeak(peakFootprintBytes, live + pooledBytes.load(std::memory_order_relaxed));
+}
+
+static void countDeallocation(size_t total) {
+    deallocationCount.fetch_add(1, std::memory_order_relaxed);
+    liveBytes.fetch_sub(total, std::memory_order_relaxed);
+}
+
+// Same layout rules as OpenCV's StdMatAllocator, plus counters
+cv::UMatData* CountingMatAllocator::allocate(int dims, const int* sizes, int type, void* data0, size_t* step,
+                                             cv::AccessFlag /*flags*/, cv::UMatUsageFlags /*usageFlags*/) const {
+    const size_t total = bufferBytes(dims, sizes, type, data0, step);
+    uchar* data = data0 ? static_cast<uchar*>(data0) : static_cast<uchar*>(cv::fastMalloc(total));
+    cv::UMatData* u = new cv::UMatData(this);
+    u->data = u->origdata = data;
+    u->size = total;
+    if (data0) {
+        u->flags |= cv::UMatData::USER_ALLOCATED;
+    } else {
+        countAllocation(total, true);
+    }
+    return u;
+}
+
+bool CountingMatAllocator::allocate(cv::UMatData* u, cv::AccessFlag /*accessFlags*/, cv::UMatUsageFlags /*usageFlags*/) const {
+    return u != 0;
+}
+
+void CountingMatAllocator::deallocate(cv::UMatData* u) const {
+    if (!u) return;
+
+    CV_Assert(u->urefcount == 0);
+    CV_Assert(u->refcount == 0);
+    if (!(u->flags & cv::UMatData::USER_ALLOCATED)) {
+        countDeallocation(u->size);
+        cv::fastFree(u->origdata);
+        u->origdata = 0;
+    }
+    delete u;
+}
+
+
+// A pooled buffer and the memory of the UMatData header that goes with it, so a reused
+// buffer costs no heap call at all
+struct PoolEntry {
+    void* header;
+    uchar* data;
+};
+
+static const int sizeClassCount = 4 * 64;
+
+// Size class of a request of 'total' bytes and the capacity of its buffers: 64 bytes for the
+// smallest, then four classes per power of two
+static int sizeClass(size_t total, size_t& capacity) {
+    if (total <= 64) {
+        capacity = 64;
+        return 0;
+    }
+    const int log2 = 63 - __builtin_clzll(static_cast<unsigned long long>(total - 1)); // 2^log2 < total <= 2^(log2 + 1)
+    const size_t base = size_t(1) << log2, quarter = base / 4;
+    const size_t index = (total - base + quarter - 1) / quarter; // 1..4
+    capacity = base + index * quarter;
+    return (log2 - 6) * 4 + static_cast<int>(index);
+}
+
+// Buffers any thread can take
+struct SharedPool {
+    std::mutex lock;
+    std::vector<PoolEntry> free[sizeClassCount];
+};
+
+static SharedPool& sharedPool() {
+    static SharedPool* pool = new SharedPool(); // Never freed: Mats destroyed at exit still return buffers
+    return *pool;
+}
+
+static void freeEntry(const PoolEntry& entry) {
+    cv::fastFree(entry.data);
+    ::operator delete(entry.header);
+}
+
+// Buffers the current thread freed last, taken back without locking
+struct ThreadCache {
+    std::vector<PoolEntry> free[sizeClassCount];
+};
+
+static thread_local ThreadCache* threadCache = nullptr;
+static thread_local bool threadCacheClosed = false; // The thread is exiting: use the shared pool only
+
+// Hands the cache over to the shared pool when its thread exits
+struct ThreadCacheOwner {
+    ~ThreadCacheOwner() {
+        threadCacheClosed = true;
+        if (!threadCache) return;
+        SharedPool& pool = sharedPool();
+        std::lock_guard<std::mutex> guard(pool.lock);
+        for (int c = 0; c < sizeClassCount; c++) {
+            pool.free[c].insert(pool.free[c].end(), threadCache->free[c].begin(), threadCache->free[c].end());
+        }
+        delete threadCache;
+        threadCache = nullptr;
+    }
+};
+
+static ThreadCache* currentThreadCache() {
+    if (!threadCache && !threadCacheClosed) {
+        static thread_local ThreadCacheOwner owner;
+        (void)owner; // Constructed on first use, so its destructor runs at thread exit
+        threadCache = new ThreadCache();
+    }
+    return threadCache;
+}
+
+// A pooled buffer of class 'sizeClass', or false if there is none
+static bool takeEntry(int sizeClass, PoolEntry& entry) {
+    ThreadCache* cache = currentThreadCache();
+    if (cache && !cache->free[sizeClass].empty()) {
+        entry = cache->free[sizeClass].back();
+        cache->free[sizeClass].pop_back();
+        return true;
+    }
+    SharedPool& pool = sharedPool();
+    std::lock_guard<std::mutex> guard(pool.lock);
+    if (pool.free[sizeClass].empty()) return false;
+    entry = pool.free[sizeClass].back();
+    pool.free[sizeClass].pop_back();
+    return true;
+}
+
+// Keep a buffer for reuse, or free it if the pool is full
+static void returnEntry(int sizeClass, size_t capacity, const PoolEntry& entry) {
+    if (pooledBytes.fetch_add(capacity, std::memory_order_relaxed) + capacity > maxPooledBytes.load(std::memory_order_relaxed)) {
+        pooledBytes.fetch_sub(capacity, std::memory_order_relaxed);
+        freeEntry(entry);
+        return;
+    }
+    ThreadCache* cache = currentThreadCache();
+    if (cache && static_cast<int>(cache->free[sizeClass].size()) < threadCacheBuffers.load(std::memory_order_relaxed)) {
+        cache->free[sizeClass].push_back(entry);
+        return;
+    }
+    SharedPool& pool = sharedPool();
+    std::lock_guard<std::mutex> guard(pool.lock);
+    pool.free[sizeClass].push_back(entry);
+}
+
+cv::UMatData* PooledMatAllocator::allocate(int dims, const int* sizes, int type, void* data0, size_t* step,
+                                           cv::AccessFlag /*flags*/, cv::UMatUsageFlags /*usageFlags*/) const {
+    const size_t total = bufferBytes(dims, sizes, type, data0, step);
+    if (data0) {
+        cv::UMatData* u = new cv::UMatData(this);
+        u->data = u->origdata = static_cast<uchar*>(data0);
+        u->size = total;
+        u->flags |= cv::UMatData::USER_ALLOCATED;
+        return u;
+    }
+
+    size_t capacity;
+    const int sizeClassIndex = sizeClass(total, capacity);
+    PoolEntry entry;
+    const bool hit = takeEntry(sizeClassIndex, entry);
+    if (hit) {
+        pooledBytes.fetch_sub(capacity, std::memory_order_relaxed);
+        poolHitCount.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        entry.header = ::operator new(sizeof(cv::UMatData));
+        entry.data = static_cast<uchar*>(cv::fastMalloc(capacity));
+        poolMissCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    countAllocation(total, !hit);
+    cv::UMatData* u = new (entry.header) cv::UMatData(this);
+    u->data = u->origdata = entry.data;
+    u->size = total;
+    return u;
+}
+
+bool PooledMatAllocator::allocate(cv::UMatData* u, cv::AccessFlag /*accessFlags*/, cv::UMatUsageFlags /*usageFlags*/) const {
+    return u != 0;
+}
+
+void PooledMatAllocator::deallocate(cv::UMatData* u) const {
+    if (!u) return;
+
+    CV_Assert(u->urefcount == 0);
+    CV_Assert(u->refcount == 0);
+    if (u->flags & cv::UMatData::USER_ALLOCATED) {
+        delete u;
+        return;
+    }
+    const size_t total = u->size;
+    const PoolEntry entry = {u, u->origdata};
+    countDeallocation(total);
+    u->~UMatData();
+    size_t capacity;
+    const int sizeClassIndex = sizeClass(total, capacity);
+    returnEntry(sizeClassIndex, capacity, entry);
+}
+
+
+void installCountingAllocator() {
+    // Deliberately leaked: static Mats that are destroyed at exit still call back into it
+    static CountingMatAllocator* allocator = new CountingMatAllocator();
+    cv::Mat::setDefaultAllocator(allocator);
+}
+
+void installPooledAllocator(const MatPoolOptions& options) {
+    maxPooledBytes.store(options.maxPooledBytes, std::memory_order_relaxed);
+    threadCacheBuffers.store(options.threadCacheBuffers, std::memory_order_relaxed);
+    static PooledMatAllocator* allocator = new PooledMatAllocator(); // Leaked like the counting one
+    cv::Mat::setDefaultAllocator(allocator);
+}
+
+void setFreshAllocationCheck(bool enabled) {
+    freshCheckEnabled.store(enabled, std::memory_order_relaxed);
+    if (!enabled) freshCheckArmed.store(false, std::memory_order_relaxed);
+}
+
+void armFreshAllocationCheck(bool armed) {
+    freshCheckArmed.store(armed && freshCheckEnabled.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+AllocationStats getAllocationStats() {
+    AllocationStats stats;
+    stats.allocations = allocationCount.load(std::memory_order_relaxed);
+    stats.deallocations = deallocationCount.load(std::memory_order_relaxed);
+    stats.bytesAllocated = bytesAllocated.load(std::memory_order_relaxed);
+    stats.liveBytes = liveBytes.load(std::memory_order_relaxed);
+    stats.peakBytes = peakBytes.load(std::memory_order_relaxed);
+    stats.poolHits = poolHitCount.load(std::memory_order_relaxed);
+    stats.poolMisses = poolMissCount.load(std::memory_order_relaxed);
+    stats.pooledBytes = pooledBytes.load(std::memory_order_relaxed);
+    stats.peakFootprintBytes = peakFootprintBytes.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,65 @@
+#ifndef MAT_ALLOCATOR_HPP
+#define MAT_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+
+// Snapshot of the cv::Mat allocation counters
+struct AllocationStats {
+    uint64_t allocations = 0;     // Pixel buffers handed out
+    uint64_t deallocations = 0;   // Pixel buffers returned
+    uint64_t bytesAllocated = 0;  // Total bytes ever handed out
+    uint64_t liveBytes = 0;       // Bytes currently in use
+    uint64_t peakBytes = 0;       // High-water mark of liveBytes
+    uint64_t poolHits = 0;        // Buffers handed out from the pool (pooled allocator only)
+    uint64_t poolMisses = 0;      // Buffers the pooled allocator had to take from the heap
+    uint64_t pooledBytes = 0;     // Bytes returned to the pool and waiting for reuse
+    uint64_t peakFootprintBytes = 0; // High-water mark of liveBytes + pooledBytes
+};
+
+// cv::MatAllocator that behaves like OpenCV's default allocator but counts every buffer
+class CountingMatAllocator : public cv::MatAllocator {
+public:
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const CV_OVERRIDE;
+    bool allocate(cv::UMatData* data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const CV_OVERRIDE;
+    void deallocate(cv::UMatData* data) const CV_OVERRIDE;
+};
+
+// Counting allocator that keeps returned buffers for reuse instead of freeing them.
+// Buffers are grouped in size classes, four per power of two, so a buffer fits every request
+// of its class and wastes at most a quarter of its size. Each thread keeps a few buffers of
+// every class it recently freed and takes from them without locking; the rest go to a pool
+// shared by all threads, where a capture thread finds the buffers a processing thread freed.
+// Once the frame sizes of a run have been seen, cv::Mat temporaries stop reaching the heap.
+class PooledMatAllocator : public cv::MatAllocator {
+public:
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const CV_OVERRIDE;
+    bool allocate(cv::UMatData* data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const CV_OVERRIDE;
+    void deallocate(cv::UMatData* data) const CV_OVERRIDE;
+};
+
+struct MatPoolOptions {
+    size_t maxPooledBytes = size_t(256) << 20; // Buffers beyond this many idle bytes are freed
+    int threadCacheBuffers = 2;                // Buffers per size class a thread keeps for itself
+};
+
+// Make the counting allocator the default for every cv::Mat created afterwards
+void installCountingAllocator();
+
+// Make the pooled allocator the default for every cv::Mat created afterwards.
+// Buffers already allocated keep going back to the allocator that made them.
+void installPooledAllocator(const MatPoolOptions& options = MatPoolOptions());
+
+// With 'enabled', a buffer taken from the heap while the check is armed is reported with its
+// size and aborts the program, so a debugger shows who allocated. runHeadless() arms the check
+// after warm-up and disarms it at the end of the run.
+void setFreshAllocationCheck(bool enabled);
+void armFreshAllocationCheck(bool armed);
+
+// Current counters (zero if the counting allocator was never installed)
+AllocationStats getAllocationStats();
+
+#endif // MAT_ALLOCATOR_HPP
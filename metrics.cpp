@@ -0,0 +1,412 @@
+#include "metrics.hpp"
+#include "mat_allocator.hpp"
+#include <algorithm>
+#include <iostream>
+
+#ifndef DISABLE_METRICS
+#include <arpa/inet.h>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <poll.h>
+#include <set>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#endif
+
+
+std::string metricName(const std::string& base, const std::string& label, const std::string& value) {
+    std::string escaped;
+    for (size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '"' || value[i] == '\\') escaped += '\\';
+        escaped += value[i] == '\n' ? ' ' : value[i];
+    }
+    const std::string pair = label + "=\"" + escaped + "\"";
+    if (!base.empty() && base[base.size() - 1] == '}') return base.substr(0, base.size() - 1) + "," + pair + "}";
+    return base + "{" + pair + "}";
+}
+
+#ifndef DISABLE_METRICS
+
+// ---------------------------------------------------------------------------
+// Histogram
+// ---------------------------------------------------------------------------
+
+LatencyHistogram::LatencyHistogram() : sumNs(0) {
+    for (int i = 0; i < bucketCount; ++i) buckets[i].store(0, std::memory_order_relaxed);
+}
+
+static int highestBit(uint64_t value) {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    while (value >>= 1) bit++;
+    return bit;
+#endif
+}
+
+// Values below 32 ns get a bucket each; from there, [2^e, 2^(e+1)) is split into 32 buckets
+int LatencyHistogram::bucketOf(uint64_t nanoseconds) {
+    if (nanoseconds < static_cast<uint64_t>(subBuckets)) return static_cast<int>(nanoseconds);
+    int exponent = highestBit(nanoseconds);
+    if (exponent > maxExponent) return bucketCount - 1;
+    const int sub = static_cast<int>(nanoseconds >> (exponent - subBucketBits)) - subBuckets;
+    return (exponent - subBucketBits + 1) * subBuckets + sub;
+}
+
+uint64_t LatencyHistogram::bucketLowest(int bucket) {
+    if (bucket < subBuckets) return static_cast<uint64_t>(bucket);
+    const int exponent = bucket / subBuckets + subBucketBits - 1;
+    return static_cast<uint64_t>(subBuckets + bucket % subBuckets) << (exponent - subBucketBits);
+}
+
+uint64_t LatencyHistogram::bucketWidth(int bucket) {
+    if (bucket < subBuckets) return 1;
+    return static_cast<uint64_t>(1) << (bucket / subBuckets - 1);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot result;
+    result.buckets.resize(bucketCount);
+    for (int i = 0; i < bucketCount; ++i) {
+        result.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+        result.count += result.buckets[i];
+    }
+    result.sumNs = sumNs.load(std::memory_order_relaxed);
+    return result;
+}
+
+double LatencyHistogram::Snapshot::percentileNs(double pct) const {
+    if (count == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(pct / 100.0 * count + 0.999999);
+    rank = std::max<uint64_t>(1, std::min(rank, count));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) return bucketLowest(static_cast<int>(i)) + (bucketWidth(static_cast<int>(i)) - 1) / 2.0;
+    }
+    return 0;
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::Snapshot::since(const Snapshot& earlier) const {
+    Snapshot result = *this;
+    if (earlier.buckets.size() != buckets.size()) return result;
+    result.count = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        // A writer may have bumped a bucket before the earlier snapshot read the sum; never go negative
+        result.buckets[i] = buckets[i] >= earlier.buckets[i] ? buckets[i] - earlier.buckets[i] : 0;
+        result.count += result.buckets[i];
+    }
+    result.sumNs = sumNs >= earlier.sumNs ? sumNs - earlier.sumNs : 0;
+    return result;
+}
+
+
+// ---------------------------------------------------------------------------
+// Registry
+// ---------------------------------------------------------------------------
+
+struct MetricsRegistry {
+    std::mutex lock;
+    std::map<std::string, std::unique_ptr<LatencyHistogram> > histograms;
+    std::map<std::string, std::unique_ptr<MetricCounter> > counters;
+    std::map<std::string, std::unique_ptr<MetricGauge> > gauges;
+};
+
+// Never destroyed: metrics may be recorded and exported while static objects are torn down
+static MetricsRegistry& registry() {
+    static MetricsRegistry* metrics = new MetricsRegistry();
+    return *metrics;
+}
+
+template <typename Metric>
+static Metric* findOrCreate(std::map<std::string, std::unique_ptr<Metric> >& metrics, const std::string& name) {
+    std::lock_guard<std::mutex> guard(registry().lock);
+    std::unique_ptr<Metric>& metric = metrics[name];
+    if (!metric) metric.reset(new Metric());
+    return metric.get();
+}
+
+LatencyHistogram* metricsHistogram(const std::string& name) { return findOrCreate(registry().histograms, name); }
+MetricCounter* metricsCounter(const std::string& name) { return findOrCreate(registry().counters, name); }
+MetricGauge* metricsGauge(const std::string& name) { return findOrCreate(registry().gauges, name); }
+
+LatencyHistogram* operationHistogram(char choice) {
+    static std::atomic<LatencyHistogram*> byChoice[128];
+    const int index = static_cast<unsigned char>(choice) & 127;
+    LatencyHistogram* histogram = byChoice[index].load(std::memory_order_acquire);
+    if (!histogram) {
+        // Two threads may both get here; the registry hands them the same histogram
+        histogram = metricsHistogram(metricName("frame_latency_seconds", "op", std::string(1, choice)));
+        byChoice[index].store(histogram, std::memory_order_release);
+    }
+    return histogram;
+}
+
+
+// ---------------------------------------------------------------------------
+// Formatting
+// ---------------------------------------------------------------------------
+
+struct MetricValues {
+    std::map<std::string, LatencyHistogram::Snapshot> histograms;
+    std::map<std::string, uint64_t> counters;
+    std::map<std::string, int64_t> gauges;
+};
+
+static MetricValues readMetrics() {
+    MetricValues values;
+    MetricsRegistry& metrics = registry();
+    {
+        std::lock_guard<std::mutex> guard(metrics.lock);
+        for (const auto& entry : metrics.histograms) values.histograms[entry.first] = entry.second->snapshot();
+        for (const auto& entry : metrics.counters) values.counters[entry.first] = entry.second->value();
+        for (const auto& entry : metrics.gauges) values.gauges[entry.first] = entry.second->value();
+    }
+    const AllocationStats allocations = getAllocationStats();
+    values.counters["mat_allocations_total"] = allocations.allocations;
+    values.counters["mat_allocated_bytes_total"] = allocations.bytesAllocated;
+    values.gauges["mat_live_bytes"] = static_cast<int64_t>(allocations.liveBytes);
+    values.gauges["mat_peak_bytes"] = static_cast<int64_t>(allocations.peakBytes);
+    values.counters["mat_pool_hits_total"] = allocations.poolHits;
+    values.counters["mat_pool_misses_total"] = allocations.poolMisses;
+    values.gauges["mat_pooled_bytes"] = static_cast<int64_t>(allocations.pooledBytes);
+    values.gauges["mat_peak_footprint_bytes"] = static_cast<int64_t>(allocations.peakFootprintBytes);
+    return values;
+}
+
+// "base{a="1"}" -> "base" and "a="1""
+static void splitName(const std::string& name, std::string& base, std::string& labels) {
+    const size_t brace = name.find('{');
+    base = name.substr(0, brace);
+    labels = brace == std::string::npos ? "" : name.substr(brace + 1, name.size() - brace - 2);
+}
+
+static std::string withLabels(const std::string& base, const std::string& labels, const std::string& extra = "") {
+    if (labels.empty() && extra.empty()) return base;
+    return base + "{" + labels + (labels.empty() || extra.empty() ? "" : ",") + extra + "}";
+}
+
+static std::string number(double value) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.9g", value);
+    return text;
+}
+
+static void appendType(std::string& text, std::set<std::string>& typed, const std::string& base, const char* type) {
+    if (typed.insert(base).second) text += "# TYPE " + base + " " + type + "\n";
+}
+
+std::string metricsPrometheusText() {
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    const MetricValues values = readMetrics();
+    std::string text, base, labels;
+    std::set<std::string> typed;
+    for (const auto& entry : values.histograms) {
+        splitName(entry.first, base, labels);
+        appendType(text, typed, base, "summary");
+        for (double quantile : quantiles) {
+            text += withLabels(base, labels, "quantile=\"" + number(quantile) + "\"") + " " +
+                    number(entry.second.percentileNs(quantile * 100) / 1e9) + "\n";
+        }
+        text += withLabels(base + "_sum", labels) + " " + number(entry.second.sumNs / 1e9) + "\n";
+        text += withLabels(base + "_count", labels) + " " + std::to_string(entry.second.count) + "\n";
+    }
+    for (const auto& entry : values.counters) {
+        splitName(entry.first, base, labels);
+        appendType(text, typed, base, "counter");
+        text += entry.first + " " + std::to_string(entry.second) + "\n";
+    }
+    for (const auto& entry : values.gauges) {
+        splitName(entry.first, base, labels);
+        appendType(text, typed, base, "gauge");
+        text += entry.first + " " + std::to_string(entry.second) + "\n";
+    }
+    return text;
+}
+
+static std::string jsonString(const std::string& value) {
+    std::string text = "\"";
+    for (size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '"' || value[i] == '\\') text += '\\';
+        text += value[i];
+    }
+    return text + "\"";
+}
+
+// One line: wall-clock time, then per histogram the total count and the percentiles of the
+// values recorded since 'previous' (updated), then every counter and gauge
+static std::string metricsJsonLine(std::map<std::string, LatencyHistogram::Snapshot>& previous) {
+    const MetricValues values = readMetrics();
+    const double now = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+    char time[32];
+    std::snprintf(time, sizeof(time), "%.3f", now);
+    std::string line = std::string("{\"time\":") + time + ",\"histograms\":{";
+    bool first = true;
+    for (const auto& entry : values.histograms) {
+        const LatencyHistogram::Snapshot window = entry.second.since(previous[entry.first]);
+        previous[entry.first] = entry.second;
+        line += (first ? "" : ",") + jsonString(entry.first) + ":{\"count\":" + std::to_string(entry.second.count) +
+                ",\"interval_count\":" + std::to_string(window.count) +
+                ",\"mean_ms\":" + number(window.count ? window.sumNs / 1e6 / window.count : 0) +
+                ",\"p50_ms\":" + number(window.percentileNs(50) / 1e6) + ",\"p90_ms\":" + number(window.percentileNs(90) / 1e6) +
+                ",\"p99_ms\":" + number(window.percentileNs(99) / 1e6) + ",\"max_ms\":" + number(window.percentileNs(100) / 1e6) + "}";
+        first = false;
+    }
+    line += "},\"counters\":{";
+    first = true;
+    for (const auto& entry : values.counters) {
+        line += (first ? "" : ",") + jsonString(entry.first) + ":" + std::to_string(entry.second);
+        first = false;
+    }
+    line += "},\"gauges\":{";
+    first = true;
+    for (const auto& entry : values.gauges) {
+        line += (first ? "" : ",") + jsonString(entry.first) + ":" + std::to_string(entry.second);
+        first = false;
+    }
+    return line + "}}";
+}
+
+
+// ---------------------------------------------------------------------------
+// Export thread
+// ---------------------------------------------------------------------------
+
+struct MetricsExporter {
+    MetricsExportOptions options;
+    std::ofstream json;
+    int listenFd = -1;
+    std::atomic<bool> stopping;
+    std::thread thread;
+    std::map<std::string, LatencyHistogram::Snapshot> previous; // For the JSON intervals
+    MetricsExporter() : stopping(false) {}
+};
+
+static MetricsExporter* exporter = nullptr;
+
+static void writeJsonLine(MetricsExporter& state) {
+    if (state.json.is_open()) state.json << metricsJsonLine(state.previous) << std::endl;
+}
+
+static void sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return;
+        sent += static_cast<size_t>(n);
+    }
+}
+
+// Answer one HTTP request: GET /metrics (or /) with the Prometheus text, anything else with 404
+static void serveRequest(int listenFd) {
+    int client = accept(listenFd, nullptr, nullptr);
+    if (client < 0) return;
+    timeval timeout = {1, 0}; // A silent client must not stall the JSON lines
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+        ssize_t n = recv(client, buffer, sizeof(buffer), 0);
+        if (n <= 0) break;
+        request.append(buffer, static_cast<size_t>(n));
+    }
+    const std::string path = request.compare(0, 4, "GET ") == 0 ? request.substr(4, request.find_first_of(" ?\r\n", 4) - 4) : "";
+    const bool found = path == "/metrics" || path == "/";
+    const std::string body = found ? metricsPrometheusText() : "Not found; metrics are at /metrics\n";
+    sendAll(client, std::string(found ? "HTTP/1.1 200 OK\r\n" : "HTTP/1.1 404 Not Found\r\n") +
+                        "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                        "Content-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body);
+    close(client);
+}
+
+// Wait for requests until the next JSON line is due; wake up at least every 100 ms to notice a stop
+static void exportLoop(MetricsExporter& state) {
+    typedef std::chrono::steady_clock Clock;
+    const Clock::duration interval =
+        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(state.options.intervalSeconds));
+    Clock::time_point next = Clock::now() + interval;
+    while (!state.stopping.load()) {
+        const long long untilNext = std::chrono::duration_cast<std::chrono::milliseconds>(next - Clock::now()).count();
+        pollfd descriptor = {state.listenFd, POLLIN, 0}; // A negative fd is ignored
+        if (poll(&descriptor, 1, static_cast<int>(std::max(0LL, std::min(untilNext, 100LL)))) > 0) {
+            serveRequest(state.listenFd);
+        }
+        const Clock::time_point now = Clock::now();
+        if (now >= next) {
+            writeJsonLine(state);
+            next = std::max(next + interval, now); // Skip lines that a slow client made us miss
+        }
+    }
+}
+
+static int listenOnLoopback(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address = sockaddr_in();
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, 8) != 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK); // accept() must not block if a client gave up
+    return fd;
+}
+
+bool startMetricsExport(const MetricsExportOptions& options) {
+    if (exporter) return true;
+    std::unique_ptr<MetricsExporter> state(new MetricsExporter());
+    state->options = options;
+    state->options.intervalSeconds = std::max(options.intervalSeconds, 0.01);
+    if (!options.jsonPath.empty()) {
+        state->json.open(options.jsonPath.c_str(), std::ios::app);
+        if (!state->json) {
+            std::cerr << "Error: Could not open " << options.jsonPath << " for metrics" << std::endl;
+            return false;
+        }
+    }
+    if (options.port > 0) {
+        state->listenFd = listenOnLoopback(options.port);
+        if (state->listenFd < 0) {
+            std::cerr << "Error: Could not listen on 127.0.0.1:" << options.port << " for metrics" << std::endl;
+            return false;
+        }
+        std::cout << "Serving metrics on http://127.0.0.1:" << options.port << "/metrics" << std::endl;
+    }
+    exporter = state.release();
+    exporter->thread = std::thread(exportLoop, std::ref(*exporter));
+    return true;
+}
+
+void stopMetricsExport() {
+    if (!exporter) return;
+    exporter->stopping.store(true);
+    exporter->thread.join();
+    writeJsonLine(*exporter); // The end of the run, however short the last interval
+    if (exporter->listenFd >= 0) close(exporter->listenFd);
+    delete exporter;
+    exporter = nullptr;
+}
+
+#else // DISABLE_METRICS
+
+bool startMetricsExport(const MetricsExportOptions&) {
+    std::cerr << "Error: Metrics were compiled out (built with -DDISABLE_METRICS)" << std::endl;
+    return false;
+}
+
+void stopMetricsExport() {}
+
+std::string metricsPrometheusText() { return ""; }
+
+#endif // DISABLE_METRICS
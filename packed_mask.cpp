@@ -0,0 +1,231 @@
+#include "packed_mask.hpp"
+#include "color_kernel.hpp"
+#include <algorithm>
+#include <cstring>
+
+
+void PackedMask::create(int newRows, int newCols) {
+    rows = newRows;
+    cols = newCols;
+    words = (newCols + 63) / 64;
+    bits.resize(static_cast<size_t>(rows) * words);
+}
+
+// Mask of the bits past 'cols' in the last word of a row
+static uint64_t paddingBits(int cols) {
+    return cols % 64 ? ~uint64_t(0) << (cols % 64) : 0;
+}
+
+// Pack one row from a per-pixel predicate, eight pixels per byte
+template <typename Predicate>
+static void packRow(uint64_t* row, int words, int cols, Predicate inside) {
+    row[words - 1] = 0; // Padding bits stay zero
+    uchar* bytes = reinterpret_cast<uchar*>(row);
+    for (int x = 0; x < cols; x += 8) {
+        const int n = std::min(8, cols - x);
+        uchar byte = 0;
+        for (int j = 0; j < n; j++) byte |= static_cast<uchar>(inside(x + j)) << j;
+        bytes[x >> 3] = byte;
+    }
+}
+
+bool thresholdToMask(const cv::Mat& frame, int thresholdValue, PackedMask& mask) {
+    if (frame.type() != CV_8UC3 && frame.type() != CV_8UC1) return false;
+    mask.create(frame.rows, frame.cols);
+    if (frame.empty()) return true;
+
+    cv::parallel_for_(cv::Range(0, frame.rows), [&](const cv::Range& rows) {
+        for (int y = rows.start; y < rows.end; y++) {
+            uint64_t* row = mask.row(y);
+            if (frame.channels() == 1) {
+                const uchar* p = frame.ptr<uchar>(y);
+                packRow(row, mask.words, frame.cols, [&](int x) { return p[x] > thresholdValue; });
+            } else {
+                row[mask.words - 1] = 0; // Padding bits stay zero
+                grayThresholdRow(frame.ptr<uchar>(y), frame.cols, thresholdValue, reinterpret_cast<uchar*>(row));
+            }
+        }
+    });
+    return true;
+}
+
+bool colorRangeToMask(const cv::Mat& frame, const std::string& choice, const int (&lowerBound)[3],
+                      const int (&upperBound)[3], PackedMask& mask) {
+    ColorRange range;
+    if (frame.type() != CV_8UC3 || !makeColorRange(choice, lowerBound, upperBound, range)) return false;
+    mask.create(frame.rows, frame.cols);
+    if (frame.empty()) return true;
+
+    cv::parallel_for_(cv::Range(0, frame.rows), [&](const cv::Range& rows) {
+        for (int y = rows.start; y < rows.end; y++) {
+            uint64_t* row = mask.row(y);
+            row[mask.words - 1] = 0; // colorRangeRow leaves the unused bits of the last byte alone
+            colorRangeRow(frame.ptr<uchar>(y), frame.cols, range, 0, reinterpret_cast<uchar*>(row));
+        }
+    });
+    return true;
+}
+
+bool packMask(const cv::Mat& image, PackedMask& mask) {
+    if (image.type() != CV_8UC1) return false;
+    mask.create(image.rows, image.cols);
+    if (image.empty()) return true;
+
+    for (int y = 0; y < image.rows; y++) {
+        const uchar* p = image.ptr<uchar>(y);
+        packRow(mask.row(y), mask.words, image.cols, [&](int x) { return p[x] != 0; });
+    }
+    return true;
+}
+
+// Eight output bytes (0 or 255) for every value of an input byte
+struct ExpandTable {
+    uint64_t bytes[256];
+    ExpandTable() {
+        for (int value = 0; value < 256; value++) {
+            bytes[value] = 0;
+            for (int j = 0; j < 8; j++) {
+                if (value & (1 << j)) bytes[value] |= uint64_t(0xFF) << (8 * j);
+            }
+        }
+    }
+};
+static const ExpandTable expandTable;
+
+void unpackMask(const PackedMask& mask, cv::Mat& output) {
+    output.create(mask.rows, mask.cols, CV_8UC1);
+    const int wholeBytes = mask.cols / 8;
+    for (int y = 0; y < mask.rows; y++) {
+        const uchar* bytes = reinterpret_cast<const uchar*>(mask.row(y));
+        uchar* target = output.ptr<uchar>(y);
+        for (int i = 0; i < wholeBytes; i++) std::memcpy(target + 8 * i, &expandTable.bytes[bytes[i]], 8);
+        for (int x = 8 * wholeBytes; x < mask.cols; x++) target[x] = (bytes[x >> 3] >> (x & 7)) & 1 ? 255 : 0;
+    }
+}
+
+
+// Bit x of 'target' = bit x + s of 'source'; bits shifted in from past the end are 'fill'
+static void shiftTowardStart(const uint64_t* source, uint64_t* target, int words, int s, uint64_t fill) {
+    const int q = s / 64, r = s % 64;
+    for (int i = 0; i < words; i++) {
+        const uint64_t low = i + q < words ? source[i + q] : fill;
+        const uint64_t high = i + q + 1 < words ? source[i + q + 1] : fill;
+        target[i] = r ? (low >> r) | (high << (64 - r)) : low;
+    }
+}
+
+// Bit x of 'target' = bit x - s of 'source'; bits shifted in from before the start are 'fill'
+static void shiftTowardEnd(const uint64_t* source, uint64_t* target, int words, int s, uint64_t fill) {
+    const int q = s / 64, r = s % 64;
+    for (int i = 0; i < words; i++) {
+        const uint64_t high = i - q >= 0 ? source[i - q] : fill;
+        const uint64_t low = i - q - 1 >= 0 ? source[i - q - 1] : fill;
+        target[i] = r ? (high << r) | (low >> (64 - r)) : high;
+    }
+}
+
+// AND for erosion (pixels outside the image count as set), OR for dilation (they count as clear)
+struct AndOp {
+    static const uint64_t fill = ~uint64_t(0);
+    static uint64_t apply(uint64_t a, uint64_t b) { return a & b; }
+};
+struct OrOp {
+    static const uint64_t fill = 0;
+    static uint64_t apply(uint64_t a, uint64_t b) { return a | b; }
+};
+
+// Combine every bit with its 'radius' neighbours on each side within each row. The window
+// [x, x + b] doubles per step (b = 0, 1, 3, 7, ...) on each side, so the cost is
+// O(log radius) word operations per 64 pixels.
+template <typename Op>
+static void morphRows(const PackedMask& mask, PackedMask& output, int radius, PackedMaskWork& work) {
+    const int words = mask.words;
+    output.create(mask.rows, mask.cols);
+    for (int k = 0; k < 3; k++) work.line[k].resize(words);
+    uint64_t* right = work.line[0].data();
+    uint64_t* left = work.line[1].data();
+    uint64_t* shifted = work.line[2].data();
+    const uint64_t padding = paddingBits(mask.cols);
+
+    for (int y = 0; y < mask.rows; y++) {
+        std::copy(mask.row(y), mask.row(y) + words, right);
+        right[words - 1] = (right[words - 1] & ~padding) | (Op::fill & padding); // Past the end counts as outside
+        std::copy(right, right + words, left);
+        for (int b = 0; b < radius;) {
+            const int s = std::min(b + 1, radius - b);
+            shiftTowardStart(right, shifted, words, s, Op::fill);
+            for (int i = 0; i < words; i++) right[i] = Op::apply(right[i], shifted[i]);
+            shiftTowardEnd(left, shifted, words, s, Op::fill);
+            for (int i = 0; i < words; i++) left[i] = Op::apply(left[i], shifted[i]);
+            b += s;
+        }
+        uint64_t* target = output.row(y);
+        for (int i = 0; i < words; i++) target[i] = Op::apply(right[i], left[i]);
+        target[words - 1] &= ~padding;
+    }
+}
+
+// Combine every row with its 'radius' neighbours above and below (van Herk / Gil-Werman):
+// the rows, extended by 'radius' outside rows at each end, are split into blocks of
+// 2 * radius + 1; a running value from the start and one to the end of each block give any
+// window as suffix[first] op prefix[last], three word operations per word whatever the radius.
+template <typename Op>
+static void morphColumns(const PackedMask& mask, PackedMask& output, int radius, PackedMaskWork& work) {
+    const int words = mask.words;
+    const int window = 2 * radius + 1;
+    const int extended = mask.rows + 2 * radius;
+    work.prefix.resize(static_cast<size_t>(extended) * words);
+    work.suffix.resize(static_cast<size_t>(extended) * words);
+    const uint64_t fill = Op::fill;
+    std::vector<uint64_t>& outside = work.line[0];
+    outside.assign(words, fill);
+
+    auto source = [&](int i) { return i >= radius && i < radius + mask.rows ? mask.row(i - radius) : outside.data(); };
+    for (int i = 0; i < extended; i++) {
+        const uint64_t* e = source(i);
+        uint64_t* g = &work.prefix[static_cast<size_t>(i) * words];
+        if (i % window == 0) {
+            std::copy(e, e + words, g);
+        } else {
+            const uint64_t* previous = g - words;
+            for (int w = 0; w < words; w++) g[w] = Op::apply(previous[w], e[w]);
+        }
+    }
+    for (int i = extended - 1; i >= 0; i--) {
+        const uint64_t* e = source(i);
+        uint64_t* h = &work.suffix[static_cast<size_t>(i) * words];
+        if (i % window == window - 1 || i == extended - 1) {
+            std::copy(e, e + words, h);
+        } else {
+            const uint64_t* next = h + words;
+            for (int w = 0; w < words; w++) h[w] = Op::apply(next[w], e[w]);
+        }
+    }
+
+    output.create(mask.rows, mask.cols);
+    for (int y = 0; y < mask.rows; y++) {
+        const uint64_t* h = &work.suffix[static_cast<size_t>(y) * words];
+        const uint64_t* g = &work.prefix[static_cast<size_t>(y + window - 1) * words];
+        uint64_t* target = output.row(y);
+        for (int w = 0; w < words; w++) target[w] = Op::apply(h[w], g[w]);
+    }
+}
+
+template <typename Op>
+static void morphMask(const PackedMask& mask, PackedMask& output, int kernelSize, PackedMaskWork& work) {
+    const int radius = std::max(kernelSize, 1) / 2;
+    if (mask.rows == 0 || mask.cols == 0 || radius == 0) {
+        if (&output != &mask) output = mask;
+        return;
+    }
+    morphRows<Op>(mask, work.horizontal, radius, work);
+    morphColumns<Op>(work.horizontal, output, radius, work);
+}
+
+void erodeMask(const PackedMask& mask, PackedMask& output, int kernelSize, PackedMaskWork& work) {
+    morphMask<AndOp>(mask, output, kernelSize, work);
+}
+
+void dilateMask(const PackedMask& mask, PackedMask& output, int kernelSize, PackedMaskWork& work) {
+    morphMask<OrOp>(mask, output, kernelSize, work);
+}
@@ -0,0 +1,57 @@
+#ifndef PACKED_MASK_HPP
+#define PACKED_MASK_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Binary mask with one bit per pixel: 8x less memory traffic than a 0/255 cv::Mat.
+// Pixel x of row y is bit (x % 64) of word (x / 64) of that row. Bits past 'cols' in the
+// last word of a row are always zero. On little-endian machines (x86, ARM) the byte at
+// x / 8 holds pixels x..x+7 least significant bit first, the layout colorRangeRow writes.
+struct PackedMask {
+    int rows = 0;
+    int cols = 0;
+    int words = 0;               // 64-bit words per row
+    std::vector<uint64_t> bits;  // rows * words, reused between frames
+
+    // Size the mask; contents are undefined afterwards. Keeps the storage if it is large enough.
+    void create(int rows, int cols);
+
+    uint64_t* row(int y) { return bits.data() + static_cast<size_t>(y) * words; }
+    const uint64_t* row(int y) const { return bits.data() + static_cast<size_t>(y) * words; }
+};
+
+// Buffers of the separable morphology passes, reused between calls
+struct PackedMaskWork {
+    PackedMask horizontal;          // Result of the row pass
+    std::vector<uint64_t> prefix;   // Running AND/OR from the start of each block of rows
+    std::vector<uint64_t> suffix;   // Running AND/OR to the end of each block of rows
+    std::vector<uint64_t> line[3];  // Right and left running results of one row and a shifted copy
+};
+
+// Fused BGR -> gray -> binary threshold in one pass: set where gray > thresholdValue.
+// Same pixels as cvtColor(COLOR_BGR2GRAY) + threshold(THRESH_BINARY) without the gray image.
+// Accepts 8-bit BGR or gray; returns false for anything else.
+bool thresholdToMask(const cv::Mat& frame, int thresholdValue, PackedMask& mask);
+
+// Set where the pixel lies inside [lowerBound, upperBound], as cv::inRange on the frame or its
+// HSV conversion ("HSV", "BGR" or "RBG"). Returns false for an unknown format or non-BGR input.
+bool colorRangeToMask(const cv::Mat& frame, const std::string& choice, const int (&lowerBound)[3],
+                      const int (&upperBound)[3], PackedMask& mask);
+
+// Pack an 8-bit single-channel image: set where the pixel is non-zero. Returns false for other types.
+bool packMask(const cv::Mat& image, PackedMask& mask);
+
+// Expand to a 0/255 CV_8UC1 image for display or for the cv::Mat operations
+void unpackMask(const PackedMask& mask, cv::Mat& output);
+
+// Erosion and dilation with an odd kernelSize x kernelSize rectangle, identical to cv::erode /
+// cv::dilate with MORPH_RECT and the default border on the unpacked mask. Rows are done
+// 64 pixels at a time with shifts and AND/OR, columns with a running AND/OR whose cost does
+// not depend on the kernel size. 'output' may be 'mask'.
+void erodeMask(const PackedMask& mask, PackedMask& output, int kernelSize, PackedMaskWork& work);
+void dilateMask(const PackedMask& mask, PackedMask& output, int kernelSize, PackedMaskWork& work);
+
+#endif // PACKED_MASK_HPP
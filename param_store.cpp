@@ -0,0 +1,35 @@
+#include "param_store.hpp"
+
+
+// Shared by every store, so a version identifies one snapshot in the whole process
+static std::atomic<uint64_t> nextVersion(1);
+
+// 'params' as a snapshot with a new version
+static std::shared_ptr<const ProcessingParams> makeSnapshot(const ProcessingParams& params) {
+    std::shared_ptr<ProcessingParams> snapshot = std::make_shared<ProcessingParams>(params);
+    snapshot->version = nextVersion.fetch_add(1, std::memory_order_relaxed);
+    return snapshot;
+}
+
+ParamStore::ParamStore(const ProcessingParams& params) : latest(makeSnapshot(params)), latestVersion(latest->version) {}
+
+std::shared_ptr<const ProcessingParams> ParamStore::snapshot() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return latest;
+}
+
+uint64_t ParamStore::publish(const ProcessingParams& params) {
+    std::lock_guard<std::mutex> guard(lock); // Versioned under the lock, so they are installed in order
+    latest = makeSnapshot(params);
+    latestVersion.store(latest->version, std::memory_order_release);
+    return latest->version;
+}
+
+uint64_t ParamStore::update(const std::function<void(ProcessingParams&)>& change) {
+    std::lock_guard<std::mutex> guard(lock);
+    ProcessingParams params = *latest;
+    change(params);
+    latest = makeSnapshot(params);
+    latestVersion.store(latest->version, std::memory_order_release);
+    return latest->version;
+}
@@ -0,0 +1,62 @@
+#ifndef PARAM_STORE_HPP
+#define PARAM_STORE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include "processing_params.hpp"
+
+// Latest parameters shared between the threads that change them (trackbars, stdin, config
+// reloads) and the threads that process frames.
+//
+// Every change is published as a new immutable snapshot with a new version (its params.version);
+// a published snapshot is never modified, so a reader can use it without locking for as long
+// as it holds it. Writers are serialized and copy the current snapshot before changing it.
+// Readers check for a change with one atomic load of the version and only take the lock to
+// fetch the new snapshot when it moved, which is once per change, not once per frame.
+class ParamStore {
+public:
+    explicit ParamStore(const ProcessingParams& params = ProcessingParams());
+
+    ParamStore(const ParamStore&) = delete;
+    ParamStore& operator=(const ParamStore&) = delete;
+
+    // Version of the latest snapshot: one atomic load
+    uint64_t version() const { return latestVersion.load(std::memory_order_acquire); }
+
+    // The latest snapshot
+    std::shared_ptr<const ProcessingParams> snapshot() const;
+
+    // Replace the parameters; returns the new version
+    uint64_t publish(const ProcessingParams& params);
+
+    // Change a copy of the latest parameters and publish it, e.g.
+    // store.update([](ProcessingParams& p) { p.thresholdValue = 100; });
+    uint64_t update(const std::function<void(ProcessingParams&)>& change);
+
+private:
+    mutable std::mutex lock;
+    std::shared_ptr<const ProcessingParams> latest;
+    std::atomic<uint64_t> latestVersion;
+};
+
+// One processing thread's view of a ParamStore: holds a snapshot and swaps it for the latest
+// one when the version changed
+class ParamReader {
+public:
+    explicit ParamReader(const ParamStore& store) : store(store), held(store.snapshot()) {}
+
+    // The latest parameters; the reference stays valid until the next call
+    const ProcessingParams& params() {
+        if (store.version() != held->version) held = store.snapshot();
+        return *held;
+    }
+
+private:
+    const ParamStore& store;
+    std::shared_ptr<const ProcessingParams> held;
+};
+
+#endif // PARAM_STORE_HPP
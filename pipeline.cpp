@@ -0,0 +1,321 @@
+#include "pipeline.hpp"
+#include "color_kernel.hpp"
+#include "color_lut.hpp"
+#include "blur.hpp"
+#include <iostream>
+
+
+static const int fusedStripBytes = 64 * 1024; // Target size of one strip of a fused group's input
+
+bool isPointwiseStage(char stage) {
+    return stage == '1' || stage == '2' || stage == '4' || stage == 'C';
+}
+
+bool isGeometricStage(char stage) {
+    return stage == '5' || stage == '6' || stage == '7';
+}
+
+bool isMaskStage(char stage) {
+    return stage == '4' || stage == 'B';
+}
+
+bool isMorphologyStage(char stage) {
+    return stage == '9' || stage == 'A';
+}
+
+int stageOutputType(char stage, int inputType) {
+    switch (stage) {
+        case '1': case '4': return CV_MAKETYPE(CV_MAT_DEPTH(inputType), 1);
+        case '2': case 'C': case 'E': return CV_MAKETYPE(CV_MAT_DEPTH(inputType), 3);
+        case 'B': return CV_8UC1;
+        default: return inputType;
+    }
+}
+
+// Radius of a square kernel, with the same fallback for invalid sizes as the operation
+static int kernelRadius(int kernelSize, int fallback) {
+    return (kernelSize <= 0 || kernelSize % 2 == 0 ? fallback : kernelSize) / 2;
+}
+
+int stageHaloRows(char stage, const ProcessingParams& params) {
+    switch (stage) {
+        case '1': case '2': case '4': case 'C': return 0;
+        case '3': {
+            const int kernelSize = kernelRadius(params.kernelSize, 15) * 2 + 1;
+            if (params.blurEngine != "box" || kernelSize < boxBlurMinKernelSize) return kernelSize / 2;
+            int widths[boxBlurPasses], radius = 0;
+            boxBlurWidths(kernelSize, widths);
+            for (int pass = 0; pass < boxBlurPasses; pass++) radius += widths[pass] / 2;
+            return radius;
+        }
+        case '9': return kernelRadius(params.erosionKernelSize, 3);
+        case 'A': return kernelRadius(params.dilationKernelSize, 3);
+        default: return -1;
+    }
+}
+
+// Return 'image' if it is already BGR, otherwise its BGR promotion stored in scratch.bgr
+static const cv::Mat& asBGR(const cv::Mat& image, ProcessingScratch& scratch) {
+    if (image.channels() == 3) return image;
+    cv::cvtColor(image, scratch.bgr, cv::COLOR_GRAY2BGR);
+    return scratch.bgr;
+}
+
+cv::Mat convolutionKernelOf(const ProcessingParams& params) {
+    if (params.convolutionKernel.size() != static_cast<size_t>(params.convolutionRows * params.convolutionCols)) return cv::Mat();
+    return cv::Mat(params.convolutionRows, params.convolutionCols, CV_32F, const_cast<float*>(params.convolutionKernel.data()));
+}
+
+BlobOptions blobOptionsOf(const ProcessingParams& params) {
+    BlobOptions options;
+    options.connectivity = params.blobConnectivity == 4 ? 4 : 8;
+    options.minArea = params.blobMinArea;
+    options.contours = params.blobContours;
+    return options;
+}
+
+void applyStage(char stage, const cv::Mat& input, cv::Mat& output, const ProcessingParams& params, ProcessingScratch& scratch) {
+    switch (stage) {
+        case '1': computeGrayscale(input, output); break;
+        case '2': computeHSV(asBGR(input, scratch), output); break;
+        case '3': computeBlurred(input, output, params.kernelSize, params.blurEngine, scratch); break;
+        case '4': computeThresholded(input, output, params.thresholdValue, scratch); break;
+        case '5': {
+            // Copy out of the view so 'output' never aliases an earlier stage's buffer
+            cv::Mat view;
+            if (computeCropped(input, view, params.cropX, params.cropY, params.cropWidth, params.cropHeight)) {
+                view.copyTo(output);
+            } else {
+                input.copyTo(output);
+            }
+            break;
+        }
+        case '6':
+            if (!computeResized(input, output, params.resizeWidth, params.resizeHeight)) input.copyTo(output);
+            break;
+        case '7': computeRotated(input, output, params.rotationAngle, scratch); break;
+        case '8': {
+            // Within one snapshot the kernel cannot have changed: skip building and comparing it
+            bool done = params.version != 0 && params.version == scratch.convolutionVersion && scratch.convolution.apply(input, output);
+            if (!done) {
+                done = computeConvolution(input, output, convolutionKernelOf(params), scratch);
+                scratch.convolutionVersion = done ? params.version : 0;
+            }
+            if (!done) input.copyTo(output);
+            break;
+        }
+        case '9': computeErosion(input, output, params.erosionKernelSize, scratch); break;
+        case 'A': computeDilation(input, output, params.dilationKernelSize, scratch); break;
+        case 'B': computeCanny(input, output, params.cannyLowerThreshold, params.cannyUpperThreshold, scratch); break;
+        case 'C': {
+            const cv::Mat& bgr = asBGR(input, scratch);
+            // The table is only used once built; until then, and for other inputs, the kernel runs
+            if (!(params.colorEngine == "lut" && computeColorMaskLut(bgr, output, params.choice, params.lowerBound, params.upperBound)) &&
+                !computeColorMaskFast(bgr, output, params.choice, params.lowerBound, params.upperBound) &&
+                !computeColorMask(bgr, output, params.choice, params.lowerBound, params.upperBound, scratch)) {
+                bgr.copyTo(output); // BGR like every other result of this stage
+            }
+            break;
+        }
+        case 'E':
+            if (!computeBlobs(input, output, params.thresholdValue, blobOptionsOf(params), scratch)) input.copyTo(output);
+            break;
+        default: input.copyTo(output); break;
+    }
+}
+
+
+bool Pipeline::configure(const std::string& choices, const std::string& metricsScope) {
+    const std::string supported = "123456789ABCE";
+    for (size_t i = 0; i < choices.size(); ++i) {
+        if (supported.find(choices[i]) == std::string::npos) {
+            std::cout << "Operation " << choices[i] << " cannot be used in a chain." << std::endl;
+            return false;
+        }
+    }
+
+    chain = choices;
+    groups.clear();
+    for (size_t i = 0; i < chain.size(); ++i) {
+        bool pointwise = isPointwiseStage(chain[i]);
+        bool geometric = isGeometricStage(chain[i]);
+        Group* last = groups.empty() ? 0 : &groups.back();
+        if (isMorphologyStage(chain[i]) && last && (last->packed || isMaskStage(last->stages.back()))) {
+            if (!last->packed && last->stages.size() > 1) {
+                // Take the threshold off the end of its point-wise run so the mask starts packed
+                char producer = last->stages.back();
+                last->stages.erase(last->stages.size() - 1);
+                groups.push_back(Group());
+                last = &groups.back();
+                last->stages = std::string(1, producer);
+            }
+            last->stages += chain[i];
+            last->packed = true;
+        } else if (pointwise && last && !last->packed && isPointwiseStage(last->stages[0])) {
+            groups.back().stages += chain[i]; // Extend the current point-wise run
+        } else if (geometric && last && isGeometricStage(last->stages[0])) {
+            groups.back().stages += chain[i]; // Extend the current geometric run
+        } else {
+            groups.push_back(Group());
+            groups.back().stages = std::string(1, chain[i]);
+        }
+    }
+    for (size_t g = 0; g < groups.size(); ++g) {
+        bool several = groups[g].stages.size() > 1; // A lone stage gains nothing from strips or composition
+        groups[g].fused = several && !groups[g].packed && isPointwiseStage(groups[g].stages[0]);
+        groups[g].warped = several && isGeometricStage(groups[g].stages[0]);
+        groups[g].latency = metricsHistogram(
+            metricName(metricName("stage_latency_seconds", "stage", describeGroup(groups[g])), "scope", metricsScope));
+    }
+    return true;
+}
+
+// A group's stages, in brackets, braces or angle brackets if it is fused, composed or packed
+std::string Pipeline::describeGroup(const Group& group) {
+    std::string text;
+    if (group.fused) text += "[";
+    if (group.warped) text += "{";
+    if (group.packed) text += "<";
+    for (size_t k = 0; k < group.stages.size(); ++k) {
+        if (k > 0) text += " ";
+        text += group.stages[k];
+    }
+    if (group.fused) text += "]";
+    if (group.warped) text += "}";
+    if (group.packed) text += ">";
+    return text;
+}
+
+std::string Pipeline::describe() const {
+    std::string text;
+    for (size_t g = 0; g < groups.size(); ++g) {
+        if (g > 0) text += " -> ";
+        text += describeGroup(groups[g]);
+    }
+    return text;
+}
+
+const cv::Mat& Pipeline::run(const cv::Mat& frame, const ProcessingParams& params) {
+    const cv::Mat* current = &frame;
+    for (size_t g = 0; g < groups.size(); ++g) {
+        Group& group = groups[g];
+        ScopedTimer timer(group.latency);
+        if (group.fused) {
+            runFused(group, *current, params);
+        } else if (group.warped) {
+            runWarped(group, *current, params);
+        } else if (group.packed) {
+            runPacked(group, *current, params);
+        } else {
+            applyStage(group.stages[0], *current, group.output, params, scratch);
+        }
+        current = &group.output;
+    }
+    return *current;
+}
+
+// Push the frame through every stage of a point-wise group one strip at a time.
+// Only the last stage writes to a full-size buffer; the others write into strip buffers.
+void Pipeline::runFused(Group& group, const cv::Mat& input, const ProcessingParams& params) {
+    const int rows = input.rows, cols = input.cols;
+    const int stripRows = std::max(1, fusedStripBytes / std::max(cols * static_cast<int>(input.elemSize()), 1));
+    const size_t stageCount = group.stages.size();
+
+    int type = input.type();
+    group.stripBuffers.resize(stageCount - 1);
+    for (size_t k = 0; k + 1 < stageCount; ++k) {
+        type = stageOutputType(group.stages[k], type);
+        group.stripBuffers[k].create(stripRows, cols, type);
+    }
+    group.output.create(rows, cols, stageOutputType(group.stages[stageCount - 1], type));
+
+    for (int y = 0; y < rows; y += stripRows) {
+        const int n = std::min(stripRows, rows - y);
+        // The short last strip gets its own scratch so neither set is reallocated every frame
+        ProcessingScratch& strip = n == stripRows ? stripScratch : tailScratch;
+        cv::Mat current = input.rowRange(y, y + n);
+        for (size_t k = 0; k < stageCount; ++k) {
+            cv::Mat target = k + 1 < stageCount ? group.stripBuffers[k].rowRange(0, n) : group.output.rowRange(y, y + n);
+            const uchar* expected = target.data;
+            applyStage(group.stages[k], current, target, params, strip);
+            if (target.data != expected) {
+                // The stage produced another type than stageOutputType said and wrote into a
+                // buffer of its own instead of the strip: the fused rows are not the result
+                runStages(group, input, params);
+                return;
+            }
+            current = target;
+        }
+    }
+}
+
+// Run a group's stages one after the other on whole frames, whatever types they produce
+void Pipeline::runStages(Group& group, const cv::Mat& input, const ProcessingParams& params) {
+    const size_t stageCount = group.stages.size();
+    const cv::Mat* current = &input;
+    for (size_t k = 0; k < stageCount; ++k) {
+        cv::Mat& target = k + 1 < stageCount ? group.stripBuffers[k] : group.output;
+        applyStage(group.stages[k], *current, target, params, scratch);
+        current = &target;
+    }
+}
+
+// Compose the group's crops, resizes and rotations into one destination -> source map and
+// apply it with a single remap: one interpolation instead of one per stage, no intermediates.
+// Invalid crop or resize parameters leave the image unchanged, as they do stage by stage.
+void Pipeline::runWarped(Group& group, const cv::Mat& input, const ProcessingParams& params) {
+    double total[6] = {1, 0, 0, 0, 1, 0};
+    cv::Size size = input.size();
+    bool rotates = false;
+    for (size_t k = 0; k < group.stages.size(); ++k) {
+        double step[6];
+        cv::Size next = size;
+        switch (group.stages[k]) {
+            case '5':
+                if (params.cropX < 0 || params.cropY < 0 || params.cropWidth <= 0 || params.cropHeight <= 0 ||
+                    params.cropX + params.cropWidth > size.width || params.cropY + params.cropHeight > size.height) {
+                    continue;
+                }
+                cropInverse(params.cropX, params.cropY, step);
+                next = cv::Size(params.cropWidth, params.cropHeight);
+                break;
+            case '6':
+                if (params.resizeWidth <= 0 || params.resizeHeight <= 0) continue;
+                next = cv::Size(params.resizeWidth, params.resizeHeight);
+                resizeInverse(size, next, step);
+                break;
+            default:
+                rotationInverse(params.rotationAngle, size, step);
+                rotates = true;
+                break;
+        }
+        composeAffine(total, step, total);
+        size = next;
+    }
+
+    // Resize and crop replicate edge pixels; a rotation brings in black corners
+    prepareWarp(group.warp, total, input.size(), size, rotates ? cv::BORDER_CONSTANT : cv::BORDER_REPLICATE);
+    applyWarp(group.warp, input, group.output);
+}
+
+// Produce the group's mask packed, run its erosions and dilations 64 pixels per word and
+// expand to 0/255 once. Input the packed threshold cannot read (not 8-bit) goes stage by stage.
+void Pipeline::runPacked(Group& group, const cv::Mat& input, const ProcessingParams& params) {
+    if (group.stages[0] == '4') {
+        if (!computeThresholdMask(input, group.mask, params.thresholdValue)) {
+            applyStage(group.stages[0], input, group.output, params, scratch);
+            for (size_t k = 1; k < group.stages.size(); ++k) {
+                applyStage(group.stages[k], group.output, group.output, params, scratch); // erode/dilate work in place
+            }
+            return;
+        }
+    } else {
+        computeCannyMask(input, group.mask, params.cannyLowerThreshold, params.cannyUpperThreshold, scratch);
+    }
+
+    for (size_t k = 1; k < group.stages.size(); ++k) {
+        if (group.stages[k] == '9') computeMaskErosion(group.mask, group.mask, params.erosionKernelSize, scratch);
+        else computeMaskDilation(group.mask, group.mask, params.dilationKernelSize, scratch);
+    }
+    unpackMask(group.mask, group.output);
+}
@@ -0,0 +1,91 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "image_processing.hpp"
+#include "metrics.hpp"
+#include "processing_params.hpp"
+
+// True for operations whose output pixel depends only on the same input pixel
+// (grayscale, HSV, threshold, color detection)
+bool isPointwiseStage(char stage);
+
+// True for crop, resize and rotate, which adjacent to each other compose into one affine map
+bool isGeometricStage(char stage);
+
+// True for threshold and Canny, whose 0/255 output erosion and dilation can process packed
+bool isMaskStage(char stage);
+bool isMorphologyStage(char stage);
+
+// Type a stage produces from an input of 'inputType' (stages that keep the frame size)
+int stageOutputType(char stage, int inputType);
+
+// Rows above and below an output row that a stage reads with the current parameters,
+// or -1 if the stage cannot run on horizontal strips: geometric stages change the frame
+// size, Canny's hysteresis follows edges across the whole frame, and convolution may go
+// through a whole-frame DFT (in filter2D or the engine) whose rounding depends on the size.
+int stageHaloRows(char stage, const ProcessingParams& params);
+
+// View of the option 8 kernel stored in 'params' (no copy)
+cv::Mat convolutionKernelOf(const ProcessingParams& params);
+
+// Option E settings stored in 'params'
+BlobOptions blobOptionsOf(const ProcessingParams& params);
+
+// Run one menu operation from 'input' into 'output' without displaying it.
+// Operations that need BGR input accept single-channel input and promote it first.
+void applyStage(char stage, const cv::Mat& input, cv::Mat& output, const ProcessingParams& params, ProcessingScratch& scratch);
+
+// An ordered chain of menu operations (e.g. "3C9AB": blur -> color detection -> erode -> dilate -> Canny).
+// Runs of adjacent point-wise stages are fused: they are applied strip by strip, so the
+// intermediate images only ever exist as a few cache-resident rows instead of full frames.
+// Runs of adjacent geometric stages are composed into a single cached remap.
+// Erosions and dilations that follow a threshold or Canny stage run on a bit-packed mask,
+// which is expanded back to 0/255 once at the end of the run.
+class Pipeline {
+public:
+    // Build the chain from menu choices; returns false (and prints why) on an unsupported choice.
+    // Every group's run time goes to stage_latency_seconds{stage="<group>",scope="<metricsScope>"}:
+    // "frame" for whole frames, "strip" for the pipelines the tile engine runs on strips.
+    bool configure(const std::string& choices, const std::string& metricsScope = "frame");
+
+    // The choices the pipeline was configured with
+    const std::string& choices() const { return chain; }
+
+    // Run the chain on one frame. The result stays valid until the next call.
+    const cv::Mat& run(const cv::Mat& frame, const ProcessingParams& params);
+
+    // Chain with fused groups in brackets, composed ones in braces and packed-mask ones in
+    // angle brackets, e.g. "3 -> [2 C] -> {5 7} -> <B 9 A>"
+    std::string describe() const;
+
+private:
+    struct Group {
+        std::string stages;     // Menu choices in this group
+        bool fused = false;     // Point-wise group run strip by strip
+        bool warped = false;    // Geometric group run as one remap
+        bool packed = false;    // Threshold or Canny followed by erosions/dilations on a packed mask
+        WarpMaps warp;          // Composed map of a geometric group, rebuilt when its parameters change
+        cv::Mat output;         // Persistent result of the group
+        PackedMask mask;        // Packed intermediate of a packed group
+        std::vector<cv::Mat> stripBuffers; // Strip-sized intermediates of a fused group
+        LatencyHistogram* latency = nullptr; // Run time of the group
+    };
+
+    static std::string describeGroup(const Group& group);
+
+    void runFused(Group& group, const cv::Mat& input, const ProcessingParams& params);
+    void runStages(Group& group, const cv::Mat& input, const ProcessingParams& params);
+    void runWarped(Group& group, const cv::Mat& input, const ProcessingParams& params);
+    void runPacked(Group& group, const cv::Mat& input, const ProcessingParams& params);
+
+    std::string chain;
+    std::vector<Group> groups;
+    ProcessingScratch scratch;      // Full-frame intermediates
+    ProcessingScratch stripScratch; // Strip-sized intermediates of fused groups
+    ProcessingScratch tailScratch;  // Intermediates of the shorter last strip
+};
+
+#endif // PIPELINE_HPP
@@ -0,0 +1,132 @@
+#include "processing_params.hpp"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+
+// Trim leading and trailing whitespace
+static std::string trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) return "";
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(begin, end - begin + 1);
+}
+
+// Keep only the menu characters of a chain such as "3, c, 9, A" -> "3C9A"
+static std::string normalizeChain(const std::string& text) {
+    std::string chain;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (std::isalnum(static_cast<unsigned char>(text[i]))) {
+            chain += static_cast<char>(std::toupper(static_cast<unsigned char>(text[i])));
+        }
+    }
+    return chain;
+}
+
+bool operator==(const ProcessingParams& a, const ProcessingParams& b) {
+    return a.kernelSize == b.kernelSize && a.blurEngine == b.blurEngine && a.thresholdValue == b.thresholdValue &&
+           a.cropX == b.cropX && a.cropY == b.cropY && a.cropWidth == b.cropWidth && a.cropHeight == b.cropHeight &&
+           a.resizeWidth == b.resizeWidth && a.resizeHeight == b.resizeHeight && a.rotationAngle == b.rotationAngle &&
+           a.convolutionRows == b.convolutionRows && a.convolutionCols == b.convolutionCols &&
+           a.convolutionKernel == b.convolutionKernel && a.erosionKernelSize == b.erosionKernelSize &&
+           a.dilationKernelSize == b.dilationKernelSize && a.cannyLowerThreshold == b.cannyLowerThreshold &&
+           a.cannyUpperThreshold == b.cannyUpperThreshold && a.blobMinArea == b.blobMinArea &&
+           a.blobConnectivity == b.blobConnectivity && a.blobContours == b.blobContours && std::equal(a.lowerBound, a.lowerBound + 3, b.lowerBound) &&
+           std::equal(a.upperBound, a.upperBound + 3, b.upperBound) && a.choice == b.choice &&
+           a.colorEngine == b.colorEngine && a.pipeline == b.pipeline;
+}
+
+bool applyParamSetting(const std::string& key, const std::string& value, ProcessingParams& params) {
+    std::istringstream in(value);
+    if (key == "pipeline") {
+        params.pipeline = normalizeChain(value);
+    } else if (key == "kernelSize") {
+        in >> params.kernelSize;
+    } else if (key == "thresholdValue") {
+        in >> params.thresholdValue;
+    } else if (key == "crop") {
+        in >> params.cropX >> params.cropY >> params.cropWidth >> params.cropHeight;
+    } else if (key == "resize") {
+        in >> params.resizeWidth >> params.resizeHeight;
+    } else if (key == "rotationAngle") {
+        in >> params.rotationAngle;
+    } else if (key == "convolutionKernel") {
+        int rows = 0, cols = 0;
+        in >> rows >> cols;
+        if (rows <= 0 || cols <= 0 || rows % 2 == 0 || cols % 2 == 0) return true; // Reported when applied
+        if (rows > maxConvolutionSize || cols > maxConvolutionSize) { // Bounded before anything is allocated
+            std::cerr << "Convolution kernel " << rows << "x" << cols << " is larger than " << maxConvolutionSize << "x"
+                      << maxConvolutionSize << "; keeping the current one." << std::endl;
+            return true;
+        }
+        std::vector<float> taps(static_cast<size_t>(rows) * static_cast<size_t>(cols));
+        for (size_t i = 0; i < taps.size(); ++i) in >> taps[i];
+        if (in) {
+            params.convolutionRows = rows;
+            params.convolutionCols = cols;
+            params.convolutionKernel = taps;
+        }
+    } else if (key == "erosionKernelSize") {
+        in >> params.erosionKernelSize;
+    } else if (key == "dilationKernelSize") {
+        in >> params.dilationKernelSize;
+    } else if (key == "canny") {
+        in >> params.cannyLowerThreshold >> params.cannyUpperThreshold;
+    } else if (key == "blobMinArea") {
+        in >> params.blobMinArea;
+    } else if (key == "blobConnectivity") {
+        in >> params.blobConnectivity;
+    } else if (key == "blobContours") {
+        in >> params.blobContours;
+    } else if (key == "lowerBound") {
+        in >> params.lowerBound[0] >> params.lowerBound[1] >> params.lowerBound[2];
+    } else if (key == "upperBound") {
+        in >> params.upperBound[0] >> params.upperBound[1] >> params.upperBound[2];
+    } else if (key == "colorSpace") {
+        std::string space;
+        in >> space;
+        std::transform(space.begin(), space.end(), space.begin(), ::toupper);
+        if (space == "HSV" || space == "BGR" || space == "RBG") {
+            params.choice = space;
+        } else {
+            std::cerr << "Unknown color space '" << space << "' (HSV or BGR). Keeping " << params.choice << "." << std::endl;
+        }
+    } else if (key == "blurEngine") {
+        in >> params.blurEngine;
+    } else if (key == "colorEngine") {
+        in >> params.colorEngine;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool loadParamsFile(const std::string& path, ProcessingParams& params) {
+    std::ifstream file(path.c_str());
+    if (!file) {
+        std::cerr << "Error: Could not open config file " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        line = trim(line);
+        if (line.empty() || line[0] == '#') continue;
+
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            std::cerr << path << ":" << lineNumber << ": expected key = value" << std::endl;
+            continue;
+        }
+        std::string key = trim(line.substr(0, equals));
+        std::string value = trim(line.substr(equals + 1));
+        if (!applyParamSetting(key, value, params)) {
+            std::cerr << path << ":" << lineNumber << ": unknown setting '" << key << "'" << std::endl;
+        }
+    }
+    return true;
+}
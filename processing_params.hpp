@@ -0,0 +1,60 @@
+#ifndef PROCESSING_PARAMS_HPP
+#define PROCESSING_PARAMS_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+static const int maxConvolutionSize = 101; // Largest rows or columns of a convolution kernel setting
+
+struct ProcessingParams {
+    int kernelSize = 15;
+    std::string blurEngine = "gaussian"; // "gaussian" (exact) or "box" (constant time for large kernels)
+    int thresholdValue = 128;
+    int cropX = 0, cropY = 0, cropWidth = 100, cropHeight = 100;
+    int resizeWidth = 640, resizeHeight = 480;
+    double rotationAngle = 0;
+    int convolutionRows = 3, convolutionCols = 3; // Odd kernel size for option 8
+    std::vector<float> convolutionKernel = {0, -1, 0, -1, 5, -1, 0, -1, 0}; // Row-major taps, sharpen by default
+    int erosionKernelSize = 3;
+    int dilationKernelSize = 3;
+    int cannyLowerThreshold = 50, cannyUpperThreshold = 150;
+    int blobMinArea = 20;           // Option E: smaller blobs are ignored
+    int blobConnectivity = 8;       // 8 or 4
+    bool blobContours = false;      // Also trace each blob's outline
+    // cv::Scalar lowerBound = cv::Scalar(0, 0, 0); // Default lower bound for color detection
+    // cv::Scalar upperBound = cv::Scalar(255, 255, 255); // Default upper bound for color detection
+    int lowerBound[3] = {0, 0, 0}; // Lower bound for color detection as int array
+    int upperBound[3] = {255, 255, 255}; // Upper bound for color detection as int array
+
+    std::string choice = "BGR";
+    std::string colorEngine = "kernel"; // Color detection: "kernel" (single-pass SIMD) or "lut" (membership table)
+
+    std::string pipeline = "3C9AB"; // Menu choices run in order by option D
+
+    uint64_t version = 0; // Snapshot version set by ParamStore; 0 if the values never went through a store
+};
+
+// True if every parameter is the same, so processing a frame with either gives the same result
+bool operator==(const ProcessingParams& a, const ProcessingParams& b);
+inline bool operator!=(const ProcessingParams& a, const ProcessingParams& b) { return !(a == b); }
+
+// Same as a == b, but a single comparison when both are the same ParamStore snapshot.
+// The version is not part of operator==: equal values published twice are still equal.
+inline bool sameParams(const ProcessingParams& a, const ProcessingParams& b) {
+    return (a.version != 0 && a.version == b.version) || a == b;
+}
+
+// Load "key = value" lines from a config file into 'params'.
+// Blank lines and lines starting with '#' are ignored; unknown keys are reported and skipped.
+// Recognized keys: pipeline, kernelSize, blurEngine (gaussian/box), thresholdValue, crop (x y w h), resize (w h),
+// rotationAngle, convolutionKernel (rows cols taps..., odd, at most 101x101), erosionKernelSize, dilationKernelSize, canny (low high),
+// blobMinArea, blobConnectivity (4/8), blobContours (0/1),
+// lowerBound (3 ints), upperBound (3 ints), colorSpace (HSV/BGR), colorEngine (kernel/lut).
+// Returns false if the file cannot be read.
+bool loadParamsFile(const std::string& path, ProcessingParams& params);
+
+// Apply a single "key = value" setting; returns false if the key is unknown
+bool applyParamSetting(const std::string& key, const std::string& value, ProcessingParams& params);
+
+#endif // PROCESSING_PARAMS_HPP
@@ -0,0 +1,285 @@
+#include "raw_video.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+static const int prefetchFrames = 4; // Frames ahead of the read position the kernel is asked to load
+
+static bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+RawVideoSource::RawVideoSource(const std::string& path) : name("raw:" + path) {
+    if (!(endsWith(path, ".y4m") ? openY4m(path) : openRaw(path)) && mapping) {
+        munmap(mapping, mappedBytes);
+        mapping = nullptr;
+    }
+}
+
+RawVideoSource::~RawVideoSource() {
+    if (mapping) munmap(mapping, mappedBytes);
+}
+
+bool RawVideoSource::mapFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Could not open " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    void* memory = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        // Private and writable: a consumer writing into a frame gets its own copy of the page
+        memory = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (memory == MAP_FAILED) {
+        std::cerr << "Error: Could not map " << path << std::endl;
+        return false;
+    }
+    mapping = static_cast<unsigned char*>(memory);
+    mappedBytes = info.st_size;
+    madvise(mapping, mappedBytes, MADV_SEQUENTIAL);
+    return true;
+}
+
+// "YUV4MPEG2 W1920 H1080 F30:1 Ip A1:1 C420jpeg" then "FRAME[ params]\n<planes>" per frame
+bool RawVideoSource::openY4m(const std::string& path) {
+    if (!mapFile(path)) return false;
+    const char* text = reinterpret_cast<const char*>(mapping);
+    const char* headerEnd = static_cast<const char*>(std::memchr(text, '\n', std::min<size_t>(mappedBytes, 1024)));
+    if (!headerEnd || std::strncmp(text, "YUV4MPEG2 ", 10) != 0) {
+        std::cerr << "Error: " << path << " is not a YUV4MPEG2 file" << std::endl;
+        return false;
+    }
+
+    std::istringstream header(std::string(text + 10, headerEnd));
+    std::string token, colorSpace = "420jpeg";
+    while (header >> token) {
+        if (token[0] == 'W') width = std::atoi(token.c_str() + 1);
+        else if (token[0] == 'H') height = std::atoi(token.c_str() + 1);
+        else if (token[0] == 'C') colorSpace = token.substr(1);
+        else if (token[0] == 'F') {
+            int numerator = 0, denominator = 0;
+            if (std::sscanf(token.c_str() + 1, "%d:%d", &numerator, &denominator) == 2 && numerator > 0 && denominator > 0) {
+                frameRate = static_cast<double>(numerator) / denominator;
+            }
+        }
+    }
+
+    size_t frameBytes = static_cast<size_t>(width) * height;
+    if (colorSpace == "mono") {
+        type = CV_8UC1;
+    } else if (colorSpace.compare(0, 3, "420") == 0 && width % 2 == 0 && height % 2 == 0) {
+        chroma = Chroma::Yuv420;
+        frameBytes += frameBytes / 2;
+    } else if (colorSpace == "444") {
+        chroma = Chroma::Yuv444;
+        frameBytes *= 3;
+    } else {
+        std::cerr << "Error: " << path << ": unsupported Y4M color space C" << colorSpace
+                  << " (expected mono, 420* with even size, or 444)" << std::endl;
+        return false;
+    }
+    if (width <= 0 || height <= 0) {
+        std::cerr << "Error: " << path << ": missing frame size" << std::endl;
+        return false;
+    }
+
+    // Index every frame once; only the short FRAME lines are read, not the pixels
+    size_t position = headerEnd - text + 1;
+    while (position + 5 < mappedBytes && std::strncmp(text + position, "FRAME", 5) == 0) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(text + position, '\n', std::min<size_t>(mappedBytes - position, 256)));
+        if (!lineEnd) break;
+        const size_t pixels = lineEnd - text + 1;
+        if (pixels + frameBytes > mappedBytes) break; // Truncated last frame
+        offsets.push_back(pixels);
+        position = pixels + frameBytes;
+    }
+    if (offsets.empty()) {
+        std::cerr << "Error: " << path << " has no complete frame" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Frames described by "<path>.desc": width, height, format (bgr/gray), fps
+bool RawVideoSource::openRaw(const std::string& path) {
+    std::ifstream descriptor((path + ".desc").c_str());
+    if (!descriptor) {
+        std::cerr << "Error: " << path << " needs a descriptor " << path << ".desc (width, height, format, fps)" << std::endl;
+        return false;
+    }
+    std::string line, format = "bgr";
+    while (std::getline(descriptor, line)) {
+        size_t equals = line.find('=');
+        if (line.empty() || line[0] == '#' || equals == std::string::npos) continue;
+        std::istringstream key(line.substr(0, equals)), value(line.substr(equals + 1));
+        std::string name;
+        key >> name;
+        if (name == "width") value >> width;
+        else if (name == "height") value >> height;
+        else if (name == "format") value >> format;
+        else if (name == "fps") value >> frameRate;
+    }
+    if (width <= 0 || height <= 0 || (format != "bgr" && format != "gray") || !(frameRate > 0)) {
+        std::cerr << "Error: " << path << ".desc: expected width, height, format = bgr|gray and fps" << std::endl;
+        return false;
+    }
+    type = format == "gray" ? CV_8UC1 : CV_8UC3;
+    if (!mapFile(path)) return false;
+
+    const size_t frameBytes = static_cast<size_t>(width) * height * CV_MAT_CN(type);
+    for (size_t offset = 0; offset + frameBytes <= mappedBytes; offset += frameBytes) offsets.push_back(offset);
+    if (offsets.empty()) {
+        std::cerr << "Error: " << path << " is smaller than one frame" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Ask the kernel to start loading a frame we are about to read
+void RawVideoSource::prefetch(int index) {
+    if (index < 0 || index >= frameCount()) return;
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t begin = offsets[index] / page * page;
+    const size_t end = index + 1 < frameCount() ? offsets[index + 1] : mappedBytes;
+    madvise(mapping + begin, end - begin, MADV_WILLNEED);
+}
+
+bool RawVideoSource::frameAt(int index, cv::Mat& frame) {
+    if (!mapping || index < 0 || index >= frameCount()) return false;
+    unsigned char* pixels = mapping + offsets[index];
+    switch (chroma) {
+        case Chroma::None:
+            frame = cv::Mat(height, width, type, pixels);
+            break;
+        case Chroma::Yuv420:
+            cv::cvtColor(cv::Mat(height * 3 / 2, width, CV_8UC1, pixels), frame, cv::COLOR_YUV2BGR_I420);
+            break;
+        case Chroma::Yuv444: {
+            // Y4M stores Y, Cb, Cr planes; OpenCV converts interleaved Y, Cr, Cb
+            const size_t plane = static_cast<size_t>(width) * height;
+            cv::Mat planes[3] = {cv::Mat(height, width, CV_8UC1, pixels), cv::Mat(height, width, CV_8UC1, pixels + 2 * plane),
+                                 cv::Mat(height, width, CV_8UC1, pixels + plane)};
+            cv::merge(planes, 3, ycrcb);
+            cv::cvtColor(ycrcb, frame, cv::COLOR_YCrCb2BGR);
+            break;
+        }
+    }
+    return true;
+}
+
+bool RawVideoSource::read(cv::Mat& frame) {
+    if (!frameAt(next, frame)) return false;
+    next++;
+    prefetch(next + prefetchFrames - 1);
+    return true;
+}
+
+bool RawVideoSource::seek(int index) {
+    if (!mapping || index < 0 || index >= frameCount()) return false;
+    next = index;
+    for (int k = 0; k < prefetchFrames; ++k) prefetch(index + k);
+    return true;
+}
+
+
+bool RawVideoWriter::open(const std::string& path, double fps) {
+    close();
+    filePath = path;
+    frameRate = fps > 0 ? fps : 30;
+    y4m = endsWith(path, ".y4m");
+    warned = false;
+    frameCount = 0;
+    byteCount = 0;
+    opened = true;
+    return true;
+}
+
+// Frame rate as a Y4M ratio: 30 -> "30:1", 29.97 -> "30000:1001"
+static std::string y4mFrameRate(double fps) {
+    if (std::fabs(fps - std::round(fps)) < 1e-6) return std::to_string(static_cast<long>(std::round(fps))) + ":1";
+    return std::to_string(static_cast<long>(std::round(fps * 1001))) + ":1001";
+}
+
+bool RawVideoWriter::start(const cv::Mat& frame) {
+    if (frame.type() != CV_8UC1 && frame.type() != CV_8UC3) return false;
+    width = frame.cols;
+    height = frame.rows;
+    type = frame.type();
+    file = std::fopen(filePath.c_str(), "wb");
+    if (!file) return false;
+    buffer.resize(std::min<size_t>(4 * frame.total() * frame.elemSize(), 64 << 20));
+    std::setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+
+    if (y4m) {
+        const std::string header = "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height) + " F" +
+                                   y4mFrameRate(frameRate) + " Ip A1:1 C" + (type == CV_8UC1 ? "mono" : "444") + "\n";
+        return writeBytes(header.data(), header.size());
+    }
+    std::ofstream descriptor((filePath + ".desc").c_str());
+    descriptor << "width = " << width << "\nheight = " << height << "\nformat = " << (type == CV_8UC1 ? "gray" : "bgr")
+               << "\nfps = " << frameRate << "\n";
+    return static_cast<bool>(descriptor);
+}
+
+bool RawVideoWriter::writeBytes(const void* data, size_t size) {
+    if (std::fwrite(data, 1, size, file) != size) return false;
+    byteCount += size;
+    return true;
+}
+
+bool RawVideoWriter::write(const cv::Mat& frame) {
+    if (!opened) return false;
+    bool ok;
+    if (!file) {
+        ok = start(frame);
+    } else {
+        ok = frame.type() == type && frame.cols == width && frame.rows == height;
+    }
+
+    if (ok && y4m) {
+        ok = writeBytes("FRAME\n", 6);
+        if (ok && type == CV_8UC3) {
+            cv::cvtColor(frame, ycrcb, cv::COLOR_BGR2YCrCb);
+            cv::split(ycrcb, planes);
+            // Y, Cb, Cr order on disk
+            ok = writeBytes(planes[0].data, planes[0].total()) && writeBytes(planes[2].data, planes[2].total()) &&
+                 writeBytes(planes[1].data, planes[1].total());
+        } else if (ok) {
+            for (int y = 0; ok && y < frame.rows; ++y) ok = writeBytes(frame.ptr(y), frame.cols);
+        }
+    } else if (ok) {
+        const size_t rowBytes = frame.cols * frame.elemSize();
+        if (frame.isContinuous()) ok = writeBytes(frame.data, rowBytes * frame.rows);
+        else for (int y = 0; ok && y < frame.rows; ++y) ok = writeBytes(frame.ptr(y), rowBytes);
+    }
+
+    if (!ok) {
+        if (!warned) {
+            std::cerr << "Warning: " << filePath << ": cannot record a " << frame.cols << "x" << frame.rows
+                      << " frame of type " << frame.type() << " (first frame: " << width << "x" << height
+                      << ", type " << type << ", 8-bit gray or BGR only)" << std::endl;
+        }
+        warned = true;
+        return false;
+    }
+    frameCount++;
+    return true;
+}
+
+void RawVideoWriter::close() {
+    if (file) std::fclose(file);
+    file = nullptr;
+    opened = false;
+}
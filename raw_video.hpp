@@ -0,0 +1,112 @@
+#ifndef RAW_VIDEO_HPP
+#define RAW_VIDEO_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "frame_source.hpp"
+
+// Uncompressed video read straight from a memory-mapped file, with no decoding and no copy.
+//
+// Two layouts are understood:
+//   - Y4M (".y4m"): YUV4MPEG2 header, then "FRAME" lines each followed by the planes.
+//     Cmono frames are handed out as CV_8UC1 headers into the mapping; C420* and C444
+//     frames are converted to BGR into the caller's cv::Mat.
+//   - Raw: frames of packed 8-bit BGR or gray pixels back to back, described by a sidecar
+//     "<file>.desc" with key = value lines: width, height, format (bgr or gray), fps.
+//     Every frame is a cv::Mat header into the mapping.
+// Frames stay valid until the source is destroyed. The mapping is private: writing into a
+// frame never changes the file. The kernel is told the file is read sequentially and asked
+// to prefetch the frames just ahead of each read; seek() and frameAt() give random access.
+class RawVideoSource : public FrameSource {
+public:
+    explicit RawVideoSource(const std::string& path);
+    ~RawVideoSource();
+
+    RawVideoSource(const RawVideoSource&) = delete;
+    RawVideoSource& operator=(const RawVideoSource&) = delete;
+
+    bool isOpened() const { return mapping != nullptr; }
+    bool read(cv::Mat& frame);
+    bool rewind() { return seek(0); }
+    double fps() const { return frameRate; }
+    std::string describe() const { return name; }
+
+    int frameCount() const { return static_cast<int>(offsets.size()); }
+    int position() const { return next; }
+
+    // Make frame 'index' the next one read; returns false if it does not exist
+    bool seek(int index);
+
+    // Frame 'index' without moving the read position
+    bool frameAt(int index, cv::Mat& frame);
+
+    // True if frames are views of the file (raw, Y4M mono), false if they are converted copies
+    bool isZeroCopy() const { return chroma == Chroma::None; }
+
+private:
+    enum class Chroma { None, Yuv420, Yuv444 };
+
+    bool openY4m(const std::string& path);
+    bool openRaw(const std::string& path);
+    bool mapFile(const std::string& path);
+    void prefetch(int index);
+
+    std::string name;
+    unsigned char* mapping = nullptr;
+    size_t mappedBytes = 0;
+    std::vector<size_t> offsets;   // Byte offset of each frame's pixels
+    int width = 0, height = 0;
+    int type = CV_8UC3;            // Of the frames handed out
+    Chroma chroma = Chroma::None;  // Y4M planes to convert, None for frames used as they are
+    double frameRate = 30;
+    int next = 0;
+    cv::Mat ycrcb;                 // Y4M 4:4:4 planes interleaved for the conversion
+};
+
+// Writes frames in either layout: Y4M if the path ends in ".y4m", raw with a ".desc" sidecar
+// otherwise. Size and format come from the first frame. Raw keeps 8-bit BGR and gray frames
+// bit-exact, for cheap diffs of processed output; Y4M writes gray as Cmono (exact) and BGR
+// as C444, converted through YCrCb (off by a level or two, but viewable in most players).
+class RawVideoWriter {
+public:
+    RawVideoWriter() {}
+    ~RawVideoWriter() { close(); }
+
+    RawVideoWriter(const RawVideoWriter&) = delete;
+    RawVideoWriter& operator=(const RawVideoWriter&) = delete;
+
+    // Start a new file; it is created when the first frame arrives
+    bool open(const std::string& path, double fps);
+    bool isOpen() const { return opened; }
+
+    // Append a frame. Returns false (after printing why, once) for a frame that is not 8-bit
+    // gray or BGR, does not match the first frame's size and type, or cannot be written.
+    bool write(const cv::Mat& frame);
+
+    void close();
+
+    const std::string& path() const { return filePath; }
+    int frames() const { return frameCount; }
+    uint64_t bytes() const { return byteCount; }
+
+private:
+    bool start(const cv::Mat& frame);
+    bool writeBytes(const void* data, size_t size);
+
+    std::string filePath;
+    double frameRate = 30;
+    bool opened = false;
+    FILE* file = nullptr;
+    bool y4m = false;
+    bool warned = false;           // A rejected frame was reported
+    int width = 0, height = 0, type = 0;
+    int frameCount = 0;
+    uint64_t byteCount = 0;
+    cv::Mat ycrcb, planes[3];      // BGR frames converted for Y4M
+    std::vector<char> buffer;      // stdio buffer, a few frames deep
+};
+
+#endif // RAW_VIDEO_HPP
@@ -0,0 +1,217 @@
+#include "recorder.hpp"
+#include <sys/stat.h>
+#include <cctype>
+#include <cstdio>
+#include <iostream>
+
+
+// Lower-case extension of 'path' including the dot, or "" if it has none
+static std::string extensionOf(const std::string& path) {
+    const size_t dot = path.find_last_of('.');
+    const size_t slash = path.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return "";
+    std::string extension = path.substr(dot);
+    for (char& c : extension) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return extension;
+}
+
+static bool isEncodedExtension(const std::string& extension) {
+    return extension == ".avi" || extension == ".mp4" || extension == ".mkv" || extension == ".mov";
+}
+
+static uint64_t fileSize(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? static_cast<uint64_t>(info.st_size) : 0;
+}
+
+static void updateMax(std::atomic<uint64_t>& maximum, uint64_t value) {
+    uint64_t current = maximum.load(std::memory_order_relaxed);
+    while (value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+AsyncRecorder::AsyncRecorder(const RecorderOptions& recorderOptions)
+    : options(recorderOptions),
+      queue(recorderOptions.queueDepth, recorderOptions.policy == RecordPolicy::DropOldest ? RingPolicy::DropOldest : RingPolicy::Block),
+      recycle(recorderOptions.queueDepth + 2, RingPolicy::DropOldest),
+      submitted(0), written(0), droppedNewest(0), failed(0), segments(0), bytes(0), writeNs(0), maxWriteNs(0), blockedNs(0),
+      maxDepth(0), writeMetric(nullptr), writtenMetric(nullptr), droppedMetric(nullptr), depthMetric(nullptr) {}
+
+bool AsyncRecorder::start() {
+    if (running) return true;
+    if (options.path.empty()) {
+        std::cerr << "No recording path given" << std::endl;
+        return false;
+    }
+    encoded = isEncodedExtension(extensionOf(options.path));
+    if (encoded && options.codec.size() != 4) {
+        std::cerr << "Recording codec must be a four-character code, e.g. MJPG: " << options.codec << std::endl;
+        return false;
+    }
+    rotating = options.segmentBytes > 0 || options.segmentSeconds > 0;
+    writeMetric = metricsHistogram("record_write_seconds"); // Only recorders that run show up in the metrics
+    writtenMetric = metricsCounter("record_frames_written_total");
+    droppedMetric = metricsCounter("record_frames_dropped_total");
+    depthMetric = metricsGauge("record_queue_depth");
+    running = true;
+    writer = std::thread(&AsyncRecorder::writeLoop, this);
+    return true;
+}
+
+bool AsyncRecorder::submit(const cv::Mat& frame) {
+    if (!running || frame.empty()) return false;
+    submitted.fetch_add(1, std::memory_order_relaxed);
+
+    QueuedFrame queued;
+    recycle.tryPop(queued); // Reuse a written frame's buffer when one is back
+    frame.copyTo(queued.image);
+
+    const uint64_t dropsBefore = queue.dropped();
+    bool queuedOk = queue.tryPush(queued);
+    if (!queuedOk) {
+        if (options.policy == RecordPolicy::DropNewest) {
+            droppedNewest.fetch_add(1, std::memory_order_relaxed);
+            droppedMetric->add();
+            recycle.tryPush(queued);
+            return false;
+        }
+        const std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+        queuedOk = queue.push(std::move(queued)); // Drops the oldest frame or waits, by the policy
+        if (options.policy == RecordPolicy::Block) {
+            blockedNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - before).count(),
+                                std::memory_order_relaxed);
+        }
+        droppedMetric->add(queue.dropped() - dropsBefore); // Only one thread submits, so only it drops
+    }
+    const size_t depth = queue.depth();
+    if (depth > maxDepth.load(std::memory_order_relaxed)) maxDepth.store(depth, std::memory_order_relaxed);
+    depthMetric->set(static_cast<int64_t>(depth));
+    return queuedOk;
+}
+
+void AsyncRecorder::close() {
+    if (!running) return;
+    queue.close(); // The writer drains what is left, then finishes the file
+    writer.join();
+    running = false;
+    depthMetric->set(0);
+}
+
+void AsyncRecorder::writeLoop() {
+    QueuedFrame frame;
+    while (queue.pop(frame)) {
+        depthMetric->set(static_cast<int64_t>(queue.depth()));
+        const std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+        const bool ok = writeFrame(frame.image);
+        const int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - before).count();
+        if (ok) {
+            written.fetch_add(1, std::memory_order_relaxed);
+            writeNs.fetch_add(elapsed, std::memory_order_relaxed);
+            updateMax(maxWriteNs, elapsed);
+            writeMetric->record(elapsed);
+            writtenMetric->add();
+        } else {
+            failed.fetch_add(1, std::memory_order_relaxed);
+        }
+        recycle.tryPush(frame);
+    }
+    closeSegment();
+}
+
+// Write one frame, starting a new segment first if the current one is full, too old or of another format
+bool AsyncRecorder::writeFrame(const cv::Mat& image) {
+    if (image.depth() != CV_8U || (image.channels() != 1 && image.channels() != 3)) {
+        if (!warned) std::cerr << "Recording skips frames that are not 8-bit gray or BGR" << std::endl;
+        warned = true;
+        return false;
+    }
+    if (segmentOpen) {
+        const bool formatChanged = image.size() != segmentFrameSize || image.type() != segmentType;
+        const bool full = options.segmentBytes > 0 && segmentSize() >= options.segmentBytes;
+        const bool old = options.segmentSeconds > 0 &&
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - segmentStart).count() >= options.segmentSeconds;
+        if (formatChanged || full || old) closeSegment();
+    }
+    if (!segmentOpen && !openSegment(image)) return false;
+
+    bool ok = true;
+    if (encoded) video.write(image);
+    else ok = raw.write(image);
+    if (!encoded || options.segmentBytes > 0) bytes.store(closedBytes + segmentSize(), std::memory_order_relaxed);
+    return ok;
+}
+
+bool AsyncRecorder::openSegment(const cv::Mat& image) {
+    const uint64_t index = segments.load(std::memory_order_relaxed);
+    currentPath = segmentPath(index);
+    if (index == 1 && !rotating) {
+        std::cout << "Recording format changed; continuing in " << currentPath << std::endl;
+    }
+    if (encoded) {
+        const int fourcc = cv::VideoWriter::fourcc(options.codec[0], options.codec[1], options.codec[2], options.codec[3]);
+        if (!video.open(currentPath, fourcc, options.fps, image.size(), image.channels() == 3)) {
+            if (!warned) std::cerr << "Could not open " << currentPath << " for recording with codec " << options.codec << std::endl;
+            warned = true;
+            return false;
+        }
+    } else if (!raw.open(currentPath, options.fps)) {
+        return false; // Reported by the writer
+    }
+    segmentOpen = true;
+    segmentFrameSize = image.size();
+    segmentType = image.type();
+    segmentStart = std::chrono::steady_clock::now();
+    segments.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void AsyncRecorder::closeSegment() {
+    if (!segmentOpen) return;
+    if (encoded) video.release();
+    else raw.close();
+    closedBytes += encoded ? fileSize(currentPath) : raw.bytes();
+    bytes.store(closedBytes, std::memory_order_relaxed);
+    segmentOpen = false;
+}
+
+// Bytes in the open segment
+uint64_t AsyncRecorder::segmentSize() const {
+    return encoded ? fileSize(currentPath) : raw.bytes();
+}
+
+// The path itself for a lone file, "<name>-0003<ext>" for the fourth of a series
+std::string AsyncRecorder::segmentPath(uint64_t index) const {
+    if (index == 0 && !rotating) return options.path;
+    const std::string extension = extensionOf(options.path);
+    const std::string name = options.path.substr(0, options.path.size() - extension.size());
+    char number[32];
+    std::snprintf(number, sizeof(number), "-%04llu", static_cast<unsigned long long>(index));
+    return name + number + options.path.substr(name.size());
+}
+
+RecorderStats AsyncRecorder::stats() const {
+    RecorderStats stats;
+    stats.submitted = submitted.load(std::memory_order_relaxed);
+    stats.written = written.load(std::memory_order_relaxed);
+    stats.dropped = droppedNewest.load(std::memory_order_relaxed) + queue.dropped();
+    stats.failed = failed.load(std::memory_order_relaxed);
+    stats.segments = segments.load(std::memory_order_relaxed);
+    stats.bytes = bytes.load(std::memory_order_relaxed);
+    stats.maxDepth = maxDepth.load(std::memory_order_relaxed);
+    stats.meanWriteMs = stats.written ? writeNs.load(std::memory_order_relaxed) / 1e6 / stats.written : 0;
+    stats.maxWriteMs = maxWriteNs.load(std::memory_order_relaxed) / 1e6;
+    stats.blockedMs = blockedNs.load(std::memory_order_relaxed) / 1e6;
+    return stats;
+}
+
+void printRecorderStats(const AsyncRecorder& recorder) {
+    const RecorderStats stats = recorder.stats();
+    char line[256];
+    std::snprintf(line, sizeof(line),
+                  " written=%llu dropped=%llu failed=%llu segments=%llu mb=%.1f max_depth=%zu write_mean_ms=%.2f"
+                  " write_max_ms=%.2f blocked_ms=%.1f",
+                  static_cast<unsigned long long>(stats.written), static_cast<unsigned long long>(stats.dropped),
+                  static_cast<unsigned long long>(stats.failed), static_cast<unsigned long long>(stats.segments),
+                  stats.bytes / 1e6, stats.maxDepth, stats.meanWriteMs, stats.maxWriteMs, stats.blockedMs);
+    std::cout << "record=" << recorder.path() << line << std::endl;
+}
@@ -0,0 +1,120 @@
+#ifndef RECORDER_HPP
+#define RECORDER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <opencv2/opencv.hpp>
+#include "frame_ring.hpp"
+#include "metrics.hpp"
+#include "raw_video.hpp"
+
+// What submit() does when the queue is full
+enum class RecordPolicy {
+    DropNewest, // The incoming frame is not recorded
+    DropOldest, // The oldest queued frame is discarded to make room
+    Block       // The caller waits for the writer (bit-exact audits of offline runs)
+};
+
+struct RecorderOptions {
+    std::string path;               // .y4m: Y4M; .avi .mp4 .mkv .mov: encoded with 'codec'; anything else: raw + .desc
+    std::string codec = "MJPG";     // FOURCC of encoded files
+    double fps = 30;
+    size_t queueDepth = 8;          // Frames waiting for the writer
+    RecordPolicy policy = RecordPolicy::DropOldest;
+    uint64_t segmentBytes = 0;      // Start a new file once the current one is this large; 0 = never
+    double segmentSeconds = 0;      // ... or has been open this long; 0 = never
+};
+
+struct RecorderStats {
+    uint64_t submitted = 0;     // Frames passed to submit()
+    uint64_t written = 0;       // Frames in the files
+    uint64_t dropped = 0;       // Frames lost to a full queue
+    uint64_t failed = 0;        // Frames the writer rejected (type, size, I/O error)
+    uint64_t segments = 0;      // Files started
+    uint64_t bytes = 0;         // Bytes in closed files and the open one
+    size_t maxDepth = 0;        // Deepest the queue was seen
+    double meanWriteMs = 0;     // Time to encode and write one frame
+    double maxWriteMs = 0;
+    double blockedMs = 0;       // Time submit() spent waiting on a full queue (Block)
+};
+
+// Records frames on its own thread so encoding and disk writes stay off the processing path.
+//
+// submit() copies the frame into a recycled buffer and queues it in a lock-free bounded ring;
+// a full ring is handled by the policy. The writer thread takes frames from the ring and writes
+// them with RawVideoWriter (raw, bit-exact; or Y4M) or cv::VideoWriter (encoded). The file is
+// rotated when it reaches segmentBytes or has been open for segmentSeconds, and whenever the
+// frame size or type changes. Files are the path itself when there is a single one, otherwise
+// "<name>-0000<ext>", "<name>-0001<ext>", ... The first frame of a file sets its size and format.
+// One thread submits. The rings are cache-line aligned, which C++11 new does not honor:
+// keep recorders on the stack or inside an object that is.
+class AsyncRecorder {
+public:
+    explicit AsyncRecorder(const RecorderOptions& options);
+    ~AsyncRecorder() { close(); }
+
+    AsyncRecorder(const AsyncRecorder&) = delete;
+    AsyncRecorder& operator=(const AsyncRecorder&) = delete;
+
+    // Check the options and start the writer thread; returns false (and prints why) if it cannot record
+    bool start();
+    bool isRunning() const { return running; }
+
+    // Queue a copy of 'frame'. Returns false if it was dropped or the recorder is closed.
+    bool submit(const cv::Mat& frame);
+
+    // Write what is queued, finish the file and stop the writer thread
+    void close();
+
+    // Counters so far; safe to call while recording
+    RecorderStats stats() const;
+
+    const std::string& path() const { return options.path; }
+
+private:
+    struct QueuedFrame {
+        cv::Mat image;
+    };
+
+    void writeLoop();
+    bool writeFrame(const cv::Mat& image);
+    bool openSegment(const cv::Mat& image);
+    void closeSegment();
+    uint64_t segmentSize() const;
+    std::string segmentPath(uint64_t index) const;
+
+    RecorderOptions options;
+    bool encoded = false;               // cv::VideoWriter rather than RawVideoWriter
+    bool rotating = false;              // Segments by size or time
+    bool running = false;
+    BoundedRing<QueuedFrame> queue;
+    BoundedRing<QueuedFrame> recycle;   // Written frames' buffers, back to submit()
+    std::thread writer;
+
+    // Writer thread only
+    RawVideoWriter raw;
+    cv::VideoWriter video;
+    std::string currentPath;
+    bool segmentOpen = false;
+    bool warned = false;                // A rejected frame was reported
+    cv::Size segmentFrameSize;
+    int segmentType = 0;
+    std::chrono::steady_clock::time_point segmentStart;
+    uint64_t closedBytes = 0;           // Bytes of finished segments
+
+    std::atomic<uint64_t> submitted, written, droppedNewest, failed, segments, bytes, writeNs, maxWriteNs, blockedNs;
+    std::atomic<size_t> maxDepth;
+    LatencyHistogram* writeMetric;
+    MetricCounter* writtenMetric;
+    MetricCounter* droppedMetric;
+    MetricGauge* depthMetric;
+};
+
+// Print one line with the frames written and lost, the write time and the queue depth, e.g.
+// "record=out.avi written=900 dropped=0 failed=0 segments=1 mb=41.2 max_depth=3 write_mean_ms=2.10 write_max_ms=7.93 blocked_ms=0.0"
+void printRecorderStats(const AsyncRecorder& recorder);
+
+#endif // RECORDER_HPP
@@ -0,0 +1,126 @@
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "shm_ring.hpp"
+
+
+// Reads the frames my_program publishes with --shm NAME, straight from shared memory.
+// cmake -S . -B build && cmake --build build --target shm_reader
+
+typedef std::chrono::steady_clock Clock;
+
+struct ReaderOptions {
+    std::string name;
+    long frames = 0;          // Stop after this many frames (0 = until the writer goes quiet)
+    std::string savePattern;  // printf pattern for saving frames, e.g. "out_%06d.png"
+    double idleSeconds = 5;   // Give up after this long without a new frame
+};
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " NAME [--frames N] [--save PATTERN] [--idle SECONDS]" << std::endl;
+    std::cout << "  NAME            ring given to my_program --shm" << std::endl;
+    std::cout << "  --frames N      stop after N frames (default: run until the writer goes quiet)" << std::endl;
+    std::cout << "  --save PATTERN  write every frame to a file, e.g. out_%06d.png" << std::endl;
+    std::cout << "  --idle SECONDS  exit after this long without a frame (default 5)" << std::endl;
+}
+
+bool parseCommandLine(int argc, char** argv, ReaderOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--frames" && hasValue) {
+            options.frames = std::atol(argv[++i]);
+        } else if (arg == "--save" && hasValue) {
+            options.savePattern = argv[++i];
+        } else if (arg == "--idle" && hasValue) {
+            options.idleSeconds = std::atof(argv[++i]);
+        } else if (arg[0] != '-' && options.name.empty()) {
+            options.name = arg;
+        } else {
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    if (options.name.empty()) {
+        printUsage(argv[0]);
+        return false;
+    }
+    return true;
+}
+
+// Median of the latencies gathered since the last report
+double median(std::vector<double>& values) {
+    if (values.empty()) return 0;
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    return values[values.size() / 2];
+}
+
+int main(int argc, char** argv) {
+    ReaderOptions options;
+    if (!parseCommandLine(argc, argv, options)) return -1;
+
+    ShmFrameReader reader;
+    const Clock::time_point waitStart = Clock::now();
+    while (!reader.open(options.name)) {
+        if (Clock::now() - waitStart > std::chrono::duration<double>(options.idleSeconds)) {
+            std::cerr << "Error: No frame ring " << shmObjectName(options.name) << std::endl;
+            return -1;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    std::cout << "Reading " << shmObjectName(options.name) << " (" << reader.slotCount() << " slots)" << std::endl;
+
+    long total = 0, torn = 0, intervalFrames = 0;
+    std::vector<double> latencies;
+    ShmFrame frame;
+    cv::Mat copy;
+    Clock::time_point lastFrame = Clock::now(), lastReport = lastFrame;
+    while (options.frames == 0 || total < options.frames) {
+        const Clock::time_point now = Clock::now();
+        if (now - lastReport >= std::chrono::seconds(1)) {
+            char line[256];
+            std::snprintf(line, sizeof(line), "frames=%ld fps=%.1f skipped=%llu torn=%ld latency_p50_ms=%.3f",
+                          total, intervalFrames / std::chrono::duration<double>(now - lastReport).count(),
+                          static_cast<unsigned long long>(reader.skipped()), torn, median(latencies));
+            std::cout << line << std::endl;
+            intervalFrames = 0;
+            latencies.clear();
+            lastReport = now;
+        }
+        if (!reader.next(frame)) {
+            if (now - lastFrame > std::chrono::duration<double>(options.idleSeconds)) break;
+            std::this_thread::sleep_for(std::chrono::microseconds(200)); // Poll; the writer never waits for us
+            continue;
+        }
+        lastFrame = now;
+        latencies.push_back((shmTimestampNow() - frame.timestampNs) / 1e6);
+
+        if (!options.savePattern.empty()) {
+            frame.image.copyTo(copy); // Copy out before the slot can be reused, then check it was not
+            if (reader.valid(frame)) {
+                char path[1024];
+                std::snprintf(path, sizeof(path), options.savePattern.c_str(), static_cast<long>(frame.frame));
+                cv::imwrite(path, copy);
+            }
+        }
+        if (!reader.valid(frame)) {
+            torn++; // The writer lapped us while we used the frame
+            continue;
+        }
+        total++;
+        intervalFrames++;
+    }
+
+    char line[256];
+    std::snprintf(line, sizeof(line), "shm=%s frames=%ld skipped=%llu torn=%ld published=%llu",
+                  shmObjectName(options.name).c_str(), total, static_cast<unsigned long long>(reader.skipped()), torn,
+                  static_cast<unsigned long long>(reader.published()));
+    std::cout << line << std::endl;
+    return 0;
+}
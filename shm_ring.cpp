@@ -0,0 +1,201 @@
+#include "shm_ring.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+static_assert(sizeof(ShmSlotHeader) == 64, "slot header must keep the pixels 64-byte aligned");
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t), "ring atomics must be plain 64-bit words");
+
+static const size_t shmAlignment = 64;
+
+static size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+std::string shmObjectName(const std::string& name) {
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+
+int64_t shmTimestampNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+ShmFrameWriter::~ShmFrameWriter() {
+    close();
+}
+
+void ShmFrameWriter::close() {
+    if (!header) return;
+    munmap(header, mappedBytes);
+    shm_unlink(objectName.c_str());
+    header = nullptr;
+}
+
+bool ShmFrameWriter::create(const std::string& name, int slotCount, size_t slotBytes) {
+    close();
+    objectName = shmObjectName(name);
+    slotCount = std::max(slotCount, 2);
+    const size_t headerBytes = alignUp(sizeof(ShmRingHeader), shmAlignment);
+    const size_t slotStride = alignUp(sizeof(ShmSlotHeader) + slotBytes, shmAlignment);
+    const size_t totalBytes = headerBytes + slotStride * slotCount;
+
+    shm_unlink(objectName.c_str()); // A ring left behind by a crashed run
+    int fd = shm_open(objectName.c_str(), O_CREAT | O_RDWR | O_EXCL, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: Could not create shared memory " << objectName << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    void* memory = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(totalBytes)) == 0) {
+        memory = mmap(nullptr, totalBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        std::cerr << "Error: Could not map " << totalBytes << " bytes of shared memory " << objectName << ": "
+                  << std::strerror(errno) << std::endl;
+        shm_unlink(objectName.c_str());
+        return false;
+    }
+
+    // The new object is zero-filled: every slot is empty at version 0
+    header = static_cast<ShmRingHeader*>(memory);
+    mappedBytes = totalBytes;
+    oversizedFrames = 0;
+    header->version = shmRingVersion;
+    header->slotCount = static_cast<uint32_t>(slotCount);
+    header->headerBytes = static_cast<uint32_t>(headerBytes);
+    header->slotStride = slotStride;
+    header->slotBytes = slotBytes;
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = shmRingMagic; // Last, so a reader never sees a half-initialized header
+    return true;
+}
+
+bool ShmFrameWriter::publish(const cv::Mat& image, const std::string& operation, int64_t timestampNs) {
+    if (!header) return false;
+    const size_t rowBytes = image.cols * image.elemSize();
+    if (image.dims > 2 || rowBytes * image.rows > header->slotBytes) {
+        oversizedFrames++;
+        return false;
+    }
+
+    const uint64_t frame = header->published.load(std::memory_order_relaxed);
+    char* base = reinterpret_cast<char*>(header) + header->headerBytes + header->slotStride * (frame % header->slotCount);
+    ShmSlotHeader* slot = reinterpret_cast<ShmSlotHeader*>(base);
+    const uint64_t version = slot->version.load(std::memory_order_relaxed);
+    slot->version.store(version + 1, std::memory_order_relaxed); // Readers now see the slot as being written
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->frame = frame;
+    slot->timestampNs = timestampNs;
+    slot->rows = image.rows;
+    slot->cols = image.cols;
+    slot->type = image.type();
+    slot->step = static_cast<int32_t>(rowBytes);
+    std::memset(slot->operation, 0, sizeof(slot->operation));
+    operation.copy(slot->operation, sizeof(slot->operation) - 1);
+    uchar* pixels = reinterpret_cast<uchar*>(base + sizeof(ShmSlotHeader));
+    if (image.isContinuous()) {
+        std::memcpy(pixels, image.data, rowBytes * image.rows);
+    } else {
+        for (int y = 0; y < image.rows; y++) std::memcpy(pixels + rowBytes * y, image.ptr(y), rowBytes);
+    }
+
+    slot->version.store(version + 2, std::memory_order_release);
+    header->published.store(frame + 1, std::memory_order_release);
+    return true;
+}
+
+
+ShmFrameReader::~ShmFrameReader() {
+    if (header) munmap(const_cast<ShmRingHeader*>(header), mappedBytes);
+}
+
+bool ShmFrameReader::open(const std::string& name) {
+    if (header) munmap(const_cast<ShmRingHeader*>(header), mappedBytes);
+    header = nullptr;
+    int fd = shm_open(shmObjectName(name).c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+    struct stat info;
+    void* memory = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(ShmRingHeader)) {
+        memory = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (memory == MAP_FAILED) return false;
+
+    const ShmRingHeader* ring = static_cast<const ShmRingHeader*>(memory);
+    const bool ready = ring->magic == shmRingMagic;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!ready || ring->version != shmRingVersion || ring->slotCount < 2 ||
+        ring->headerBytes + ring->slotStride * ring->slotCount > static_cast<uint64_t>(info.st_size)) {
+        munmap(memory, info.st_size);
+        return false;
+    }
+    header = ring;
+    mappedBytes = info.st_size;
+    cursor = header->published.load(std::memory_order_acquire);
+    skippedFrames = 0;
+    return true;
+}
+
+const ShmSlotHeader* ShmFrameReader::slotHeader(int slot) const {
+    const char* base = reinterpret_cast<const char*>(header) + header->headerBytes + header->slotStride * slot;
+    return reinterpret_cast<const ShmSlotHeader*>(base);
+}
+
+bool ShmFrameReader::next(ShmFrame& frame) {
+    if (!header) return false;
+    const uint64_t slots = header->slotCount;
+    for (;;) {
+        const uint64_t published = header->published.load(std::memory_order_acquire);
+        if (cursor >= published) return false;
+        // The slot after the newest frame is the one the writer fills next: never start there
+        if (published - cursor >= slots) {
+            skippedFrames += published - slots + 1 - cursor;
+            cursor = published - slots + 1;
+        }
+
+        const int slot = static_cast<int>(cursor % slots);
+        const ShmSlotHeader* source = slotHeader(slot);
+        const uint64_t version = source->version.load(std::memory_order_acquire);
+        const uint64_t number = source->frame;
+        const int64_t timestampNs = source->timestampNs;
+        const int rows = source->rows, cols = source->cols, type = source->type, step = source->step;
+        char operation[sizeof(source->operation)];
+        std::memcpy(operation, source->operation, sizeof(operation));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const bool intact = !(version & 1) && source->version.load(std::memory_order_relaxed) == version;
+        if (!intact || number != cursor || rows < 0 || cols < 0 || step < 0 ||
+            static_cast<uint64_t>(rows) * step > header->slotBytes) {
+            skippedFrames++; // Overwritten by a newer frame while we looked
+            cursor++;
+            continue;
+        }
+
+        operation[sizeof(operation) - 1] = 0;
+        frame.frame = number;
+        frame.timestampNs = timestampNs;
+        frame.operation = operation;
+        frame.slot = slot;
+        frame.version = version;
+        uchar* pixels = const_cast<uchar*>(reinterpret_cast<const uchar*>(source + 1));
+        frame.image = cv::Mat(rows, cols, type, pixels, step);
+        cursor++;
+        return true;
+    }
+}
+
+bool ShmFrameReader::valid(const ShmFrame& frame) const {
+    if (!header) return false;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slotHeader(frame.slot)->version.load(std::memory_order_relaxed) == frame.version;
+}
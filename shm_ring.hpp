@@ -0,0 +1,127 @@
+#ifndef SHM_RING_HPP
+#define SHM_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <opencv2/opencv.hpp>
+
+// Processed frames published to other local processes through a POSIX shared-memory ring.
+//
+// The shared object (shm_open name, e.g. "/webcam_out") starts with a ShmRingHeader, followed
+// by 'slotCount' slots of 'slotStride' bytes: a ShmSlotHeader, then the pixels, rows packed
+// at 'step' bytes. Frame n (counting from 0) goes to slot n % slotCount, and 'published'
+// counts the frames written so far. A slot header's 'version' is odd while the writer is
+// filling the slot and increases by 2 per frame, so a reader can check that the pixels it
+// used were not overwritten meanwhile (a sequence lock). Readers never write to the
+// ring and never block the writer; a reader that falls a whole ring behind skips ahead.
+// Timestamps are steady_clock (CLOCK_MONOTONIC) nanoseconds, comparable between processes.
+
+static const uint32_t shmRingMagic = 0x474e5246; // "FRNG"
+static const uint32_t shmRingVersion = 1;
+
+struct ShmRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t headerBytes;             // Offset of slot 0
+    uint64_t slotStride;              // Bytes from one slot to the next
+    uint64_t slotBytes;               // Largest frame (rows * step) a slot holds
+    std::atomic<uint64_t> published;  // Frames published so far
+};
+
+struct ShmSlotHeader {
+    std::atomic<uint64_t> version;    // Odd while being written
+    uint64_t frame;                   // Frame number
+    int64_t timestampNs;              // When the frame was published
+    int32_t rows, cols, type, step;   // cv::Mat geometry of the pixels that follow
+    char operation[16];               // Menu choice or chain that produced the frame, NUL-terminated
+    char padding[8];                  // Pixels start 64-byte aligned
+};
+
+// Writer side: owns the shared-memory object and removes it when destroyed
+class ShmFrameWriter {
+public:
+    ShmFrameWriter() {}
+    ~ShmFrameWriter();
+
+    ShmFrameWriter(const ShmFrameWriter&) = delete;
+    ShmFrameWriter& operator=(const ShmFrameWriter&) = delete;
+
+    // Create (or replace) the ring 'name' with 'slotCount' slots of 'slotBytes' pixel bytes.
+    // Returns false (after printing why) if the object cannot be created or mapped.
+    bool create(const std::string& name, int slotCount, size_t slotBytes);
+
+    bool isOpen() const { return header != nullptr; }
+    const std::string& name() const { return objectName; }
+
+    // Copy 'image' into the next slot and publish it. Returns false, and counts the frame,
+    // if it is larger than a slot.
+    bool publish(const cv::Mat& image, const std::string& operation, int64_t timestampNs);
+
+    uint64_t published() const { return header ? header->published.load(std::memory_order_relaxed) : 0; }
+    uint64_t oversized() const { return oversizedFrames; }
+
+private:
+    void close();
+
+    std::string objectName;
+    ShmRingHeader* header = nullptr;
+    size_t mappedBytes = 0;
+    uint64_t oversizedFrames = 0;
+};
+
+// A frame as seen by a reader. 'image' points into the shared mapping: use it, then call
+// ShmFrameReader::valid() to make sure the writer did not overwrite it meanwhile (or clone it first).
+struct ShmFrame {
+    uint64_t frame = 0;
+    int64_t timestampNs = 0;
+    std::string operation;
+    cv::Mat image;
+    int slot = 0;
+    uint64_t version = 0;
+};
+
+// Reader side: maps an existing ring read-only
+class ShmFrameReader {
+public:
+    ShmFrameReader() {}
+    ~ShmFrameReader();
+
+    ShmFrameReader(const ShmFrameReader&) = delete;
+    ShmFrameReader& operator=(const ShmFrameReader&) = delete;
+
+    // Map the ring 'name'. Only frames published from now on are returned.
+    // Returns false if there is no such ring or it has an unknown layout.
+    bool open(const std::string& name);
+
+    bool isOpen() const { return header != nullptr; }
+
+    // Get the oldest frame not returned yet. Returns false if there is none.
+    // Frames the writer overwrote before they could be read are skipped and counted.
+    bool next(ShmFrame& frame);
+
+    // True if 'frame' has not been overwritten since next() returned it
+    bool valid(const ShmFrame& frame) const;
+
+    uint64_t published() const { return header ? header->published.load(std::memory_order_acquire) : 0; }
+    uint64_t skipped() const { return skippedFrames; }
+    int slotCount() const { return header ? static_cast<int>(header->slotCount) : 0; }
+
+private:
+    const ShmSlotHeader* slotHeader(int slot) const;
+
+    const ShmRingHeader* header = nullptr;
+    size_t mappedBytes = 0;
+    uint64_t cursor = 0;             // Next frame to return
+    uint64_t skippedFrames = 0;
+};
+
+// POSIX shared-memory names start with a single '/': "webcam_out" -> "/webcam_out"
+std::string shmObjectName(const std::string& name);
+
+// steady_clock now, in nanoseconds
+int64_t shmTimestampNow();
+
+#endif // SHM_RING_HPP
@@ -0,0 +1,155 @@
+#include "staged_runner.hpp"
+#include "headless.hpp"
+#include "metrics.hpp"
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+
+static const size_t latencyWindow = 4096; // Most recent latencies kept for the percentiles
+
+// Raise 'maximum' to 'value' if it is larger
+static void updateMax(std::atomic<size_t>& maximum, size_t value) {
+    size_t current = maximum.load(std::memory_order_relaxed);
+    while (value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+StagedStats runStaged(FrameSource& source, const StagedOptions& options,
+                      const StageProcessFunction& process, const StageDisplayFunction& display) {
+    typedef std::chrono::steady_clock Clock;
+    BoundedRing<StagedFrame> captureRing(options.captureQueueDepth, options.policy);
+    BoundedRing<StagedFrame> displayRing(options.displayQueueDepth, options.policy);
+    // Finished frames go back to capture; sized to hold every frame that can be in flight
+    BoundedRing<StagedFrame> recycleRing(captureRing.capacity() + displayRing.capacity() + 4, RingPolicy::DropOldest);
+
+    std::atomic<bool> stopRequested(false);
+    std::atomic<uint64_t> captured(0), processed(0);
+    std::atomic<size_t> maxCaptureDepth(0), maxDisplayDepth(0);
+    const Clock::time_point start = Clock::now();
+
+    MetricCounter* capturedTotal = metricsCounter("frames_captured_total");
+    MetricCounter* processedTotal = metricsCounter("frames_processed_total");
+    MetricCounter* displayedTotal = metricsCounter("frames_displayed_total");
+    MetricCounter* captureDropsTotal = metricsCounter(metricName("frames_dropped_total", "queue", "capture"));
+    MetricCounter* displayDropsTotal = metricsCounter(metricName("frames_dropped_total", "queue", "display"));
+    MetricGauge* captureDepth = metricsGauge(metricName("queue_depth", "queue", "capture"));
+    MetricGauge* displayDepth = metricsGauge(metricName("queue_depth", "queue", "display"));
+    LatencyHistogram* endToEnd = metricsHistogram("capture_to_display_latency_seconds");
+
+    std::thread captureThread([&]() {
+        uint64_t drops = 0; // Of the capture ring, already added to the metrics
+        const double fps = source.fps();
+        const bool pace = options.paceToSourceFps && fps > 0;
+        for (uint64_t sequence = 0; !stopRequested.load(std::memory_order_relaxed); ++sequence) {
+            if (options.maxFrames > 0 && sequence >= options.maxFrames) break;
+
+            StagedFrame frame;
+            recycleRing.tryPop(frame); // Reuse buffers when one is available
+            if (pace) {
+                std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(sequence / fps)));
+            }
+            if (!source.read(frame.image)) {
+                // Replayable sources start over, as in runHeadless; cameras and streams end the run
+                if (!source.rewind() || !source.read(frame.image)) {
+                    if (options.maxFrames > 0) {
+                        std::cerr << "Warning: " << source.describe() << " ran out after " << sequence << " frames" << std::endl;
+                    }
+                    break;
+                }
+            }
+
+            frame.sequence = sequence;
+            frame.captured = Clock::now();
+            if (!captureRing.push(std::move(frame))) break;
+            captured.fetch_add(1, std::memory_order_relaxed);
+            updateMax(maxCaptureDepth, captureRing.depth());
+            capturedTotal->add();
+            captureDepth->set(static_cast<int64_t>(captureRing.depth()));
+            captureDropsTotal->add(captureRing.dropped() - drops); // Only this thread pushes, so only it drops
+            drops = captureRing.dropped();
+        }
+        captureRing.close();
+    });
+
+    std::thread processThread([&]() {
+        uint64_t drops = 0; // Of the display ring
+        StagedFrame frame;
+        while (captureRing.pop(frame)) {
+            captureDepth->set(static_cast<int64_t>(captureRing.depth()));
+            process(frame.image, frame.output);
+            processed.fetch_add(1, std::memory_order_relaxed);
+            processedTotal->add();
+            if (!displayRing.push(std::move(frame))) break;
+            updateMax(maxDisplayDepth, displayRing.depth());
+            displayDepth->set(static_cast<int64_t>(displayRing.depth()));
+            displayDropsTotal->add(displayRing.dropped() - drops);
+            drops = displayRing.dropped();
+        }
+        displayRing.close();
+    });
+
+    // Display stage on the calling thread
+    StagedStats stats;
+    std::vector<double> latencies;
+    latencies.reserve(latencyWindow);
+    StagedFrame frame;
+    for (;;) {
+        bool closed = displayRing.isClosed(); // Read before popping so the last frames are not missed
+        if (displayRing.tryPop(frame)) {
+            displayDepth->set(static_cast<int64_t>(displayRing.depth()));
+            const Clock::duration age = Clock::now() - frame.captured;
+            endToEnd->record(std::chrono::duration_cast<std::chrono::nanoseconds>(age).count());
+            displayedTotal->add();
+            double latency = std::chrono::duration<double, std::milli>(age).count();
+            if (latencies.size() < latencyWindow) latencies.push_back(latency);
+            else latencies[stats.displayed % latencyWindow] = latency;
+            ++stats.displayed;
+
+            bool keepGoing = display(&frame);
+            recycleRing.tryPush(frame);
+            if (!keepGoing) break;
+        } else if (closed) {
+            break;
+        } else {
+            if (!display(nullptr)) break;
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+
+    // Unblock and join the other stages
+    stopRequested.store(true);
+    captureRing.close();
+    displayRing.close();
+    captureThread.join();
+    processThread.join();
+
+    stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    stats.captured = captured.load();
+    stats.processed = processed.load();
+    stats.captureDrops = captureRing.dropped();
+    stats.displayDrops = displayRing.dropped();
+    stats.maxCaptureDepth = maxCaptureDepth.load();
+    stats.maxDisplayDepth = maxDisplayDepth.load();
+    stats.fps = stats.seconds > 0 ? stats.displayed / stats.seconds : 0;
+    stats.p50LatencyMs = percentile(latencies, 50);
+    stats.p99LatencyMs = percentile(latencies, 99);
+    stats.maxLatencyMs = latencies.empty() ? 0 : latencies.back();
+    return stats;
+}
+
+void printStagedStats(const std::string& label, const StagedStats& stats) {
+    char line[512];
+    std::snprintf(line, sizeof(line),
+                  "%s captured=%llu processed=%llu displayed=%llu capture_drops=%llu display_drops=%llu "
+                  "max_capture_depth=%zu max_display_depth=%zu fps=%.1f latency_p50_ms=%.3f latency_p99_ms=%.3f latency_max_ms=%.3f",
+                  label.c_str(),
+                  static_cast<unsigned long long>(stats.captured), static_cast<unsigned long long>(stats.processed),
+                  static_cast<unsigned long long>(stats.displayed), static_cast<unsigned long long>(stats.captureDrops),
+                  static_cast<unsigned long long>(stats.displayDrops), stats.maxCaptureDepth, stats.maxDisplayDepth,
+                  stats.fps, stats.p50LatencyMs, stats.p99LatencyMs, stats.maxLatencyMs);
+    std::cout << line << std::endl;
+}
@@ -0,0 +1,60 @@
+#ifndef STAGED_RUNNER_HPP
+#define STAGED_RUNNER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <opencv2/opencv.hpp>
+#include "frame_ring.hpp"
+#include "frame_source.hpp"
+
+// A frame travelling from capture to display
+struct StagedFrame {
+    cv::Mat image;           // Captured frame
+    cv::Mat output;          // Result of the processing stage
+    uint64_t sequence = 0;   // Capture order, starting at 0
+    std::chrono::steady_clock::time_point captured;
+};
+
+struct StagedOptions {
+    size_t captureQueueDepth = 2;   // Frames waiting between capture and processing
+    size_t displayQueueDepth = 2;   // Frames waiting between processing and display
+    RingPolicy policy = RingPolicy::DropOldest;
+    bool paceToSourceFps = false;   // Release frames at the source's nominal rate, like a live camera
+    uint64_t maxFrames = 0;         // Stop after this many captured frames (0 = until the source ends); replayable sources loop
+};
+
+// Counters of one staged run; queue depths are sampled when the run ends
+struct StagedStats {
+    uint64_t captured = 0;
+    uint64_t processed = 0;
+    uint64_t displayed = 0;
+    uint64_t captureDrops = 0;      // Frames discarded between capture and processing
+    uint64_t displayDrops = 0;      // Frames discarded between processing and display
+    size_t maxCaptureDepth = 0;     // Deepest the capture queue was seen
+    size_t maxDisplayDepth = 0;     // Deepest the display queue was seen
+    double seconds = 0;
+    double fps = 0;                 // Displayed frames per second
+    double p50LatencyMs = 0;        // Capture-to-display ("glass to glass") latency
+    double p99LatencyMs = 0;
+    double maxLatencyMs = 0;
+};
+
+// Processing stage: turn the captured frame into the output
+typedef std::function<void(const cv::Mat& input, cv::Mat& output)> StageProcessFunction;
+
+// Display stage: called on the calling thread with each processed frame, or with nullptr
+// when nothing is ready so a UI can keep pumping events. Return false to stop the run.
+typedef std::function<bool(const StagedFrame* frame)> StageDisplayFunction;
+
+// Run capture and processing on their own threads, connected to the display stage
+// (the calling thread, as highgui requires) by lock-free bounded rings.
+// Frame buffers are recycled from display back to capture, so steady state does not allocate.
+StagedStats runStaged(FrameSource& source, const StagedOptions& options,
+                      const StageProcessFunction& process, const StageDisplayFunction& display);
+
+// Print one result line with throughput, latency percentiles, drops and queue depths
+void printStagedStats(const std::string& label, const StagedStats& stats);
+
+#endif // STAGED_RUNNER_HPP
@@ -0,0 +1,267 @@
+#include "stream_server.hpp"
+#include "frame_source.hpp"
+#include "headless.hpp"
+#include "metrics.hpp"
+#include "pipeline.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <sstream>
+
+
+typedef std::chrono::steady_clock Clock;
+
+// Trim leading and trailing whitespace
+static std::string trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) return "";
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(begin, end - begin + 1);
+}
+
+bool loadStreamList(const std::string& path, const ProcessingParams& defaults, std::vector<StreamSpec>& streams) {
+    std::ifstream file(path.c_str());
+    if (!file) {
+        std::cerr << "Error: Could not open stream list " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        line = trim(line);
+        if (line.empty() || line[0] == '#') continue;
+
+        StreamSpec stream;
+        stream.name = "stream" + std::to_string(streams.size());
+        stream.params = defaults;
+        std::istringstream fields(line);
+        std::string field;
+        while (std::getline(fields, field, ';')) {
+            field = trim(field);
+            if (field.empty()) continue;
+            size_t equals = field.find('=');
+            if (equals == std::string::npos) {
+                std::cerr << path << ":" << lineNumber << ": expected key = value, got '" << field << "'" << std::endl;
+                return false;
+            }
+            std::string key = trim(field.substr(0, equals));
+            std::string value = trim(field.substr(equals + 1));
+            if (key == "source") {
+                stream.sourceSpec = value;
+            } else if (key == "name") {
+                stream.name = value;
+            } else if (key == "budgetMs") {
+                stream.budgetMs = std::atof(value.c_str());
+            } else if (key == "config") {
+                if (!loadParamsFile(value, stream.params)) return false;
+            } else if (!applyParamSetting(key, value, stream.params)) {
+                std::cerr << path << ":" << lineNumber << ": unknown setting '" << key << "'" << std::endl;
+                return false;
+            }
+        }
+        if (stream.sourceSpec.empty()) {
+            std::cerr << path << ":" << lineNumber << ": stream has no source" << std::endl;
+            return false;
+        }
+        streams.push_back(stream);
+    }
+    if (streams.empty()) {
+        std::cerr << path << ": no streams" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+// Run-time state of one stream. Only the worker currently holding the stream touches it.
+struct StreamState {
+    const StreamSpec* spec = nullptr;
+    std::unique_ptr<FrameSource> source;
+    Pipeline pipeline;
+    cv::Mat frame;
+    Clock::duration interval;       // Between paced frames
+    Clock::duration budget;
+    int next = 0;                   // Index of the next frame to handle
+    Clock::time_point readyAt;      // When frame 'next' can be handled
+    Clock::time_point measureStart, measureEnd;
+    std::vector<double> latencies, processTimes;
+    StreamStats stats;
+    LatencyHistogram* latencyMetric = nullptr;   // Arrival to result
+    MetricCounter* processedMetric = nullptr;
+    MetricCounter* droppedMetric = nullptr;
+    MetricCounter* missMetric = nullptr;
+};
+
+// A stream waiting in one of the scheduler's queues, ordered by 'key'
+struct StreamEntry {
+    Clock::time_point key;
+    size_t stream;
+    bool operator>(const StreamEntry& other) const { return key > other.key; }
+};
+typedef std::priority_queue<StreamEntry, std::vector<StreamEntry>, std::greater<StreamEntry> > StreamQueue;
+
+// Next frame of a stream; replayable sources start over when they run out
+static bool readStreamFrame(StreamState& state) {
+    if (state.source->read(state.frame)) return true;
+    if (state.source->rewind() && state.source->read(state.frame)) return true;
+    std::cerr << "Warning: " << state.spec->name << " ran out after " << state.next << " frames" << std::endl;
+    return false;
+}
+
+// Handle one frame of a stream; returns false once the stream is finished
+static bool stepStream(StreamState& state, const StreamServerOptions& options, Clock::time_point start) {
+    const int total = options.warmupFrames + options.frames;
+    if (options.pace) {
+        // A live feed only offers its newest frame: skip the ones that were overtaken
+        const int newest = static_cast<int>(std::min<int64_t>((Clock::now() - start) / state.interval, total - 1));
+        while (state.next < newest) {
+            if (!readStreamFrame(state)) return false;
+            if (state.next >= options.warmupFrames) {
+                state.stats.dropped++;
+                state.droppedMetric->add();
+            }
+            state.next++;
+        }
+    }
+    const Clock::time_point arrival = options.pace ? start + state.next * state.interval : state.readyAt;
+    if (!readStreamFrame(state)) return false;
+
+    if (state.next == options.warmupFrames) state.measureStart = arrival;
+    const Clock::time_point before = Clock::now();
+    state.pipeline.run(state.frame, state.spec->params);
+    const Clock::time_point after = Clock::now();
+    if (state.next >= options.warmupFrames) {
+        state.latencies.push_back(std::chrono::duration<double, std::milli>(after - arrival).count());
+        state.processTimes.push_back(std::chrono::duration<double, std::milli>(after - before).count());
+        state.latencyMetric->record(std::chrono::duration_cast<std::chrono::nanoseconds>(after - arrival).count());
+        state.processedMetric->add();
+        if (after - arrival > state.budget) {
+            state.stats.deadlineMisses++;
+            state.missMetric->add();
+        }
+        state.measureEnd = after;
+    }
+
+    state.next++;
+    state.readyAt = options.pace ? start + state.next * state.interval : after;
+    return state.next < total;
+}
+
+std::vector<StreamStats> runStreamServer(const std::vector<StreamSpec>& streams, const StreamServerOptions& options,
+                                         ThreadPool& pool) {
+    std::vector<std::unique_ptr<StreamState>> states;
+    for (const StreamSpec& spec : streams) {
+        std::unique_ptr<StreamState> state(new StreamState());
+        state->spec = &spec;
+        state->source = createFrameSource(spec.sourceSpec);
+        if (!state->source) continue;
+        if (!state->pipeline.configure(spec.params.pipeline)) {
+            std::cerr << "Skipping " << spec.name << ": invalid chain" << std::endl;
+            continue;
+        }
+        const double fps = state->source->fps() > 0 ? state->source->fps() : 30.0;
+        state->interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps));
+        state->budget = spec.budgetMs > 0
+            ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(spec.budgetMs))
+            : state->interval;
+        state->stats.name = spec.name;
+        state->stats.source = state->source->describe();
+        state->stats.chain = spec.params.pipeline;
+        state->stats.budgetMs = std::chrono::duration<double, std::milli>(state->budget).count();
+        state->latencyMetric = metricsHistogram(metricName("stream_latency_seconds", "stream", spec.name));
+        state->processedMetric = metricsCounter(metricName("stream_frames_processed_total", "stream", spec.name));
+        state->droppedMetric = metricsCounter(metricName("stream_frames_dropped_total", "stream", spec.name));
+        state->missMetric = metricsCounter(metricName("stream_deadline_misses_total", "stream", spec.name));
+        std::cout << "Stream " << spec.name << ": " << state->stats.source << " -> " << state->pipeline.describe() << std::endl;
+        states.push_back(std::move(state));
+    }
+
+    // 'waiting' holds streams whose next frame has not arrived yet, by arrival time;
+    // 'ready' holds streams that can run now, by deadline. A stream being processed is in neither.
+    std::mutex lock;
+    std::condition_variable changed;
+    StreamQueue waiting, ready;
+    size_t active = states.size();
+    const Clock::time_point start = Clock::now();
+    for (size_t s = 0; s < states.size(); ++s) {
+        states[s]->readyAt = start;
+        waiting.push(StreamEntry{start, s});
+    }
+
+    const int cvThreads = cv::getNumThreads();
+    cv::setNumThreads(1);
+    pool.run(pool.size(), [&](int, int) {
+        std::unique_lock<std::mutex> guard(lock);
+        for (;;) {
+            const Clock::time_point now = Clock::now();
+            while (!waiting.empty() && waiting.top().key <= now) {
+                const size_t s = waiting.top().stream;
+                waiting.pop();
+                ready.push(StreamEntry{states[s]->readyAt + states[s]->budget, s});
+            }
+            if (!ready.empty()) {
+                const size_t s = ready.top().stream;
+                ready.pop();
+                guard.unlock();
+                const bool more = stepStream(*states[s], options, start);
+                guard.lock();
+                if (more) waiting.push(StreamEntry{states[s]->readyAt, s});
+                else active--;
+                changed.notify_all();
+            } else if (active == 0) {
+                return;
+            } else if (!waiting.empty()) {
+                changed.wait_until(guard, waiting.top().key);
+            } else {
+                changed.wait(guard); // Every remaining stream is being processed
+            }
+        }
+    });
+    cv::setNumThreads(cvThreads);
+
+    std::vector<StreamStats> results;
+    for (std::unique_ptr<StreamState>& state : states) {
+        StreamStats& stats = state->stats;
+        stats.processed = static_cast<int>(state->latencies.size());
+        const double seconds = std::chrono::duration<double>(state->measureEnd - state->measureStart).count();
+        stats.fps = seconds > 0 ? stats.processed / seconds : 0;
+        stats.p50Ms = percentile(state->latencies, 50);
+        stats.p99Ms = percentile(state->latencies, 99);
+        stats.maxMs = state->latencies.empty() ? 0 : state->latencies.back(); // Sorted by percentile()
+        stats.p50ProcessMs = percentile(state->processTimes, 50);
+        results.push_back(stats);
+    }
+    return results;
+}
+
+void printStreamStats(const std::vector<StreamStats>& stats) {
+    int processed = 0, dropped = 0, misses = 0;
+    double fps = 0;
+    char line[512];
+    for (const StreamStats& stream : stats) {
+        std::snprintf(line, sizeof(line),
+                      "stream=%s source=%s chain=%s budget_ms=%.1f frames=%d dropped=%d misses=%d fps=%.1f"
+                      " p50_ms=%.3f p99_ms=%.3f max_ms=%.3f process_p50_ms=%.3f",
+                      stream.name.c_str(), stream.source.c_str(), stream.chain.c_str(), stream.budgetMs,
+                      stream.processed, stream.dropped, stream.deadlineMisses, stream.fps,
+                      stream.p50Ms, stream.p99Ms, stream.maxMs, stream.p50ProcessMs);
+        std::cout << line << std::endl;
+        processed += stream.processed;
+        dropped += stream.dropped;
+        misses += stream.deadlineMisses;
+        fps += stream.fps;
+    }
+    std::snprintf(line, sizeof(line), "streams=%zu frames=%d dropped=%d misses=%d fps=%.1f",
+                  stats.size(), processed, dropped, misses, fps);
+    std::cout << line << std::endl;
+}
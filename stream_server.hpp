@@ -0,0 +1,63 @@
+#ifndef STREAM_SERVER_HPP
+#define STREAM_SERVER_HPP
+
+#include <string>
+#include <vector>
+#include "processing_params.hpp"
+#include "thread_pool.hpp"
+
+// One feed of a multi-stream run: where its frames come from and how to process them
+struct StreamSpec {
+    std::string name;              // Label in the report, "stream<N>" by default
+    std::string sourceSpec;        // See createFrameSource()
+    ProcessingParams params;       // The chain to run is params.pipeline
+    double budgetMs = 0;           // Capture-to-result latency budget, 0 = one frame interval of the source
+};
+
+// Load a stream list: one stream per line, fields separated by ';', e.g.
+//   source = video:cam1.mp4; pipeline = 3C9A; kernelSize = 7; budgetMs = 40
+//   name = lobby; source = synthetic:1280x720@30; config = lobby.cfg
+// 'source' is required. 'config' loads a parameter file (see loadParamsFile()) before the
+// fields that follow it; 'name' and 'budgetMs' are stream settings; every other key is a
+// parameter setting (see applyParamSetting()). Each stream starts from 'defaults'.
+// Blank lines and lines starting with '#' are ignored. Returns false (after printing why)
+// if the file cannot be read or a line is invalid.
+bool loadStreamList(const std::string& path, const ProcessingParams& defaults, std::vector<StreamSpec>& streams);
+
+struct StreamServerOptions {
+    int frames = 300;          // Frames per stream, processed or dropped
+    int warmupFrames = 10;     // Processed first on every stream and left out of the statistics
+    bool pace = false;         // Frames arrive at each source's frame rate, like live feeds
+};
+
+// Result of one stream
+struct StreamStats {
+    std::string name;
+    std::string source;
+    std::string chain;
+    double budgetMs = 0;
+    int processed = 0;         // Measured frames, after warm-up
+    int dropped = 0;           // Paced frames skipped because a newer one had already arrived
+    int deadlineMisses = 0;    // Measured frames finished later than the budget
+    double fps = 0;            // Processed frames per second of the run
+    double p50Ms = 0;          // Arrival-to-result latency, including the wait for a worker
+    double p99Ms = 0;
+    double maxMs = 0;
+    double p50ProcessMs = 0;   // Time spent in the chain alone
+};
+
+// Process every stream on the threads of 'pool', and return the statistics in stream order.
+// Each stream runs its own Pipeline, one frame at a time, so its frames stay in order.
+// Free workers take the waiting stream whose frame has the earliest deadline (arrival +
+// budget), so a stream with a tight budget goes first and no stream waits more than one
+// round behind the others. With pacing, a stream that falls behind skips to its newest
+// frame, as a camera would, and counts the frames it skipped.
+// OpenCV's own threading is turned off for the run: the streams are the parallelism.
+// Streams whose source or chain is invalid are reported and left out.
+std::vector<StreamStats> runStreamServer(const std::vector<StreamSpec>& streams, const StreamServerOptions& options,
+                                         ThreadPool& pool);
+
+// Print one result line per stream and a total line
+void printStreamStats(const std::vector<StreamStats>& stats);
+
+#endif // STREAM_SERVER_HPP
@@ -0,0 +1,55 @@
+#include "test_support.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+
+cv::Mat randomKernel(int size) {
+    cv::Mat kernel(size, size, CV_32F);
+    unsigned state = 12345u + size;
+    for (int i = 0; i < size * size; i++) {
+        state = state * 1103515245u + 12345u;
+        kernel.at<float>(i / size, i % size) = ((state >> 16) % 2001 - 1000) / 1000.0f;
+    }
+    return kernel / cv::sum(cv::abs(kernel))[0];
+}
+
+void referenceBlobs(const cv::Mat& mask, int connectivity, std::vector<Blob>& blobs) {
+    cv::Mat labels, stats, centroids;
+    const int count = cv::connectedComponentsWithStats(mask, labels, stats, centroids, connectivity);
+    blobs.assign(count - 1, Blob());
+    for (int i = 1; i < count; ++i) {
+        blobs[i - 1].area = stats.at<int>(i, cv::CC_STAT_AREA);
+        blobs[i - 1].box = cv::Rect(stats.at<int>(i, cv::CC_STAT_LEFT), stats.at<int>(i, cv::CC_STAT_TOP),
+                                    stats.at<int>(i, cv::CC_STAT_WIDTH), stats.at<int>(i, cv::CC_STAT_HEIGHT));
+        blobs[i - 1].centroid = cv::Point2f(static_cast<float>(centroids.at<double>(i, 0)), static_cast<float>(centroids.at<double>(i, 1)));
+    }
+}
+
+// Box, area and centroid of every blob, sorted
+static std::vector<std::vector<double> > sortedBlobStats(const std::vector<Blob>& blobs) {
+    std::vector<std::vector<double> > stats;
+    for (const Blob& blob : blobs) {
+        stats.push_back({static_cast<double>(blob.box.y), static_cast<double>(blob.box.x), static_cast<double>(blob.box.width),
+                         static_cast<double>(blob.box.height), static_cast<double>(blob.area), blob.centroid.x, blob.centroid.y});
+    }
+    std::sort(stats.begin(), stats.end());
+    return stats;
+}
+
+int blobDifferences(const std::vector<Blob>& expected, const std::vector<Blob>& actual) {
+    if (expected.size() != actual.size()) {
+        return std::abs(static_cast<int>(expected.size()) - static_cast<int>(actual.size()));
+    }
+    const std::vector<std::vector<double> > a = sortedBlobStats(expected), b = sortedBlobStats(actual);
+    int differing = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        for (int k = 0; k < 7; ++k) {
+            if (std::fabs(a[i][k] - b[i][k]) > (k < 5 ? 0 : 1e-3)) {
+                differing++;
+                break;
+            }
+        }
+    }
+    return differing;
+}
@@ -0,0 +1,22 @@
+#ifndef TEST_SUPPORT_HPP
+#define TEST_SUPPORT_HPP
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "blobs.hpp"
+
+// Inputs and reference results shared by the benchmarks (benchmarks.cpp, bench_kernels.cpp)
+// and golden_tests.cpp, so that all of them time and check the same cases.
+
+// Deterministic size x size kernel with taps in [-1, 1], normalized to unit L1 norm
+cv::Mat randomKernel(int size);
+
+// The blobs of a 0/255 mask as cv::connectedComponentsWithStats finds them, background excluded
+void referenceBlobs(const cv::Mat& mask, int connectivity, std::vector<Blob>& blobs);
+
+// Number of blobs whose box, area or centroid (to 1e-3) differ, compared in sorted order:
+// connectedComponentsWithStats labels 8-connected blobs in 2x2 blocks, not in raster order of
+// their first pixel. Lists of different lengths count the difference in length.
+int blobDifferences(const std::vector<Blob>& expected, const std::vector<Blob>& actual);
+
+#endif // TEST_SUPPORT_HPP
@@ -0,0 +1,117 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+
+
+static inline uint64_t packRange(uint32_t begin, uint32_t end) {
+    return static_cast<uint64_t>(end) << 32 | begin;
+}
+
+ThreadPool::ThreadPool(int threads) {
+    if (threads <= 0) threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for (int t = 0; t < threads; t++) ranges.emplace_back(new Range());
+    for (int t = 1; t < threads; t++) workers.emplace_back(&ThreadPool::workerLoop, this, t);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) worker.join();
+}
+
+void ThreadPool::run(int count, const std::function<void(int index, int thread)>& work) {
+    if (count <= 0) return;
+    if (size() == 1) {
+        for (int i = 0; i < count; i++) work(i, 0);
+        return;
+    }
+
+    task = &work;
+    pending.store(count, std::memory_order_relaxed);
+    const int threads = size();
+    for (int t = 0; t < threads; t++) {
+        // Contiguous shares: neighbouring strips stay on one thread unless stolen
+        uint32_t begin = static_cast<uint32_t>(static_cast<int64_t>(count) * t / threads);
+        uint32_t end = static_cast<uint32_t>(static_cast<int64_t>(count) * (t + 1) / threads);
+        ranges[t]->bounds.store(packRange(begin, end), std::memory_order_release);
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        generation++;
+        batchOpen = true;
+    }
+    wake.notify_all();
+
+    drain(0); // The caller works as thread 0
+    std::unique_lock<std::mutex> guard(lock);
+    // Also wait for every worker to leave drain(): one still in steal() could otherwise move
+    // part of the next batch's ranges onto its own range after the next run() has reset it
+    done.wait(guard, [this] { return pending.load(std::memory_order_acquire) == 0 && active == 0; });
+    batchOpen = false; // Workers that wake up only now sit this batch out
+}
+
+void ThreadPool::workerLoop(int thread) {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            if (!batchOpen) continue;
+            active++;
+        }
+        drain(thread);
+        std::lock_guard<std::mutex> guard(lock);
+        if (--active == 0) done.notify_all();
+    }
+}
+
+// Run tasks from this thread's range, then from stolen ones, until there are none left anywhere
+void ThreadPool::drain(int thread) {
+    int index;
+    while (take(thread, index) || steal(thread, index)) {
+        (*task)(index, thread);
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> guard(lock); // So run() cannot miss the notification
+            done.notify_all();
+        }
+    }
+}
+
+// Take the first index of this thread's own range
+bool ThreadPool::take(int thread, int& index) {
+    std::atomic<uint64_t>& bounds = ranges[thread]->bounds;
+    uint64_t current = bounds.load(std::memory_order_acquire);
+    for (;;) {
+        uint32_t begin = static_cast<uint32_t>(current), end = static_cast<uint32_t>(current >> 32);
+        if (begin >= end) return false;
+        if (bounds.compare_exchange_weak(current, packRange(begin + 1, end), std::memory_order_acq_rel)) {
+            index = static_cast<int>(begin);
+            return true;
+        }
+    }
+}
+
+// Move the back half of another thread's range to this one and take its first index
+bool ThreadPool::steal(int thread, int& index) {
+    const int threads = size();
+    for (int k = 1; k < threads; k++) {
+        std::atomic<uint64_t>& victim = ranges[(thread + k) % threads]->bounds;
+        uint64_t current = victim.load(std::memory_order_acquire);
+        for (;;) {
+            uint32_t begin = static_cast<uint32_t>(current), end = static_cast<uint32_t>(current >> 32);
+            if (begin >= end) break;
+            uint32_t middle = end - (end - begin + 1) / 2;
+            if (victim.compare_exchange_weak(current, packRange(begin, middle), std::memory_order_acq_rel)) {
+                ranges[thread]->bounds.store(packRange(middle + 1, end), std::memory_order_release);
+                stealCount.fetch_add(1, std::memory_order_relaxed);
+                index = static_cast<int>(middle);
+                return true;
+            }
+        }
+    }
+    return false;
+}
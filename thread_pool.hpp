@@ -0,0 +1,67 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads that run batches of independent tasks with work stealing.
+// run() hands every thread a contiguous range of task indices. A thread takes indices from
+// the front of its own range; once that is empty it steals the back half of another
+// thread's range, so strips that take longer (busier image regions, a core shared with the
+// capture thread) even out without a central queue. Ranges are single 64-bit atomics:
+// taking and stealing are one compare-and-swap each, no locks.
+class ThreadPool {
+public:
+    // Start 'threads' - 1 workers; the thread calling run() is the last one.
+    // 0 means one per hardware thread.
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Threads that execute tasks, including the caller of run()
+    int size() const { return static_cast<int>(ranges.size()); }
+
+    // Call task(index, thread) for every index in [0, count) and return when all calls have
+    // finished. 'thread' is in [0, size()) and identifies the executing thread, so callers can
+    // keep per-thread state without locking. One run() at a time.
+    void run(int count, const std::function<void(int index, int thread)>& task);
+
+    // Ranges stolen since the pool started
+    uint64_t steals() const { return stealCount.load(std::memory_order_relaxed); }
+
+private:
+    struct Range {
+        std::atomic<uint64_t> bounds{0}; // begin in the low 32 bits, end in the high 32 bits
+        char padding[64 - sizeof(std::atomic<uint64_t>)]; // Own cache line per thread
+    };
+
+    void workerLoop(int thread);
+    void drain(int thread);
+    bool take(int thread, int& index);
+    bool steal(int thread, int& index);
+
+    std::vector<std::unique_ptr<Range>> ranges; // One per thread
+    std::vector<std::thread> workers;
+
+    std::mutex lock;
+    std::condition_variable wake;   // Workers wait here for the next batch
+    std::condition_variable done;   // run() waits here for the last task
+    uint64_t generation = 0;        // Batches started, guarded by 'lock'
+    bool batchOpen = false;         // run() has not returned yet, guarded by 'lock'
+    int active = 0;                 // Workers inside drain(), guarded by 'lock'
+    bool stopping = false;
+
+    const std::function<void(int, int)>* task = nullptr;
+    std::atomic<int> pending{0};
+    std::atomic<uint64_t> stealCount{0};
+};
+
+#endif // THREAD_POOL_HPP
@@ -0,0 +1,97 @@
+#include "tiled_pipeline.hpp"
+#include <algorithm>
+#include <atomic>
+
+
+// Whether a stage has a halo depends only on the stage, its size on the parameters
+static bool runsOnStrips(char stage) {
+    return stageHaloRows(stage, ProcessingParams()) >= 0;
+}
+
+TiledPipeline::TiledPipeline(ThreadPool& threadPool) : pool(threadPool) {}
+
+bool TiledPipeline::configure(const std::string& choices) {
+    Pipeline check;
+    if (!check.configure(choices)) return false; // Reports the unsupported choice
+
+    chain = choices;
+    segments.clear();
+    for (size_t i = 0; i < chain.size(); ++i) {
+        bool strips = runsOnStrips(chain[i]);
+        if (segments.empty() || segments.back().strips != strips) {
+            segments.push_back(Segment());
+            segments.back().strips = strips;
+        }
+        segments.back().stages += chain[i];
+    }
+    for (Segment& segment : segments) {
+        segment.threads.resize(segment.strips ? pool.size() : 1);
+        for (Pipeline& pipeline : segment.threads) pipeline.configure(segment.stages, segment.strips ? "strip" : "frame");
+        if (segment.strips) {
+            segment.latency = metricsHistogram(metricName(
+                metricName("stage_latency_seconds", "stage", "strips(" + segment.threads[0].describe() + ")"), "scope", "frame"));
+        }
+    }
+    return true;
+}
+
+std::string TiledPipeline::describe() const {
+    std::string text;
+    for (size_t s = 0; s < segments.size(); ++s) {
+        if (s > 0) text += " -> ";
+        if (segments[s].strips) text += "strips(" + segments[s].threads[0].describe() + ")";
+        else text += segments[s].threads[0].describe();
+    }
+    return text;
+}
+
+const cv::Mat& TiledPipeline::run(const cv::Mat& frame, const ProcessingParams& params) {
+    const cv::Mat* current = &frame;
+    for (Segment& segment : segments) {
+        if (segment.strips) {
+            ScopedTimer timer(segment.latency);
+            runStrips(segment, *current, params);
+            current = &segment.output;
+        } else {
+            current = &segment.threads[0].run(*current, params);
+        }
+    }
+    return *current;
+}
+
+// Each task owns rows [y0, y1) of the output. It runs the segment on a window of the input
+// that adds 'halo' rows on both sides (shifted inwards at the top and bottom of the frame),
+// so every row it keeps only depends on real pixels, exactly as in a whole-frame run.
+// All windows have the same height, so each thread's Pipeline keeps its buffers from frame to frame.
+void TiledPipeline::runStrips(Segment& segment, const cv::Mat& input, const ProcessingParams& params) {
+    int halo = 0, type = input.type();
+    for (size_t k = 0; k < segment.stages.size(); ++k) {
+        halo += stageHaloRows(segment.stages[k], params);
+        type = stageOutputType(segment.stages[k], type);
+    }
+    const int rows = input.rows;
+    const int rowBytes = std::max(static_cast<int>(input.cols * input.elemSize()), 1);
+    // At least four halos tall so the rows computed twice stay below half of the work
+    const int stripRows = std::max(std::max(tileStripBytes / rowBytes, 4 * halo), 8);
+    const int windowRows = std::min(stripRows + 2 * halo, rows);
+    const int count = (rows + stripRows - 1) / stripRows;
+    segment.output.create(rows, input.cols, type);
+
+    std::atomic<bool> mismatch(false);
+    pool.run(count, [&](int index, int thread) {
+        const int y0 = index * stripRows, y1 = std::min(rows, y0 + stripRows);
+        const int top = std::min(std::max(y0 - halo, 0), rows - windowRows);
+        const cv::Mat window = input.rowRange(top, top + windowRows);
+        const cv::Mat& result = segment.threads[thread].run(window, params);
+        if (result.type() != type || result.size() != window.size()) {
+            mismatch = true;
+            return;
+        }
+        cv::Mat target = segment.output.rowRange(y0, y1);
+        result.rowRange(y0 - top, y1 - top).copyTo(target);
+    });
+    if (mismatch) {
+        // A stage fell back to something unexpected (e.g. copying its input on an unknown color format)
+        segment.threads[0].run(input, params).copyTo(segment.output);
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef TILED_PIPELINE_HPP
+#define TILED_PIPELINE_HPP
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "pipeline.hpp"
+#include "processing_params.hpp"
+#include "thread_pool.hpp"
+
+// Runs an operation chain on a ThreadPool, one horizontal strip per task.
+// The chain is split into segments: runs of stages that can work on strips (point-wise,
+// blur, erosion, dilation; see stageHaloRows) and runs of stages that need the whole frame.
+// A strip segment is cut into strips of about tileStripBytes of input, each widened by the
+// sum of its stages' halo rows so neighborhood operations see real pixels at the strip
+// edges. Every thread runs the whole segment on its strip through its own Pipeline, so
+// intermediates stay in that core's cache, and copies back only the strip's own rows.
+// Whole-frame segments run on the calling thread with OpenCV's own parallelism.
+// The result is identical to Pipeline::run on the whole frame, for any thread count.
+class TiledPipeline {
+public:
+    explicit TiledPipeline(ThreadPool& pool);
+
+    // Build the chain; returns false (and prints why) on an unsupported choice
+    bool configure(const std::string& choices);
+
+    const std::string& choices() const { return chain; }
+
+    // Run the chain on one frame. The result stays valid until the next call.
+    const cv::Mat& run(const cv::Mat& frame, const ProcessingParams& params);
+
+    // Segments in order, strip segments as "strips(...)", e.g. "strips(3 -> [2 C] -> 9) -> B"
+    std::string describe() const;
+
+    // Input bytes per strip: a strip and its intermediates fit in a typical per-core L2
+    static const int tileStripBytes = 256 * 1024;
+
+private:
+    struct Segment {
+        std::string stages;
+        bool strips = false;            // Runs strip by strip on the pool
+        std::vector<Pipeline> threads;  // One per pool thread for strip segments, otherwise one
+        cv::Mat output;
+        LatencyHistogram* latency = nullptr; // Whole-frame run time of a strip segment
+    };
+
+    void runStrips(Segment& segment, const cv::Mat& input, const ProcessingParams& params);
+
+    ThreadPool& pool;
+    std::string chain;
+    std::vector<Segment> segments;
+};
+
+#endif // TILED_PIPELINE_HPP